@@ -0,0 +1,30 @@
+#include "../hpp/AotRuntime.hpp"
+#include "../hpp/Isolate.hpp"
+#include "../hpp/Trace.hpp"
+#include <stdexcept>
+
+namespace aot {
+
+Value CompiledFunction::call(Interpreter& interpreter, std::vector<Value> arguments) {
+    TRACE(Interpreter, Debug, "Calling compiled " << info.name << " with " << arguments.size() << " arguments");
+    Frame frame(interpreter, closure, info.slotCount);
+    for (size_t i = 0; i < arguments.size(); ++i) {
+        frame.environment().defineAt(static_cast<int>(i), arguments[i]);
+    }
+    return info.body(interpreter);
+}
+
+int run(void (*program)(Interpreter& interpreter)) {
+    Isolate isolate;
+    Isolate::Scope scope(isolate);
+    try {
+        program(isolate.interpreter());
+    } catch (const std::runtime_error& error) {
+        std::cerr << "Runtime Error: " << error.what() << std::endl;
+        Trace::dumpRingBuffer(std::cerr);
+        return 1;
+    }
+    return 0;
+}
+
+} // namespace aot
@@ -0,0 +1,190 @@
+#include "../hpp/Builtins.hpp"
+#include "../hpp/Interpreter.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+void checkArray(const char* function, const Value& value) {
+    if (!value.isArray() && !value.isFloat64Array()) {
+        throw std::runtime_error(std::string(function) + " expects an array.");
+    }
+}
+
+size_t lengthOf(const Value& array) {
+    return array.isArray() ? array.asArray().size() : array.asFloat64Array().size();
+}
+
+size_t indexArgument(const char* function, const Value& value) {
+    if (!value.isNumber() || value.asNumber() < 0 || std::floor(value.asNumber()) != value.asNumber()) {
+        throw std::runtime_error(std::string(function) + " expects a non-negative integer index.");
+    }
+    return static_cast<size_t>(value.asNumber());
+}
+
+// Callbacks take (element) or (element, index); reduce's take the accumulator first.
+std::shared_ptr<Callable> callbackArgument(const char* function, const Value& value, int arity) {
+    std::shared_ptr<Callable> callback = Interpreter::callableOf(value);
+    if (callback->arity() != arity && callback->arity() != arity + 1) {
+        throw std::runtime_error(std::string(function) + " callback must take " + std::to_string(arity) +
+                                 " or " + std::to_string(arity + 1) + " arguments.");
+    }
+    return callback;
+}
+
+// Calls the callback directly, skipping the per-call lookup and arity check of a CallExpr.
+// Each call gets *accumulator first when one is given, then the element, then its index if
+// the callback takes one. Elements come from a snapshot, so the callback may write to the array.
+template <typename Visit>
+void forEach(Interpreter& interpreter, const Value& array, Callable& callback, const Value* accumulator, Visit visit) {
+    bool withIndex = callback.arity() == (accumulator ? 3 : 2);
+    auto invoke = [&](const Value& element, size_t index) {
+        std::vector<Value> arguments;
+        arguments.reserve(3);
+        if (accumulator) arguments.push_back(*accumulator);
+        arguments.push_back(element);
+        if (withIndex) arguments.push_back(Value(static_cast<double>(index)));
+        visit(element, callback.call(interpreter, std::move(arguments)));
+    };
+    if (array.isArray()) {
+        Value snapshot = Value::copyArray(array);
+        for (size_t i = 0; i < snapshot.asArray().size(); ++i) invoke(snapshot.asArray()[i], i);
+    } else {
+        std::vector<double> elements = array.asFloat64Array();
+        for (size_t i = 0; i < elements.size(); ++i) invoke(Value(elements[i]), i);
+    }
+}
+
+// Typed results must stay numbers; a plain array takes whatever the callback returns.
+Value collect(const Value& source, std::vector<Value> elements, const char* function) {
+    if (source.isArray()) return Value(std::move(elements));
+    std::vector<double> numbers;
+    numbers.reserve(elements.size());
+    for (const Value& element : elements) {
+        if (!element.isNumber()) {
+            throw std::runtime_error(std::string(function) + " over a Float64Array must produce numbers.");
+        }
+        numbers.push_back(element.asNumber());
+    }
+    return Value::float64Array(std::move(numbers));
+}
+
+// NaN sorts after every number, so the order is total and std::sort stays well-defined.
+bool numberLess(double left, double right) {
+    return left < right || (std::isnan(right) && !std::isnan(left));
+}
+
+void sortValues(std::vector<Value>& elements) {
+    if (std::all_of(elements.begin(), elements.end(), [](const Value& v) { return v.isNumber(); })) {
+        std::vector<double> numbers;
+        numbers.reserve(elements.size());
+        for (const Value& element : elements) numbers.push_back(element.asNumber());
+        std::sort(numbers.begin(), numbers.end(), numberLess);
+        for (size_t i = 0; i < numbers.size(); ++i) elements[i] = Value(numbers[i]);
+        return;
+    }
+    if (std::all_of(elements.begin(), elements.end(), [](const Value& v) { return v.isString(); })) {
+        std::sort(elements.begin(), elements.end(), [](const Value& left, const Value& right) {
+            return left.asString() < right.asString();
+        });
+        return;
+    }
+    throw std::runtime_error("sort expects an array of numbers or an array of strings.");
+}
+
+} // namespace
+
+void defineArrayBuiltins(Environment& builtins) {
+    defineNative(builtins, "len", 1, [](Interpreter&, std::vector<Value> arguments) {
+        const Value& value = arguments[0];
+        if (value.isString()) return Value(static_cast<double>(value.stringLength()));
+        checkArray("len", value);
+        return Value(static_cast<double>(lengthOf(value)));
+    });
+    defineNative(builtins, "push", 2, [](Interpreter&, std::vector<Value> arguments) {
+        Value& array = arguments[0];
+        checkArray("push", array);
+        if (array.isArray()) {
+            std::vector<Value>& elements = array.asArrayMutable();
+            elements.push_back(arguments[1]);
+            return Value(static_cast<double>(elements.size()));
+        }
+        if (!arguments[1].isNumber()) {
+            throw std::runtime_error("Float64Array elements must be numbers.");
+        }
+        std::vector<double>& elements = array.asFloat64ArrayMutable();
+        elements.push_back(arguments[1].asNumber());
+        return Value(static_cast<double>(elements.size()));
+    });
+    defineNative(builtins, "pop", 1, [](Interpreter&, std::vector<Value> arguments) {
+        Value& array = arguments[0];
+        checkArray("pop", array);
+        if (lengthOf(array) == 0) {
+            throw std::runtime_error("pop from an empty array.");
+        }
+        if (array.isArray()) {
+            std::vector<Value>& elements = array.asArrayMutable();
+            Value last = std::move(elements.back());
+            elements.pop_back();
+            return last;
+        }
+        std::vector<double>& elements = array.asFloat64ArrayMutable();
+        double last = elements.back();
+        elements.pop_back();
+        return Value(last);
+    });
+    defineNative(builtins, "slice", 3, [](Interpreter&, std::vector<Value> arguments) {
+        const Value& array = arguments[0];
+        checkArray("slice", array);
+        size_t begin = indexArgument("slice", arguments[1]);
+        size_t end = indexArgument("slice", arguments[2]);
+        size_t length = lengthOf(array);
+        if (begin > end || end > length) {
+            throw std::runtime_error("slice range [" + std::to_string(begin) + ", " + std::to_string(end) +
+                                     ") is out of bounds for length " + std::to_string(length) + ".");
+        }
+        if (array.isArray()) return Value::sliceArray(array, begin, end);
+        const std::vector<double>& elements = array.asFloat64Array();
+        return Value::float64Array(std::vector<double>(elements.begin() + begin, elements.begin() + end));
+    });
+    defineNative(builtins, "sort", 1, [](Interpreter&, std::vector<Value> arguments) {
+        Value& array = arguments[0];
+        checkArray("sort", array);
+        if (array.isArray()) {
+            sortValues(array.asArrayMutable());
+        } else {
+            std::vector<double>& elements = array.asFloat64ArrayMutable();
+            std::sort(elements.begin(), elements.end(), numberLess);
+        }
+        return array;
+    });
+    defineNative(builtins, "map", 2, [](Interpreter& interpreter, std::vector<Value> arguments) {
+        checkArray("map", arguments[0]);
+        std::shared_ptr<Callable> callback = callbackArgument("map", arguments[1], 1);
+        std::vector<Value> results;
+        results.reserve(lengthOf(arguments[0]));
+        forEach(interpreter, arguments[0], *callback, nullptr, [&](const Value&, Value result) {
+            results.push_back(std::move(result));
+        });
+        return collect(arguments[0], std::move(results), "map");
+    });
+    defineNative(builtins, "filter", 2, [](Interpreter& interpreter, std::vector<Value> arguments) {
+        checkArray("filter", arguments[0]);
+        std::shared_ptr<Callable> callback = callbackArgument("filter", arguments[1], 1);
+        std::vector<Value> kept;
+        forEach(interpreter, arguments[0], *callback, nullptr, [&](const Value& element, const Value& result) {
+            if (interpreter.isTruthy(result)) kept.push_back(element);
+        });
+        return collect(arguments[0], std::move(kept), "filter");
+    });
+    defineNative(builtins, "reduce", 3, [](Interpreter& interpreter, std::vector<Value> arguments) {
+        checkArray("reduce", arguments[0]);
+        std::shared_ptr<Callable> callback = callbackArgument("reduce", arguments[1], 2);
+        Value accumulator = arguments[2];
+        forEach(interpreter, arguments[0], *callback, &accumulator, [&](const Value&, Value result) {
+            accumulator = std::move(result);
+        });
+        return accumulator;
+    });
+}
@@ -0,0 +1,39 @@
+#include "../hpp/Chunk.hpp"
+#include <algorithm>
+
+void Chunk::write(uint8_t byte, int line) {
+    if (lines.empty() || lines.back().line != line) {
+        lines.push_back(LineStart{ code.size(), line });
+    }
+    code.push_back(byte);
+}
+
+void Chunk::write(OpCode op, int line) {
+    write(static_cast<uint8_t>(op), line);
+}
+
+int Chunk::addConstant(const Value& value) {
+    int index = static_cast<int>(constants.size());
+    if (value.isString()) {
+        auto inserted = stringConstants.emplace(value.asStringObj(), index);
+        if (!inserted.second) {
+            return inserted.first->second;
+        }
+    }
+    constants.push_back(value);
+    return index;
+}
+
+int Chunk::addFunction(std::shared_ptr<FunctionProto> function) {
+    functions.push_back(std::move(function));
+    return static_cast<int>(functions.size() - 1);
+}
+
+int Chunk::getLine(size_t offset) const {
+    auto it = std::upper_bound(lines.begin(), lines.end(), offset,
+        [](size_t value, const LineStart& start) { return value < start.offset; });
+    if (it == lines.begin()) {
+        return 0;
+    }
+    return std::prev(it)->line;
+}
@@ -0,0 +1,560 @@
+#include "../hpp/Compiler.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+int GlobalTable::indexOf(const std::string& name) {
+    auto it = indices.find(name);
+    if (it != indices.end()) {
+        return it->second;
+    }
+    if (names.size() > UINT16_MAX) {
+        throw std::runtime_error("Too many global variables.");
+    }
+    int index = static_cast<int>(names.size());
+    names.push_back(name);
+    indices.emplace(name, index);
+    return index;
+}
+
+const std::string& GlobalTable::nameOf(int index) const {
+    return names[index];
+}
+
+size_t GlobalTable::size() const {
+    return names.size();
+}
+
+Compiler::Compiler(GlobalTable& globals) : globals(globals) {}
+
+std::shared_ptr<FunctionProto> Compiler::compile(const StatementList& statements) {
+    FunctionState script{ nullptr, std::make_shared<FunctionProto>() };
+    script.function->name = "script";
+    script.locals.push_back(Local{ "", 0, false });
+    current = &script;
+
+    for (const auto& statement : statements) {
+        compileStatement(*statement);
+    }
+    emit(OpCode::Null);
+    emit(OpCode::Return);
+
+    current = nullptr;
+    return script.function;
+}
+
+Chunk& Compiler::chunk() {
+    return current->function->chunk;
+}
+
+void Compiler::compileStatement(const Statement& stmt) {
+    currentLine = stmt.line;
+    stmt.accept(*this);
+}
+
+void Compiler::compileExpression(const Expression& expr) {
+    expr.accept(*this);
+}
+
+void Compiler::emit(uint8_t byte) {
+    chunk().write(byte, currentLine);
+}
+
+void Compiler::emit(OpCode op) {
+    chunk().write(op, currentLine);
+}
+
+void Compiler::emitShort(int value) {
+    emit(static_cast<uint8_t>((value >> 8) & 0xff));
+    emit(static_cast<uint8_t>(value & 0xff));
+}
+
+void Compiler::emitConstant(const Value& value, OpCode op) {
+    int index = chunk().addConstant(value);
+    if (index > UINT16_MAX) {
+        throw std::runtime_error("Too many constants in one function at line " + std::to_string(currentLine));
+    }
+    emit(op);
+    emitShort(index);
+}
+
+int Compiler::emitJump(OpCode op) {
+    emit(op);
+    emit(0xff);
+    emit(0xff);
+    return static_cast<int>(chunk().code.size() - 2);
+}
+
+void Compiler::patchJump(int offset) {
+    size_t jump = chunk().code.size() - offset - 2;
+    if (jump > UINT16_MAX) {
+        throw std::runtime_error("Too much code to jump over at line " + std::to_string(currentLine));
+    }
+    chunk().code[offset] = static_cast<uint8_t>((jump >> 8) & 0xff);
+    chunk().code[offset + 1] = static_cast<uint8_t>(jump & 0xff);
+}
+
+void Compiler::emitLoop(size_t loopStart) {
+    emit(OpCode::Loop);
+    size_t offset = chunk().code.size() - loopStart + 2;
+    if (offset > UINT16_MAX) {
+        throw std::runtime_error("Loop body too large at line " + std::to_string(currentLine));
+    }
+    emitShort(static_cast<int>(offset));
+}
+
+void Compiler::beginScope() {
+    current->scopeDepth++;
+}
+
+void Compiler::endScope() {
+    current->scopeDepth--;
+    auto& locals = current->locals;
+    while (!locals.empty() && locals.back().depth > current->scopeDepth) {
+        emit(locals.back().isCaptured ? OpCode::CloseUpvalue : OpCode::Pop);
+        locals.pop_back();
+    }
+}
+
+void Compiler::addLocal(const std::string& name, bool defined) {
+    auto& locals = current->locals;
+    for (auto it = locals.rbegin(); it != locals.rend() && it->depth == current->scopeDepth; ++it) {
+        if (it->name == name) {
+            throw std::runtime_error("Variable '" + name + "' already defined in this scope.");
+        }
+    }
+    if (locals.size() > UINT8_MAX) {
+        throw std::runtime_error("Too many local variables in function at line " + std::to_string(currentLine));
+    }
+    locals.push_back(Local{ name, current->scopeDepth, false, defined });
+}
+
+// True if statement declares a function, directly or inside a nested block.
+static bool declaresFunction(const Statement* statement) {
+    if (!statement) {
+        return false;
+    }
+    if (dynamic_cast<const FunctionStatement*>(statement)) {
+        return true;
+    }
+    if (auto block = dynamic_cast<const BlockStatement*>(statement)) {
+        return std::any_of(block->statements.begin(), block->statements.end(), declaresFunction);
+    }
+    if (auto ifStatement = dynamic_cast<const IfStatement*>(statement)) {
+        return declaresFunction(ifStatement->thenBranch) || declaresFunction(ifStatement->elseBranch);
+    }
+    if (auto whileStatement = dynamic_cast<const WhileStatement*>(statement)) {
+        return declaresFunction(whileStatement->thenBranch);
+    }
+    return false;
+}
+
+// A function nested in a block may name a variable or sibling function the block declares
+// after it, so such blocks give each of their declarations a slot up front, left unset
+// until the declaration runs; a closure reading it before then gets the global instead. Code in the block itself still only sees a variable once it is
+// declared (resolveLocal skips reserved slots); only nested function bodies capture them early.
+void Compiler::reserveLocals(const StatementList& statements) {
+    if (std::none_of(statements.begin(), statements.end(), declaresFunction)) {
+        return;
+    }
+    for (const Statement* statement : statements) {
+        const std::string* name = nullptr;
+        if (auto let = dynamic_cast<const LetStatement*>(statement)) {
+            name = &let->name.str();
+        } else if (auto function = dynamic_cast<const FunctionStatement*>(statement)) {
+            name = &function->name.str();
+        }
+        if (name) {
+            emit(OpCode::Unset);
+            addLocal(*name, false);
+        }
+    }
+}
+
+// The slot reserveLocals gave name in the current block, or -1 if it has none.
+int Compiler::reservedSlot(const std::string& name) const {
+    const auto& locals = current->locals;
+    for (int i = static_cast<int>(locals.size()) - 1; i >= 1 && locals[i].depth == current->scopeDepth; --i) {
+        if (locals[i].name == name && !locals[i].defined) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Moves the value on top of the stack into a reserved slot.
+void Compiler::defineReserved(int slot) {
+    emit(OpCode::SetLocal);
+    emit(static_cast<uint8_t>(slot));
+    emit(OpCode::Pop);
+    current->locals[slot].defined = true;
+}
+
+int Compiler::resolveLocal(FunctionState& state, const std::string& name, bool reserved) {
+    for (int i = static_cast<int>(state.locals.size()) - 1; i >= 1; --i) {
+        if (state.locals[i].name == name && (reserved || state.locals[i].defined)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int Compiler::resolveUpvalue(FunctionState& state, const std::string& name) {
+    if (!state.enclosing) {
+        return -1;
+    }
+
+    // The enclosing function's reserved slots count: this body may run after they are defined.
+    int local = resolveLocal(*state.enclosing, name, true);
+    if (local != -1) {
+        state.enclosing->locals[local].isCaptured = true;
+        return addUpvalue(state, static_cast<uint8_t>(local), true, name);
+    }
+
+    int upvalue = resolveUpvalue(*state.enclosing, name);
+    if (upvalue != -1) {
+        return addUpvalue(state, static_cast<uint8_t>(upvalue), false, name);
+    }
+    return -1;
+}
+
+int Compiler::addUpvalue(FunctionState& state, uint8_t index, bool isLocal, const std::string& name) {
+    for (size_t i = 0; i < state.upvalues.size(); ++i) {
+        if (state.upvalues[i].index == index && state.upvalues[i].isLocal == isLocal) {
+            return static_cast<int>(i);
+        }
+    }
+    if (state.upvalues.size() > UINT8_MAX) {
+        throw std::runtime_error("Too many closure variables in function at line " + std::to_string(currentLine));
+    }
+    state.upvalues.push_back(UpvalueRef{ index, isLocal });
+    state.function->upvalueGlobals.push_back(static_cast<uint16_t>(globals.indexOf(name)));
+    state.function->upvalueCount = static_cast<int>(state.upvalues.size());
+    return static_cast<int>(state.upvalues.size() - 1);
+}
+
+void Compiler::emitGetVariable(const std::string& name) {
+    int slot = resolveLocal(*current, name, false);
+    if (slot != -1) {
+        emit(OpCode::GetLocal);
+        emit(static_cast<uint8_t>(slot));
+        return;
+    }
+    int upvalue = resolveUpvalue(*current, name);
+    if (upvalue != -1) {
+        emit(OpCode::GetUpvalue);
+        emit(static_cast<uint8_t>(upvalue));
+        return;
+    }
+    emit(OpCode::GetGlobal);
+    emitShort(globals.indexOf(name));
+}
+
+void Compiler::emitSetVariable(const std::string& name) {
+    int slot = resolveLocal(*current, name, false);
+    if (slot != -1) {
+        emit(OpCode::SetLocal);
+        emit(static_cast<uint8_t>(slot));
+        return;
+    }
+    int upvalue = resolveUpvalue(*current, name);
+    if (upvalue != -1) {
+        emit(OpCode::SetUpvalue);
+        emit(static_cast<uint8_t>(upvalue));
+        return;
+    }
+    emit(OpCode::SetGlobal);
+    emitShort(globals.indexOf(name));
+}
+
+void Compiler::compileFunction(const FunctionStatement& stmt) {
+    FunctionState state{ current, std::make_shared<FunctionProto>() };
+    state.function->name = stmt.name.str();
+    state.function->arity = static_cast<int>(stmt.parameters.size());
+    state.locals.push_back(Local{ "", 0, false });
+    current = &state;
+
+    // Parameters and the body's top-level declarations share one scope, as in LoxFunction::call.
+    beginScope();
+    for (const auto& parameter : stmt.parameters) {
+        addLocal(parameter.str());
+    }
+    reserveLocals(stmt.getBody()->statements);
+    for (const auto& statement : stmt.getBody()->statements) {
+        compileStatement(*statement);
+    }
+    currentLine = stmt.line;
+    emit(OpCode::Null);
+    emit(OpCode::Return);
+
+    current = state.enclosing;
+
+    int index = chunk().addFunction(state.function);
+    if (index > UINT16_MAX) {
+        throw std::runtime_error("Too many functions in one scope at line " + std::to_string(currentLine));
+    }
+    emit(OpCode::Closure);
+    emitShort(index);
+    for (const auto& upvalue : state.upvalues) {
+        emit(static_cast<uint8_t>(upvalue.isLocal ? 1 : 0));
+        emit(upvalue.index);
+    }
+}
+
+Value Compiler::visit(const NumberExpr& expr) {
+    emitConstant(Value(expr.value));
+    return Value();
+}
+
+Value Compiler::visit(const StringExpr& expr) {
+    emitConstant(expr.constant);
+    return Value();
+}
+
+Value Compiler::visit(const BooleanExpr& expr) {
+    emit(expr.value ? OpCode::True : OpCode::False);
+    return Value();
+}
+
+Value Compiler::visit(const VariableExpr& expr) {
+    emitGetVariable(expr.name.str());
+    return Value();
+}
+
+Value Compiler::visit(const ArrayExpr& expr) {
+    if (expr.constant.isArray()) {
+        emitConstant(expr.constant, OpCode::ArrayConstant);
+        return Value();
+    }
+    if (expr.elements.size() > UINT16_MAX) {
+        throw std::runtime_error("Too many elements in array literal at line " + std::to_string(currentLine));
+    }
+    for (const auto& element : expr.elements) {
+        compileExpression(*element);
+    }
+    emit(OpCode::Array);
+    emitShort(static_cast<int>(expr.elements.size()));
+    return Value();
+}
+
+Value Compiler::visit(const IndexExpr& expr) {
+    compileExpression(*expr.array);
+    compileExpression(*expr.index);
+    emit(OpCode::Index);
+    return Value();
+}
+
+Value Compiler::visit(const IndexAssignmentExpr& expr) {
+    compileExpression(*expr.array);
+    compileExpression(*expr.index);
+    compileExpression(*expr.value);
+    emit(OpCode::SetIndex);
+    return Value();
+}
+
+Value Compiler::visit(const BinaryExpr& expr) {
+    if (expr.op == BinaryOp::Assign) {
+        const VariableExpr* varExpr = dynamic_cast<const VariableExpr*>(expr.left);
+        if (!varExpr) {
+            throw std::runtime_error("Invalid assignment target.");
+        }
+        compileExpression(*expr.right);
+        emitSetVariable(varExpr->name.str());
+        return Value();
+    }
+
+    // The right operand only runs when the left one does not decide the result.
+    if (expr.op == BinaryOp::And || expr.op == BinaryOp::Or) {
+        compileExpression(*expr.left);
+        int rightJump = emitJump(OpCode::JumpIfFalse);
+        if (expr.op == BinaryOp::And) {
+            compileExpression(*expr.right);
+            emit(OpCode::Truthy);
+        } else {
+            emit(OpCode::True);
+        }
+        int endJump = emitJump(OpCode::Jump);
+        patchJump(rightJump);
+        if (expr.op == BinaryOp::And) {
+            emit(OpCode::False);
+        } else {
+            compileExpression(*expr.right);
+            emit(OpCode::Truthy);
+        }
+        patchJump(endJump);
+        return Value();
+    }
+
+    compileExpression(*expr.left);
+    compileExpression(*expr.right);
+
+    switch (expr.op) {
+        case BinaryOp::Add: emit(OpCode::Add); break;
+        case BinaryOp::Subtract: emit(OpCode::Subtract); break;
+        case BinaryOp::Multiply: emit(OpCode::Multiply); break;
+        case BinaryOp::Divide: emit(OpCode::Divide); break;
+        case BinaryOp::Modulo: emit(OpCode::Modulo); break;
+        case BinaryOp::Equal: emit(OpCode::Equal); break;
+        case BinaryOp::NotEqual: emit(OpCode::NotEqual); break;
+        case BinaryOp::Greater: emit(OpCode::Greater); break;
+        case BinaryOp::GreaterEqual: emit(OpCode::GreaterEqual); break;
+        case BinaryOp::Less: emit(OpCode::Less); break;
+        case BinaryOp::LessEqual: emit(OpCode::LessEqual); break;
+        default: break;
+    }
+    return Value();
+}
+
+Value Compiler::visit(const UnaryExpr& expr) {
+    compileExpression(*expr.right);
+    emit(expr.op == UnaryOp::Negate ? OpCode::Negate : OpCode::Not);
+    return Value();
+}
+
+Value Compiler::visit(const CallExpr& expr) {
+    if (expr.arguments.size() > UINT8_MAX) {
+        throw std::runtime_error("Cannot have more than 255 arguments at line " + std::to_string(currentLine));
+    }
+    compileExpression(*expr.callee);
+    for (const auto& argument : expr.arguments) {
+        compileExpression(*argument);
+    }
+    emit(OpCode::Call);
+    emit(static_cast<uint8_t>(expr.arguments.size()));
+    return Value();
+}
+
+Value Compiler::visit(const UpdateExpr& expr) {
+    emitGetVariable(expr.name.str());
+    emit(expr.op == UpdateOp::Increment ? OpCode::Increment : OpCode::Decrement);
+    emitSetVariable(expr.name.str());
+    return Value();
+}
+
+Value Compiler::visit(const GroupingExpr& expr) {
+    compileExpression(*expr.expression);
+    return Value();
+}
+
+Value Compiler::visit(const LetStatement& stmt) {
+    if (stmt.initializer) {
+        compileExpression(*stmt.initializer);
+    } else {
+        emit(OpCode::Null);
+    }
+
+    if (current->scopeDepth == 0) {
+        emit(OpCode::DefineGlobal);
+        emitShort(globals.indexOf(stmt.name.str()));
+    } else if (int slot = reservedSlot(stmt.name.str()); slot != -1) {
+        defineReserved(slot);
+    } else {
+        addLocal(stmt.name.str());
+    }
+    return Value();
+}
+
+Value Compiler::visit(const PrintStatement& stmt) {
+    compileExpression(*stmt.expression);
+    emit(OpCode::Print);
+    return Value();
+}
+
+Value Compiler::visit(const ExpressionStatement& stmt) {
+    compileExpression(*stmt.expression);
+    emit(OpCode::Pop);
+    return Value();
+}
+
+Value Compiler::visit(const UpdateStatement& stmt) {
+    const std::string& name = stmt.name.str();
+    emitGetVariable(name);
+    emit(stmt.op == UpdateOp::Increment ? OpCode::Increment : OpCode::Decrement);
+    emitSetVariable(name);
+    emit(OpCode::Pop);
+    return Value();
+}
+
+Value Compiler::visit(const AssignmentUpdateStatement& stmt) {
+    const std::string& name = stmt.name.str();
+
+    emitGetVariable(name);
+    compileExpression(*stmt.value);
+
+    switch (stmt.op) {
+        case BinaryOp::Add: emit(OpCode::AddUpdate); break;
+        case BinaryOp::Subtract: emit(OpCode::SubtractUpdate); break;
+        case BinaryOp::Multiply: emit(OpCode::MultiplyUpdate); break;
+        case BinaryOp::Divide: emit(OpCode::DivideUpdate); break;
+        default: throw std::runtime_error("Unknown assignment update operator: " + std::string(compoundAssignLexeme(stmt.op)));
+    }
+
+    emitSetVariable(name);
+    emit(OpCode::Pop);
+    return Value();
+}
+
+Value Compiler::visit(const BlockStatement& stmt) {
+    beginScope();
+    reserveLocals(stmt.statements);
+    for (const auto& statement : stmt.statements) {
+        compileStatement(*statement);
+    }
+    endScope();
+    return Value();
+}
+
+Value Compiler::visit(const IfStatement& stmt) {
+    compileExpression(*stmt.condition);
+    int thenJump = emitJump(OpCode::JumpIfFalse);
+    compileStatement(*stmt.thenBranch);
+
+    if (stmt.elseBranch) {
+        int elseJump = emitJump(OpCode::Jump);
+        patchJump(thenJump);
+        compileStatement(*stmt.elseBranch);
+        patchJump(elseJump);
+    } else {
+        patchJump(thenJump);
+    }
+    return Value();
+}
+
+Value Compiler::visit(const WhileStatement& stmt) {
+    size_t loopStart = chunk().code.size();
+    compileExpression(*stmt.condition);
+    int exitJump = emitJump(OpCode::JumpIfFalse);
+    compileStatement(*stmt.thenBranch);
+    emitLoop(loopStart);
+    patchJump(exitJump);
+    return Value();
+}
+
+Value Compiler::visit(const FunctionStatement& stmt) {
+    if (current->scopeDepth == 0) {
+        compileFunction(stmt);
+        emit(OpCode::DefineGlobal);
+        emitShort(globals.indexOf(stmt.name.str()));
+    } else if (int slot = reservedSlot(stmt.name.str()); slot != -1) {
+        // The body already sees the reserved slot; it is filled once the closure exists.
+        compileFunction(stmt);
+        defineReserved(slot);
+    } else {
+        // Declared before the body is compiled so the function can refer to itself.
+        addLocal(stmt.name.str());
+        compileFunction(stmt);
+    }
+    return Value();
+}
+
+Value Compiler::visit(const ReturnStatement& stmt) {
+    if (!current->enclosing) {
+        throw std::runtime_error("Cannot return from top-level code at line " + std::to_string(currentLine));
+    }
+    if (stmt.expression) {
+        compileExpression(*stmt.expression);
+    } else {
+        emit(OpCode::Null);
+    }
+    emit(OpCode::Return);
+    return Value();
+}
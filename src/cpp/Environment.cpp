@@ -7,11 +7,18 @@ Environment::Environment() : enclosing(nullptr) {
 }
 
 
-Environment::Environment(std::shared_ptr<Environment> enclosing_env)
-    : enclosing(enclosing_env) {
+Environment::Environment(std::shared_ptr<Environment> enclosing_env, size_t slotCount)
+    : enclosing(enclosing_env), slots(slotCount, Value::unset()) {
+}
+
+void Environment::checkWritable() const {
+    if (Obj::concurrent.load(std::memory_order_relaxed) != 0 && owner != Obj::currentOwner) {
+        throw std::runtime_error("A parallel_map or parallel_for function cannot assign to variables declared outside it.");
+    }
 }
 
 void Environment::define(const std::string& name, const Value& value) {
+    checkWritable();
 
     if (values.count(name)) {
         throw std::runtime_error("Variable '" + name + "' already defined in this scope.");
@@ -20,8 +27,9 @@ void Environment::define(const std::string& name, const Value& value) {
 }
 
 Value Environment::get(const std::string& name) {
-    if (values.count(name)) {
-        return values[name];
+    auto it = values.find(name);
+    if (it != values.end()) {
+        return it->second;
     }
 
     if (enclosing) {
@@ -32,8 +40,10 @@ Value Environment::get(const std::string& name) {
 }
 
 void Environment::assign(const std::string& name, const Value& value) {
-    if (values.count(name)) {
-        values[name] = value;
+    auto it = values.find(name);
+    if (it != values.end()) {
+        checkWritable();
+        it->second = value;
         return; 
     }
 
@@ -43,4 +53,50 @@ void Environment::assign(const std::string& name, const Value& value) {
     }
 
     throw std::runtime_error("Undefined variable '" + name + "' for assignment.");
+}
+
+const std::unordered_map<std::string, Value>& Environment::getValues() const {
+    return values;
+}
+
+Environment* Environment::ancestor(int depth) {
+    Environment* environment = this;
+    for (int i = 0; i < depth; ++i) {
+        environment = environment->enclosing.get();
+    }
+    return environment;
+}
+
+void Environment::defineAt(int slot, const Value& value) {
+    checkWritable();
+    slots[slot] = value;
+}
+
+const Value& Environment::getAt(int depth, int slot) {
+    return ancestor(depth)->slots[slot];
+}
+
+bool Environment::assignAt(int depth, int slot, const Value& value) {
+    Environment* environment = ancestor(depth);
+    Value& target = environment->slots[slot];
+    if (target.isUnset()) {
+        return false;
+    }
+    environment->checkWritable();
+    target = value;
+    return true;
+}
+
+void Environment::reset(std::shared_ptr<Environment> enclosing_env, size_t slotCount) {
+    enclosing = std::move(enclosing_env);
+    slots.assign(slotCount, Value::unset());
+}
+
+void Environment::clear() {
+    enclosing.reset();
+    slots.clear();
+}
+
+void Environment::clearValues() {
+    values.clear();
 }
\ No newline at end of file
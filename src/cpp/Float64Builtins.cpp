@@ -0,0 +1,124 @@
+#include "../hpp/Builtins.hpp"
+#include "../hpp/Simd.hpp"
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+const std::vector<double>& float64Argument(const char* function, const Value& value) {
+    if (!value.isFloat64Array()) {
+        throw std::runtime_error(std::string(function) + " expects a Float64Array.");
+    }
+    return value.asFloat64Array();
+}
+
+double numberArgument(const char* function, const Value& value) {
+    if (!value.isNumber()) {
+        throw std::runtime_error(std::string(function) + " expects a number.");
+    }
+    return value.asNumber();
+}
+
+void checkSameLength(const char* function, const std::vector<double>& left, const std::vector<double>& right) {
+    if (left.size() != right.size()) {
+        throw std::runtime_error(std::string(function) + " needs Float64Arrays of the same length, got " +
+                                 std::to_string(left.size()) + " and " + std::to_string(right.size()) + ".");
+    }
+}
+
+Value float64Array(const Value& source) {
+    if (source.isNumber()) {
+        double length = source.asNumber();
+        if (length < 0 || std::floor(length) != length) {
+            throw std::runtime_error("float64Array length must be a non-negative integer.");
+        }
+        return Value::float64Array(std::vector<double>(static_cast<size_t>(length)));
+    }
+    if (source.isFloat64Array()) {
+        return Value::float64Array(source.asFloat64Array());
+    }
+    if (source.isArray()) {
+        ArrayView elements = source.asArray();
+        std::vector<double> numbers;
+        numbers.reserve(elements.size());
+        for (const Value& element : elements) {
+            if (!element.isNumber()) throw std::runtime_error("float64Array elements must be numbers.");
+            numbers.push_back(element.asNumber());
+        }
+        return Value::float64Array(std::move(numbers));
+    }
+    throw std::runtime_error("float64Array expects a length or an array.");
+}
+
+Value compare(const char* function, simd::Compare op, const Value& leftValue, const Value& rightValue) {
+    const std::vector<double>& left = float64Argument(function, leftValue);
+    std::vector<double> out(left.size());
+    if (rightValue.isNumber()) {
+        double right = rightValue.asNumber();
+        simd::compare(op, left.data(), &right, true, out.data(), left.size());
+    } else {
+        const std::vector<double>& right = float64Argument(function, rightValue);
+        checkSameLength(function, left, right);
+        simd::compare(op, left.data(), right.data(), false, out.data(), left.size());
+    }
+    return Value::float64Array(std::move(out));
+}
+
+} // namespace
+
+void defineFloat64Builtins(Environment& builtins) {
+    defineNative(builtins, "float64Array", 1, [](Interpreter&, std::vector<Value> arguments) {
+        return float64Array(arguments[0]);
+    });
+    defineNative(builtins, "f64Sum", 1, [](Interpreter&, std::vector<Value> arguments) {
+        const std::vector<double>& data = float64Argument("f64Sum", arguments[0]);
+        return Value(simd::sum(data.data(), data.size()));
+    });
+    defineNative(builtins, "f64Dot", 2, [](Interpreter&, std::vector<Value> arguments) {
+        const std::vector<double>& left = float64Argument("f64Dot", arguments[0]);
+        const std::vector<double>& right = float64Argument("f64Dot", arguments[1]);
+        checkSameLength("f64Dot", left, right);
+        return Value(simd::dot(left.data(), right.data(), left.size()));
+    });
+    defineNative(builtins, "f64Min", 1, [](Interpreter&, std::vector<Value> arguments) {
+        const std::vector<double>& data = float64Argument("f64Min", arguments[0]);
+        if (data.empty()) throw std::runtime_error("f64Min of an empty Float64Array.");
+        return Value(simd::min(data.data(), data.size()));
+    });
+    defineNative(builtins, "f64Max", 1, [](Interpreter&, std::vector<Value> arguments) {
+        const std::vector<double>& data = float64Argument("f64Max", arguments[0]);
+        if (data.empty()) throw std::runtime_error("f64Max of an empty Float64Array.");
+        return Value(simd::max(data.data(), data.size()));
+    });
+    defineNative(builtins, "f64Scale", 2, [](Interpreter&, std::vector<Value> arguments) {
+        const std::vector<double>& data = float64Argument("f64Scale", arguments[0]);
+        double factor = numberArgument("f64Scale", arguments[1]);
+        std::vector<double> out(data.size());
+        simd::scale(data.data(), factor, out.data(), data.size());
+        return Value::float64Array(std::move(out));
+    });
+    defineNative(builtins, "f64Add", 2, [](Interpreter&, std::vector<Value> arguments) {
+        const std::vector<double>& left = float64Argument("f64Add", arguments[0]);
+        const std::vector<double>& right = float64Argument("f64Add", arguments[1]);
+        checkSameLength("f64Add", left, right);
+        std::vector<double> out(left.size());
+        simd::add(left.data(), right.data(), out.data(), left.size());
+        return Value::float64Array(std::move(out));
+    });
+    // The comparisons take a Float64Array or a number on the right and return 1/0 masks.
+    defineNative(builtins, "f64Less", 2, [](Interpreter&, std::vector<Value> arguments) {
+        return compare("f64Less", simd::Compare::Less, arguments[0], arguments[1]);
+    });
+    defineNative(builtins, "f64Greater", 2, [](Interpreter&, std::vector<Value> arguments) {
+        return compare("f64Greater", simd::Compare::Greater, arguments[0], arguments[1]);
+    });
+    defineNative(builtins, "f64Equal", 2, [](Interpreter&, std::vector<Value> arguments) {
+        return compare("f64Equal", simd::Compare::Equal, arguments[0], arguments[1]);
+    });
+    defineNative(builtins, "f64PrefixSum", 1, [](Interpreter&, std::vector<Value> arguments) {
+        const std::vector<double>& data = float64Argument("f64PrefixSum", arguments[0]);
+        std::vector<double> out(data.size());
+        simd::prefixSum(data.data(), out.data(), data.size());
+        return Value::float64Array(std::move(out));
+    });
+}
@@ -1,29 +1,47 @@
-#include "../hpp/Interpreter.hpp" 
+﻿#include "../hpp/Interpreter.hpp" 
 #include <iostream>   
 #include <cmath>      
 #include <chrono>     
 #include <stdexcept>  
+#include "../hpp/Trace.hpp"
+#include "../hpp/Jit.hpp"
+#include "../hpp/Builtins.hpp"
 
 Value LoxFunction::call(Interpreter& interpreter, std::vector<Value> arguments) {
-    std::shared_ptr<Environment> function_environment = std::make_shared<Environment>(this->closure);
+    TRACE(Interpreter, Debug, "Calling " << declaration.name << " with " << arguments.size() << " arguments");
+    const BlockStatement* body = declaration.getBody();
+    if (Jit* jit = interpreter.getJit()) {
+        Value result;
+        if (++declaration.jitCounter >= Jit::CALL_THRESHOLD && jit->tryCall(*this, arguments, result)) {
+            return result;
+        }
+    } else if (const Jit* jit = interpreter.getSharedJit()) {
+        Value result;
+        if (jit->callCompiled(*this, arguments, result)) {
+            return result;
+        }
+    }
+    std::shared_ptr<Environment> function_environment = interpreter.acquireEnvironment(this->closure, declaration.slotCount);
 
     for (size_t i = 0; i < arguments.size(); ++i) {
-        function_environment->define(declaration.parameters[i], arguments[i]);
+        function_environment->defineAt(static_cast<int>(i), arguments[i]);
     }
 
-    try {
-        interpreter.executeBlock(declaration.body->statements, function_environment);
-    } catch (const Return& return_exception) { 
-        return return_exception.value; 
+    Completion completion = interpreter.executeBlock(body->statements, function_environment);
+    interpreter.releaseEnvironment(std::move(function_environment));
+    if (completion == Completion::Return) {
+        return interpreter.takeReturnValue();
     }
     return Value(); 
 }
 
-Interpreter::Interpreter() {
-    globals = std::make_shared<Environment>();
+Interpreter::Interpreter(std::ostream& output) : out(&output) {
+    // Natives live one scope above the script's globals, so a script may reuse their names.
+    builtins = std::make_shared<Environment>();
+    globals = std::make_shared<Environment>(builtins);
     environment = globals; 
 
-    globals->define("clock", Value(std::make_shared<NativeFunction>(
+    builtins->define("clock", Value(std::make_shared<NativeFunction>(
         "clock", 
         0,       
         [](Interpreter& interpreter, std::vector<Value> arguments) -> Value {
@@ -32,57 +50,151 @@ Interpreter::Interpreter() {
             ).count()) / 1000.0); 
         }
     )));
+    defineFloat64Builtins(*builtins);
+    defineArrayBuiltins(*builtins);
+    defineParallelBuiltins(*builtins);
 }
 
-void Interpreter::interpret(const std::vector<std::unique_ptr<Statement>>& statements) {
+Interpreter::Interpreter(std::shared_ptr<Environment> sharedGlobals, const Jit* sharedJit, std::ostream& output)
+    : out(&output), builtins(sharedGlobals->enclosing), globals(std::move(sharedGlobals)), environment(globals),
+      sharedJit(sharedJit), recordsFeedback(false) {}
+
+void Interpreter::interpret(const StatementList& statements) {
     try {
-        for (const auto& statement : statements) {
-            execute(*statement); 
-        }
+        run(statements);
     } catch (const std::runtime_error& error) {
         std::cerr << "Runtime Error: " << error.what() << std::endl;
+        Trace::dumpRingBuffer(std::cerr);
+    }
+}
+
+void Interpreter::run(const StatementList& statements) {
+    try {
+        for (const auto& statement : statements) {
+            if (execute(*statement) == Completion::Return) {
+                throw std::runtime_error("Cannot return from top-level code.");
+            }
+        }
+    } catch (const std::runtime_error&) {
+        completion = Completion::Normal;
+        returnValue = Value();
+        throw;
+    }
+}
+
+Interpreter::~Interpreter() = default;
+
+void Interpreter::enableJit() {
+    if (!jit) {
+        jit = std::make_unique<Jit>(*globals);
     }
 }
 
+std::shared_ptr<Environment> Interpreter::getGlobals() const {
+    return globals;
+}
+
+std::shared_ptr<Environment> Interpreter::getBuiltins() const {
+    return builtins;
+}
+
+std::shared_ptr<Environment> Interpreter::acquireEnvironment(std::shared_ptr<Environment> enclosing, size_t slotCount) {
+    TRACE(Environment, Verbose, "Acquiring frame with " << slotCount << " slots, " << environmentPool.size() << " pooled");
+    if (environmentPool.empty()) {
+        return std::make_shared<Environment>(std::move(enclosing), slotCount);
+    }
+    std::shared_ptr<Environment> frame = std::move(environmentPool.back());
+    environmentPool.pop_back();
+    frame->reset(std::move(enclosing), slotCount);
+    return frame;
+}
+
+void Interpreter::releaseEnvironment(std::shared_ptr<Environment> frame) {
+    // A frame still referenced elsewhere was captured by a closure and must stay alive on the heap.
+    if (frame.use_count() != 1 || environmentPool.size() >= ENVIRONMENT_POOL_MAX) {
+        TRACE(Environment, Verbose, "Frame not recycled, use count " << frame.use_count());
+        return;
+    }
+    frame->clear();
+    environmentPool.push_back(std::move(frame));
+}
+
 Value Interpreter::evaluate(const Expression& expr) {
     return expr.accept(*this); 
 }
 
-void Interpreter::execute(const Statement& stmt) {
+Completion Interpreter::execute(const Statement& stmt) {
     stmt.accept(*this); 
+    return completion;
 }
 
-void Interpreter::executeBlock(const std::vector<std::unique_ptr<Statement>>& statements,
-                              std::shared_ptr<Environment> block_environment) {
+Completion Interpreter::executeBlock(const StatementList& statements,
+                                     std::shared_ptr<Environment> block_environment) {
     std::shared_ptr<Environment> previous_environment = this->environment; 
     try {
         this->environment = block_environment; 
 
         for (const auto& statement : statements) {
-            execute(*statement); 
+            if (execute(*statement) != Completion::Normal) {
+                break;
+            }
         }
     } catch (...) {
         this->environment = previous_environment;
         throw; 
     }
     this->environment = previous_environment; 
+    return completion;
 }
 
-void Interpreter::checkNumberOperand(const std::string& op_name, const Value& operand) {
+Value Interpreter::takeReturnValue() {
+    completion = Completion::Normal;
+    return std::move(returnValue);
+}
+
+// A closure may run before a local it refers to has been declared. Until then the name means
+// what it meant before that declaration: the global, or an undefined variable.
+Value Interpreter::lookUpVariable(const std::string& name, const VariableSlot& resolved) {
+    if (resolved.depth >= 0) {
+        const Value& value = environment->getAt(resolved.depth, resolved.slot);
+        if (!value.isUnset()) {
+            return value;
+        }
+    }
+    return globals->get(name);
+}
+
+void Interpreter::assignVariable(const std::string& name, const VariableSlot& resolved, const Value& value) {
+    if (resolved.depth < 0 || !environment->assignAt(resolved.depth, resolved.slot, value)) {
+        globals->assign(name, value);
+    }
+}
+
+void Interpreter::defineVariable(const std::string& name, int slot, const Value& value) {
+    if (slot >= 0) {
+        environment->defineAt(slot, value);
+    } else if (slot == REDECLARED_SLOT) {
+        throw std::runtime_error("Variable '" + name + "' already defined in this scope.");
+    } else {
+        globals->define(name, value);
+    }
+}
+
+void Interpreter::checkNumberOperand(std::string_view op_name, const Value& operand) {
     if (!operand.isNumber()) {
-        throw std::runtime_error("Operand for '" + op_name + "' must be a number.");
+        throw std::runtime_error("Operand for '" + std::string(op_name) + "' must be a number.");
     }
 }
 
-void Interpreter::checkNumberOperands(const std::string& op_name, const Value& left, const Value& right) {
+void Interpreter::checkNumberOperands(std::string_view op_name, const Value& left, const Value& right) {
     if (!left.isNumber() || !right.isNumber()) {
-        throw std::runtime_error("Operands for '" + op_name + "' must be numbers.");
+        throw std::runtime_error("Operands for '" + std::string(op_name) + "' must be numbers.");
     }
 }
 
-void Interpreter::checkBooleanOperand(const std::string& op_name, const Value& operand) {
+void Interpreter::checkBooleanOperand(std::string_view op_name, const Value& operand) {
     if (!operand.isBool()) {
-        throw std::runtime_error("Operand for '" + op_name + "' must be a boolean.");
+        throw std::runtime_error("Operand for '" + std::string(op_name) + "' must be a boolean.");
     }
 }
 
@@ -92,6 +204,7 @@ bool Interpreter::isTruthy(const Value& val) {
     if (val.isNumber()) return val.asNumber() != 0;
     if (val.isString()) return !val.asString().empty();
     if (val.isArray()) return !val.asArray().empty(); 
+    if (val.isFloat64Array()) return !val.asFloat64Array().empty();
     if (val.isCallable()) return true; 
     return true; 
 }
@@ -101,7 +214,7 @@ Value Interpreter::visit(const NumberExpr& expr) {
 }
 
 Value Interpreter::visit(const StringExpr& expr) {
-    return Value(expr.value);
+    return expr.constant;
 }
 
 Value Interpreter::visit(const BooleanExpr& expr) {
@@ -109,10 +222,13 @@ Value Interpreter::visit(const BooleanExpr& expr) {
 }
 
 Value Interpreter::visit(const VariableExpr& expr) {
-    return environment->get(expr.name); 
+    return lookUpVariable(expr.name.str(), expr.resolved); 
 }
 
 Value Interpreter::visit(const ArrayExpr& expr) {
+    if (expr.constant.isArray()) {
+        return Value::copyArray(expr.constant);
+    }
     std::vector<Value> elements_evaluated;
     elements_evaluated.reserve(expr.elements.size());
     for (const auto& element_expr : expr.elements) {
@@ -121,11 +237,8 @@ Value Interpreter::visit(const ArrayExpr& expr) {
     return Value(std::move(elements_evaluated));
 }
 
-Value Interpreter::visit(const IndexExpr& expr) {
-    Value array_val = evaluate(*expr.array);
-    Value index_val = evaluate(*expr.index);
-
-    if (!array_val.isArray()) {
+size_t Interpreter::checkArrayIndex(const Value& array_val, const Value& index_val) {
+    if (!array_val.isArray() && !array_val.isFloat64Array()) {
         throw std::runtime_error("Attempted to index a non-array value.");
     }
     if (!index_val.isNumber()) {
@@ -138,104 +251,227 @@ Value Interpreter::visit(const IndexExpr& expr) {
     }
     long long index_ll = static_cast<long long>(raw_index);
 
-    std::vector<Value>& arr_elements = array_val.asArrayMutable(); 
+    size_t size = array_val.isArray() ? array_val.asArray().size() : array_val.asFloat64Array().size();
 
-    if (index_ll >= arr_elements.size()) {
+    if (index_ll >= size) {
         throw std::runtime_error("Array index out of bounds. Index: " + std::to_string(index_ll) +
-                                 ", Array size: " + std::to_string(arr_elements.size()));
+                                 ", Array size: " + std::to_string(size));
     }
 
-    return arr_elements[index_ll];
+    return static_cast<size_t>(index_ll);
+}
+
+Value Interpreter::getIndex(const Value& array_val, const Value& index_val) {
+    size_t index = checkArrayIndex(array_val, index_val);
+    if (array_val.isFloat64Array()) {
+        return Value(array_val.asFloat64Array()[index]);
+    }
+    return array_val.asArray()[index];
+}
+
+Value Interpreter::setIndex(Value array_val, const Value& index_val, const Value& value) {
+    size_t index = checkArrayIndex(array_val, index_val);
+    if (array_val.isFloat64Array()) {
+        if (!value.isNumber()) throw std::runtime_error("Float64Array elements must be numbers.");
+        array_val.asFloat64ArrayMutable()[index] = value.asNumber();
+        return value;
+    }
+    array_val.asArrayMutable()[index] = value;
+    return value;
+}
+
+Value Interpreter::visit(const IndexExpr& expr) {
+    Value array_val = evaluate(*expr.array);
+    Value index_val = evaluate(*expr.index);
+    return getIndex(array_val, index_val);
+}
+
+Value Interpreter::visit(const IndexAssignmentExpr& expr) {
+    Value array_val = evaluate(*expr.array);
+    Value index_val = evaluate(*expr.index);
+    Value value = evaluate(*expr.value);
+    return setIndex(array_val, index_val, value);
 }
 
 Value Interpreter::visit(const BinaryExpr& expr) {
-    if (expr.op == "=") {
-        VariableExpr* varExpr = dynamic_cast<VariableExpr*>(expr.left.get());
-        if (!varExpr) {
-            throw std::runtime_error("Invalid assignment target.");
+    switch (expr.op) {
+        case BinaryOp::Assign: {
+            const VariableExpr* varExpr = dynamic_cast<const VariableExpr*>(expr.left);
+            if (!varExpr) {
+                throw std::runtime_error("Invalid assignment target.");
+            }
+            Value value = evaluate(*expr.right); 
+            assignVariable(varExpr->name.str(), varExpr->resolved, value); 
+            return value; 
         }
-        Value value = evaluate(*expr.right); 
-        environment->assign(varExpr->name, value); 
-        return value; 
+        case BinaryOp::And:
+            if (!isTruthy(evaluate(*expr.left))) return Value(false); 
+            return Value(isTruthy(evaluate(*expr.right))); 
+        case BinaryOp::Or:
+            if (isTruthy(evaluate(*expr.left))) return Value(true); 
+            return Value(isTruthy(evaluate(*expr.right))); 
+        default:
+            break;
     }
 
     Value left = evaluate(*expr.left);
     Value right = evaluate(*expr.right);
 
-    if (expr.op == "+") {
-        if (left.isString() || right.isString()) {
-            return Value(left.toString() + right.toString());
-        }
-        checkNumberOperands(expr.op, left, right);
-        return Value(left.asNumber() + right.asNumber());
+    switch (expr.quickening) {
+        case BinaryQuickening::Numbers:
+            if (left.isNumber() && right.isNumber()) {
+                return numberBinary(expr.op, left.asNumber(), right.asNumber());
+            }
+            if (recordsFeedback) deoptimize(expr);
+            break;
+        case BinaryQuickening::Strings:
+            if (left.isString() && right.isString()) {
+                return Value::concat(left, right);
+            }
+            if (recordsFeedback) deoptimize(expr);
+            break;
+        case BinaryQuickening::Generic:
+            if (recordsFeedback) recordFeedback(expr, left, right);
+            break;
     }
-    
-    if (expr.op == "-" || expr.op == "*" || expr.op == "/" || expr.op == "%") {
-        checkNumberOperands(expr.op, left, right);
-        double left_num = left.asNumber();
-        double right_num = right.asNumber();
-
-        if (expr.op == "-") return Value(left_num - right_num);
-        if (expr.op == "*") return Value(left_num * right_num);
-        if (expr.op == "/") {
-            if (right_num == 0) throw std::runtime_error("Division by zero.");
-            return Value(left_num / right_num);
-        }
-        if (expr.op == "%") {
+    return genericBinary(expr.op, left, right);
+}
+
+void Interpreter::recordFeedback(const BinaryExpr& expr, const Value& left, const Value& right) {
+    if (expr.deoptimizations >= MAX_DEOPTIMIZATIONS) {
+        return;
+    }
+    BinaryQuickening seen = BinaryQuickening::Generic;
+    if (left.isNumber() && right.isNumber()) {
+        seen = BinaryQuickening::Numbers;
+    } else if (expr.op == BinaryOp::Add && left.isString() && right.isString()) {
+        seen = BinaryQuickening::Strings;
+    }
+
+    if (seen != expr.observed) {
+        expr.observed = seen;
+        expr.observedCount = 0;
+    }
+    if (seen != BinaryQuickening::Generic && ++expr.observedCount >= QUICKEN_AFTER) {
+        TRACE(Interpreter, Verbose, "Quickening '" << binaryOpLexeme(expr.op) << "' for "
+              << (seen == BinaryQuickening::Numbers ? "numbers" : "strings"));
+        expr.quickening = seen;
+    }
+}
+
+void Interpreter::deoptimize(const BinaryExpr& expr) {
+    TRACE(Interpreter, Verbose, "Type guard failed for '" << binaryOpLexeme(expr.op) << "', back to generic");
+    expr.quickening = BinaryQuickening::Generic;
+    expr.observed = BinaryQuickening::Generic;
+    expr.observedCount = 0;
+    ++expr.deoptimizations;
+}
+
+// Operands are known to be numbers; only the checks that depend on their values remain.
+Value Interpreter::numberBinary(BinaryOp op, double left, double right) {
+    switch (op) {
+        case BinaryOp::Add: return Value(left + right);
+        case BinaryOp::Subtract: return Value(left - right);
+        case BinaryOp::Multiply: return Value(left * right);
+        case BinaryOp::Divide:
+            if (right == 0) throw std::runtime_error("Division by zero.");
+            return Value(left / right);
+        case BinaryOp::Equal: return Value(left == right);
+        case BinaryOp::NotEqual: return Value(left != right);
+        case BinaryOp::Greater: return Value(left > right);
+        case BinaryOp::GreaterEqual: return Value(left >= right);
+        case BinaryOp::Less: return Value(left < right);
+        case BinaryOp::LessEqual: return Value(left <= right);
+        default:
+            return genericBinary(op, Value(left), Value(right));
+    }
+}
+
+Value Interpreter::genericBinary(BinaryOp op, const Value& left, const Value& right) {
+    switch (op) {
+        case BinaryOp::Add:
+            if (left.isString() || right.isString()) {
+                return Value::concat(left, right);
+            }
+            checkNumberOperands("+", left, right);
+            return Value(left.asNumber() + right.asNumber());
+        case BinaryOp::Subtract:
+            checkNumberOperands("-", left, right);
+            return Value(left.asNumber() - right.asNumber());
+        case BinaryOp::Multiply:
+            checkNumberOperands("*", left, right);
+            return Value(left.asNumber() * right.asNumber());
+        case BinaryOp::Divide:
+            checkNumberOperands("/", left, right);
+            if (right.asNumber() == 0) throw std::runtime_error("Division by zero.");
+            return Value(left.asNumber() / right.asNumber());
+        case BinaryOp::Modulo: {
+            checkNumberOperands("%", left, right);
+            double left_num = left.asNumber();
+            double right_num = right.asNumber();
             if (right_num == 0) throw std::runtime_error("Modulo by zero.");
             if (static_cast<long long>(left_num) != left_num || static_cast<long long>(right_num) != right_num) {
                 throw std::runtime_error("Modulo operands must be integers.");
             }
             return Value(static_cast<double>(static_cast<long long>(left_num) % static_cast<long long>(right_num)));
         }
-    } else if (expr.op == "==") {
-        return Value(left == right); 
-    } else if (expr.op == "!=") {
-        return Value(left != right); 
-    } else if (expr.op == ">" || expr.op == ">=" || expr.op == "<" || expr.op == "<=") {
-        checkNumberOperands(expr.op, left, right);
-        double left_num = left.asNumber();
-        double right_num = right.asNumber();
-        if (expr.op == ">") return Value(left_num > right_num);
-        if (expr.op == ">=") return Value(left_num >= right_num);
-        if (expr.op == "<") return Value(left_num < right_num);
-        if (expr.op == "<=") return Value(left_num <= right_num);
-    } else if (expr.op == "&&") { 
-        if (!isTruthy(left)) return Value(false); 
-        return Value(isTruthy(right)); 
-    } else if (expr.op == "||") { 
-        if (isTruthy(left)) return Value(true); 
-        return Value(isTruthy(right)); 
-    }
-
-    throw std::runtime_error("Unknown binary operator: " + expr.op);
-}
+        case BinaryOp::Equal:
+            return Value(left == right); 
+        case BinaryOp::NotEqual:
+            return Value(left != right); 
+        case BinaryOp::Greater:
+            checkNumberOperands(">", left, right);
+            return Value(left.asNumber() > right.asNumber());
+        case BinaryOp::GreaterEqual:
+            checkNumberOperands(">=", left, right);
+            return Value(left.asNumber() >= right.asNumber());
+        case BinaryOp::Less:
+            checkNumberOperands("<", left, right);
+            return Value(left.asNumber() < right.asNumber());
+        case BinaryOp::LessEqual:
+            checkNumberOperands("<=", left, right);
+            return Value(left.asNumber() <= right.asNumber());
+        default:
+            break;
+    }
 
-Value Interpreter::visit(const UnaryExpr& expr) {
-    Value right = evaluate(*expr.right);
+    throw std::runtime_error("Unknown binary operator: " + std::string(binaryOpLexeme(op)));
+}
 
-    if (expr.op.getLexeme() == "-") { 
+Value Interpreter::unaryOperation(UnaryOp op, const Value& right) {
+    if (op == UnaryOp::Negate) { 
         checkNumberOperand("-", right);
         return Value(-right.asNumber());
-    } else if (expr.op.getLexeme() == "!") { 
-        return Value(!isTruthy(right));
     }
+    return Value(!isTruthy(right));
+}
 
-    throw std::runtime_error("Unknown unary operator: " + expr.op.getLexeme());
+Value Interpreter::visit(const UnaryExpr& expr) {
+    return unaryOperation(expr.op, evaluate(*expr.right));
 }
 
 Value Interpreter::visit(const GroupingExpr& expr) {
     return evaluate(*expr.expression);
 }
 
-Value Interpreter::visit(const CallExpr& expr) {
-    Value callee = evaluate(*expr.callee);
-
+std::shared_ptr<Callable> Interpreter::callableOf(const Value& callee) {
     if (!callee.isCallable()) {
         throw std::runtime_error("Can only call functions and classes. Tried to call: " + callee.toString());
     }
+    return callee.asCallable();
+}
 
-    std::shared_ptr<Callable> function = callee.asCallable();
+Value Interpreter::call(const std::shared_ptr<Callable>& function, std::vector<Value> arguments) {
+    if (arguments.size() != function->arity()) {
+        throw std::runtime_error("Expected " + std::to_string(function->arity()) +
+                                 " arguments but got " + std::to_string(arguments.size()) + ".");
+    }
+
+    return function->call(*this, std::move(arguments));
+}
+
+Value Interpreter::visit(const CallExpr& expr) {
+    std::shared_ptr<Callable> function = callableOf(evaluate(*expr.callee));
 
     std::vector<Value> arguments;
     arguments.reserve(expr.arguments.size()); 
@@ -243,46 +479,37 @@ Value Interpreter::visit(const CallExpr& expr) {
         arguments.push_back(evaluate(*arg_expr));
     }
 
-    if (arguments.size() != function->arity()) {
-        throw std::runtime_error("Expected " + std::to_string(function->arity()) +
-                                 " arguments but got " + std::to_string(arguments.size()) + ".");
-    }
-
-    return function->call(*this, arguments);
+    return call(function, std::move(arguments));
 }
 
-Value Interpreter::visit(const UpdateExpr& expr) {
-    Value current_val = environment->get(expr.name);
-    checkNumberOperand(expr.op, current_val); 
+Value Interpreter::updateVariable(const std::string& name, const VariableSlot& resolved, UpdateOp op) {
+    Value current_val = lookUpVariable(name, resolved);
+    checkNumberOperand(updateOpLexeme(op), current_val); 
 
     double num_val = current_val.asNumber();
-    double new_val;
-
-    if (expr.op == "++") {
-        new_val = num_val + 1;
-    } else if (expr.op == "--") {
-        new_val = num_val - 1;
-    } else {
-        throw std::runtime_error("Unknown update operator: " + expr.op);
-    }
+    double new_val = op == UpdateOp::Increment ? num_val + 1 : num_val - 1;
 
-    environment->assign(expr.name, Value(new_val));
+    assignVariable(name, resolved, Value(new_val));
 
     return Value(new_val); 
 }
 
+Value Interpreter::visit(const UpdateExpr& expr) {
+    return updateVariable(expr.name.str(), expr.resolved, expr.op);
+}
+
 Value Interpreter::visit(const LetStatement& stmt) {
     Value value; 
     if (stmt.initializer) {
         value = evaluate(*stmt.initializer);
     }
-    environment->define(stmt.name, value); 
+    defineVariable(stmt.name.str(), stmt.slot, value); 
     return Value(); 
 }
 
 Value Interpreter::visit(const PrintStatement& stmt) {
     Value value = evaluate(*stmt.expression);
-    std::cout << value.toString() << std::endl;
+    *out << value.toString() << std::endl;
     return Value();
 }
 
@@ -292,62 +519,53 @@ Value Interpreter::visit(const ExpressionStatement& stmt) {
 }
 
 Value Interpreter::visit(const UpdateStatement& stmt) {
-    std::string var_name = stmt.nameToken.getLexeme();
-    Value current_val = environment->get(var_name);
-    checkNumberOperand(stmt.opToken.getLexeme(), current_val);
-
-    double num_val = current_val.asNumber();
-    double new_val;
-
-    if (stmt.opToken.getLexeme() == "++") {
-        new_val = num_val + 1;
-    } else if (stmt.opToken.getLexeme() == "--") {
-        new_val = num_val - 1;
-    } else {
-        throw std::runtime_error("Unknown update statement operator: " + stmt.opToken.getLexeme());
-    }
-
-    environment->assign(var_name, Value(new_val));
-
+    updateVariable(stmt.name.str(), stmt.resolved, stmt.op);
     return Value(); 
 }
 
-Value Interpreter::visit(const AssignmentUpdateStatement& stmt) {
-    std::string var_name = stmt.variableNameToken.getLexeme();
-    Value current_val = environment->get(var_name);
-
-    Value right_val = evaluate(*stmt.value);
+Value Interpreter::compoundValue(BinaryOp op, const Value& current_val, const Value& right_val) {
+    const char* op_lexeme = compoundAssignLexeme(op);
 
-    std::string op_lexeme = stmt.opToken.getLexeme();
-
-    if (op_lexeme == "+=") {
-        // Allow string concatenation for +=
-        if (current_val.isString() || right_val.isString()) {
-            environment->assign(var_name, Value(current_val.toString() + right_val.toString()));
-        } else {
+    switch (op) {
+        case BinaryOp::Add:
+            // Allow string concatenation for +=
+            if (current_val.isString() || right_val.isString()) {
+                return Value::concat(current_val, right_val);
+            }
             checkNumberOperands(op_lexeme, current_val, right_val);
-            environment->assign(var_name, Value(current_val.asNumber() + right_val.asNumber()));
-        }
-    } else if (op_lexeme == "-=") {
-        checkNumberOperands(op_lexeme, current_val, right_val);
-        environment->assign(var_name, Value(current_val.asNumber() - right_val.asNumber()));
-    } else if (op_lexeme == "*=") {
-        checkNumberOperands(op_lexeme, current_val, right_val);
-        environment->assign(var_name, Value(current_val.asNumber() * right_val.asNumber()));
-    } else if (op_lexeme == "/=") {
-        checkNumberOperands(op_lexeme, current_val, right_val);
-        if (right_val.asNumber() == 0) throw std::runtime_error("Division by zero in assignment update.");
-        environment->assign(var_name, Value(current_val.asNumber() / right_val.asNumber()));
-    } else {
-        throw std::runtime_error("Unknown assignment update operator: " + op_lexeme);
+            return Value(current_val.asNumber() + right_val.asNumber());
+        case BinaryOp::Subtract:
+            checkNumberOperands(op_lexeme, current_val, right_val);
+            return Value(current_val.asNumber() - right_val.asNumber());
+        case BinaryOp::Multiply:
+            checkNumberOperands(op_lexeme, current_val, right_val);
+            return Value(current_val.asNumber() * right_val.asNumber());
+        case BinaryOp::Divide:
+            checkNumberOperands(op_lexeme, current_val, right_val);
+            if (right_val.asNumber() == 0) throw std::runtime_error("Division by zero in assignment update.");
+            return Value(current_val.asNumber() / right_val.asNumber());
+        default:
+            throw std::runtime_error("Unknown assignment update operator: " + std::string(op_lexeme));
     }
+}
 
+Value Interpreter::visit(const AssignmentUpdateStatement& stmt) {
+    const std::string& var_name = stmt.name.str();
+    Value current_val = lookUpVariable(var_name, stmt.resolved);
+    Value right_val = evaluate(*stmt.value);
+    assignVariable(var_name, stmt.resolved, compoundValue(stmt.op, current_val, right_val));
     return Value(); 
 }
 
 Value Interpreter::visit(const BlockStatement& stmt) {
-    std::shared_ptr<Environment> new_environment = std::make_shared<Environment>(this->environment);
-    executeBlock(stmt.statements, new_environment); 
+    std::shared_ptr<Environment> new_environment = acquireEnvironment(this->environment, stmt.slotCount);
+    try {
+        executeBlock(stmt.statements, new_environment); 
+    } catch (...) {
+        releaseEnvironment(std::move(new_environment));
+        throw;
+    }
+    releaseEnvironment(std::move(new_environment));
     return Value();
 }
 
@@ -363,7 +581,12 @@ Value Interpreter::visit(const IfStatement& stmt) {
 
 Value Interpreter::visit(const WhileStatement& stmt) {
     while (isTruthy(evaluate(*stmt.condition))) {
-        execute(*stmt.thenBranch);
+        if (execute(*stmt.thenBranch) != Completion::Normal) {
+            break;
+        }
+        if (jit && ++stmt.jitCounter >= Jit::LOOP_THRESHOLD && jit->tryRunLoop(stmt, *environment)) {
+            break;
+        }
     }
     return Value();
 }
@@ -371,17 +594,17 @@ Value Interpreter::visit(const WhileStatement& stmt) {
 Value Interpreter::visit(const FunctionStatement& stmt) {
     std::shared_ptr<LoxFunction> function = std::make_shared<LoxFunction>(stmt, this->environment);
     
-    environment->define(stmt.name, Value(function));
+    defineVariable(stmt.name.str(), stmt.slot, Value(function));
     
     return Value(); 
 }
 
 Value Interpreter::visit(const ReturnStatement& stmt) {
-    Value value_to_return;
     if (stmt.expression) { 
-        value_to_return = evaluate(*stmt.expression);
+        returnValue = evaluate(*stmt.expression);
     } else {
-        value_to_return = Value(); 
+        returnValue = Value(); 
     }
-    throw Return(value_to_return);
+    completion = Completion::Return;
+    return Value();
 }
@@ -0,0 +1,19 @@
+#include "../hpp/Isolate.hpp"
+
+Isolate::Isolate(std::ostream& output) {
+    // Builtins are created inside the isolate so their strings land in its table.
+    Scope scope(*this);
+    engine = std::make_unique<Interpreter>(output);
+}
+
+Isolate::~Isolate() {
+    Scope scope(*this);
+    engine->getGlobals()->clearValues();
+    engine.reset();
+}
+
+Isolate::Scope::Scope(Isolate& isolate) : previous(InternTable::makeCurrent(&isolate.internTable)) {}
+
+Isolate::Scope::~Scope() {
+    InternTable::makeCurrent(previous);
+}
@@ -0,0 +1,1010 @@
+#include "../hpp/Jit.hpp"
+#include "../hpp/Callable.hpp"
+#include "../hpp/Environment.hpp"
+#include "../hpp/Trace.hpp"
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#define MYLANG_JIT_SUPPORTED 1
+#else
+#define MYLANG_JIT_SUPPORTED 0
+#endif
+
+enum class NativeType : uint8_t {
+    Unknown,
+    Number,
+    Bool
+};
+
+// Returned in rax:xmm0 under the System V ABI, which is how the generated code returns it.
+struct NativeResult {
+    int64_t status;
+    double value;
+};
+
+using NativeFunctionEntry = NativeResult (*)(const double* arguments);
+using NativeLoopEntry = int64_t (*)(double* liveIns);
+
+struct Jit::CompiledCode {
+    void* memory = nullptr;
+    size_t size = 0;
+    bool compiling = true;
+
+    void* entry = nullptr;
+    // Functions only: the body, called from other compiled code with arguments in xmm0-7.
+    void* body = nullptr;
+    int arity = 0;
+    NativeType returnType = NativeType::Unknown;
+
+    // Global names the code calls directly, with the function each must still hold.
+    std::vector<std::pair<std::string, const FunctionStatement*>> dependencies;
+
+    // Loops only: variables from outside the loop, copied in on entry and out on exit.
+    struct LiveIn {
+        int depth;          // Environment hops from the loop's environment; -1 for a global
+        int slot;
+        std::string global;
+        bool written = false;
+    };
+    std::vector<LiveIn> liveIns;
+
+    int bailouts = 0;
+
+    ~CompiledCode() {
+#if MYLANG_JIT_SUPPORTED
+        if (memory) munmap(memory, size);
+#endif
+    }
+};
+
+namespace {
+
+constexpr int MAX_ARGUMENTS = 8;
+constexpr int MAX_LIVE_INS = 32;
+constexpr int MAX_BAILOUTS = 4;
+
+// Register numbers as encoded in ModRM.
+constexpr int RAX = 0, RCX = 1, RDX = 2, RSP = 4, RBP = 5, RDI = 7;
+
+// Condition codes for Jcc (0x0F 0x80+cc) and SETcc (0x0F 0x90+cc).
+constexpr uint8_t CC_E = 0x4, CC_NE = 0x5, CC_AE = 0x3, CC_A = 0x7, CC_P = 0xA, CC_NP = 0xB;
+
+// Just the x86-64 encodings the NativeCompiler needs. All memory operands use a 32-bit
+// displacement; jumps and calls to labels use 32-bit offsets patched by finish().
+class Assembler {
+public:
+    std::vector<uint8_t> code;
+
+    int newLabel() {
+        labels.push_back(-1);
+        return static_cast<int>(labels.size() - 1);
+    }
+    void bind(int label) { labels[label] = static_cast<int>(code.size()); }
+    int offsetOf(int label) const { return labels[label]; }
+
+    void jump(int label) { emit({ 0xE9 }); rel32(label); }
+    void jumpIf(uint8_t cc, int label) { emit({ 0x0F, static_cast<uint8_t>(0x80 | cc) }); rel32(label); }
+    void call(int label) { emit({ 0xE8 }); rel32(label); }
+    void callAbsolute(const void* target) {
+        movImmediate(reinterpret_cast<uint64_t>(target));
+        emit({ 0xFF, 0xD0 });                                          // call rax
+    }
+
+    void returnFromStub() { emit({ 0x5D, 0xC3 }); }                     // pop rbp; ret
+    void prologue() { emit({ 0x55, 0x48, 0x89, 0xE5 }); }              // push rbp; mov rbp, rsp
+    void epilogue() { emit({ 0x48, 0x89, 0xEC, 0x5D, 0xC3 }); }        // mov rsp, rbp; pop rbp; ret
+    int reserveFrame() {                                                // sub rsp, imm32 (patched)
+        emit({ 0x48, 0x81, 0xEC });
+        int at = static_cast<int>(code.size());
+        int32(0);
+        return at;
+    }
+    void patchInt32(int at, int32_t value) { std::memcpy(&code[at], &value, 4); }
+
+    void setStatus(int status) {
+        if (status == 0) emit({ 0x31, 0xC0 });                          // xor eax, eax
+        else { emit({ 0xB8 }); int32(status); }                         // mov eax, imm32
+    }
+    void testStatus() { emit({ 0x85, 0xC0 }); }                          // test eax, eax
+
+    void movImmediate(uint64_t value) { emit({ 0x48, 0xB8 }); int64(value); }   // mov rax, imm64
+    void storePointer(int disp, int reg) { emit({ 0x48, 0x89 }); memory(reg, RBP, disp); }
+    void loadPointer(int reg, int disp) { emit({ 0x48, 0x8B }); memory(reg, RBP, disp); }
+
+    void loadDouble(int xmm, int base, int disp) { emit({ 0xF2, 0x0F, 0x10 }); memory(xmm, base, disp); }
+    void storeDouble(int base, int disp, int xmm) { emit({ 0xF2, 0x0F, 0x11 }); memory(xmm, base, disp); }
+    void loadConstant(int xmm, double value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        movImmediate(bits);
+        emit({ 0x66, 0x48, 0x0F, 0x6E, static_cast<uint8_t>(0xC0 | (xmm << 3)) });   // movq xmm, rax
+    }
+    void zero(int xmm) { emit({ 0x66, 0x0F, 0x57, registers(xmm, xmm) }); }         // xorpd
+    void move(int to, int from) { emit({ 0x66, 0x0F, 0x28, registers(to, from) }); } // movapd
+
+    void addsd(int to, int from) { emit({ 0xF2, 0x0F, 0x58, registers(to, from) }); }
+    void mulsd(int to, int from) { emit({ 0xF2, 0x0F, 0x59, registers(to, from) }); }
+    void subsd(int to, int from) { emit({ 0xF2, 0x0F, 0x5C, registers(to, from) }); }
+    void divsd(int to, int from) { emit({ 0xF2, 0x0F, 0x5E, registers(to, from) }); }
+    void ucomisd(int a, int b) { emit({ 0x66, 0x0F, 0x2E, registers(a, b) }); }
+
+    void negate(int xmm) {
+        emit({ 0x66, 0x48, 0x0F, 0x7E, static_cast<uint8_t>(0xC0 | (xmm << 3)) });   // movq rax, xmm
+        emit({ 0x48, 0x0F, 0xBA, 0xF8, 63 });                                        // btc rax, 63
+        emit({ 0x66, 0x48, 0x0F, 0x6E, static_cast<uint8_t>(0xC0 | (xmm << 3)) });   // movq xmm, rax
+    }
+
+    // al = cc, optionally combined with a second condition through cl.
+    void setFlag(uint8_t cc) { emit({ 0x0F, static_cast<uint8_t>(0x90 | cc), 0xC0 }); }
+    void andFlag(uint8_t cc) { emit({ 0x0F, static_cast<uint8_t>(0x90 | cc), 0xC1, 0x20, 0xC8 }); }
+    void orFlag(uint8_t cc) { emit({ 0x0F, static_cast<uint8_t>(0x90 | cc), 0xC1, 0x08, 0xC8 }); }
+    // xmm0 = al ? 1.0 : 0.0
+    void flagToDouble() { emit({ 0x0F, 0xB6, 0xC0, 0xF2, 0x0F, 0x2A, 0xC0 }); }    // movzx eax, al; cvtsi2sd
+
+    // gpr = (int64)xmm, then xmm2 = (double)gpr, for "is this an integer" checks.
+    void truncate(int gpr, int xmm) {
+        emit({ 0xF2, 0x48, 0x0F, 0x2C, static_cast<uint8_t>(0xC0 | (gpr << 3) | xmm) });
+        emit({ 0xF2, 0x48, 0x0F, 0x2A, static_cast<uint8_t>(0xC0 | (2 << 3) | gpr) });
+    }
+    void compareRcxMinusOne() { emit({ 0x48, 0x83, 0xF9, 0xFF }); }
+    void signedRemainder() { emit({ 0x48, 0x99, 0x48, 0xF7, 0xF9 }); }              // cqo; idiv rcx
+    void remainderToDouble() { emit({ 0xF2, 0x48, 0x0F, 0x2A, 0xC2 }); }             // cvtsi2sd xmm0, rdx
+
+    void finish() {
+        for (const Fixup& fixup : fixups) {
+            int target = labels[fixup.label];
+            if (target < 0) throw std::logic_error("unbound JIT label");
+            patchInt32(fixup.at, target - (fixup.at + 4));
+        }
+    }
+
+private:
+    struct Fixup {
+        int at;
+        int label;
+    };
+    std::vector<int> labels;
+    std::vector<Fixup> fixups;
+
+    void emit(std::initializer_list<uint8_t> bytes) { code.insert(code.end(), bytes); }
+    void int32(int32_t value) {
+        uint8_t bytes[4];
+        std::memcpy(bytes, &value, 4);
+        code.insert(code.end(), bytes, bytes + 4);
+    }
+    void int64(uint64_t value) {
+        uint8_t bytes[8];
+        std::memcpy(bytes, &value, 8);
+        code.insert(code.end(), bytes, bytes + 8);
+    }
+    void rel32(int label) {
+        fixups.push_back(Fixup{ static_cast<int>(code.size()), label });
+        int32(0);
+    }
+    static uint8_t registers(int reg, int rm) { return static_cast<uint8_t>(0xC0 | (reg << 3) | rm); }
+    void memory(int reg, int base, int32_t disp) {
+        code.push_back(static_cast<uint8_t>(0x80 | (reg << 3) | base));
+        if (base == RSP) code.push_back(0x24);
+        int32(disp);
+    }
+};
+
+// Thrown while compiling when the code uses something the JIT does not handle.
+struct Unsupported {
+    const char* reason;
+};
+
+} // namespace
+
+// Generates native code for one function or loop. Expressions leave their value in xmm0.
+// Frame layout below rbp: the loop's live-in pointer and live-ins (loops only), then the
+// locals of every scope open at that point, each scope above the next. Temporaries are
+// addressed from rsp at the bottom of the frame.
+class NativeCompiler : public Visitor {
+public:
+    NativeCompiler(Jit& jit, Jit::CompiledCode& code) : jit(jit), code(code) {}
+
+    void compileFunction(const FunctionStatement& declaration);
+    void compileLoop(const WhileStatement& loop);
+
+    Value visit(const NumberExpr& expr) override;
+    Value visit(const StringExpr& expr) override;
+    Value visit(const BooleanExpr& expr) override;
+    Value visit(const VariableExpr& expr) override;
+    Value visit(const ArrayExpr& expr) override;
+    Value visit(const IndexExpr& expr) override;
+    Value visit(const IndexAssignmentExpr& expr) override;
+    Value visit(const BinaryExpr& expr) override;
+    Value visit(const UnaryExpr& expr) override;
+    Value visit(const CallExpr& expr) override;
+    Value visit(const UpdateExpr& expr) override;
+    Value visit(const GroupingExpr& expr) override;
+
+    Value visit(const LetStatement& stmt) override;
+    Value visit(const PrintStatement& stmt) override;
+    Value visit(const ExpressionStatement& stmt) override;
+    Value visit(const UpdateStatement& stmt) override;
+    Value visit(const AssignmentUpdateStatement& stmt) override;
+    Value visit(const BlockStatement& stmt) override;
+    Value visit(const IfStatement& stmt) override;
+    Value visit(const WhileStatement& stmt) override;
+    Value visit(const FunctionStatement& stmt) override;
+    Value visit(const ReturnStatement& stmt) override;
+
+private:
+    Jit& jit;
+    Jit::CompiledCode& code;
+    Assembler as;
+
+    const FunctionStatement* function = nullptr;
+    int bodyLabel = -1;
+    bool selfCalled = false;
+    int bailLabel = -1;
+    int exitLabel = -1;
+
+    struct Scope {
+        int base;
+    };
+    std::vector<Scope> scopes;
+    std::vector<NativeType> slotTypes;
+    int firstLocal = 0;
+    int nextSlot = 0;
+    int maxSlot = 0;
+    int temps = 0;
+    int maxTemps = 0;
+    NativeType resultType = NativeType::Unknown;
+
+    static int slotOffset(int slot) { return -8 * (slot + 1); }
+    int tempOffset(int temp) const { return 8 * temp; }
+
+    NativeType compile(const Expression& expr);
+    void compile(const Statement& stmt);
+    void compileNumber(const Expression& expr);
+    void beginScope(int slotCount);
+    void endScope();
+    int variableSlot(const VariableSlot& resolved, const std::string& name, bool write);
+    int liveIn(int depth, int slot, const std::string& global);
+    void addDependency(const std::string& name, const FunctionStatement* declaration);
+    void storeVariable(int slot, NativeType type);
+    int pushTemp();
+    void popTemp() { temps--; }
+    void jumpIfFalsy(int label);
+    void truthiness();
+    void bailIfZero(int xmm);
+    void finishFrame(int framePatch);
+    void install();
+};
+
+NativeType NativeCompiler::compile(const Expression& expr) {
+    expr.accept(*this);
+    return resultType;
+}
+
+void NativeCompiler::compile(const Statement& stmt) {
+    stmt.accept(*this);
+}
+
+void NativeCompiler::compileNumber(const Expression& expr) {
+    if (compile(expr) != NativeType::Number) throw Unsupported{ "operand is not a number" };
+}
+
+void NativeCompiler::beginScope(int slotCount) {
+    scopes.push_back(Scope{ nextSlot });
+    nextSlot += slotCount;
+    if (nextSlot > maxSlot) maxSlot = nextSlot;
+    if (static_cast<int>(slotTypes.size()) < nextSlot) slotTypes.resize(nextSlot);
+    for (int i = scopes.back().base; i < nextSlot; ++i) slotTypes[i] = NativeType::Unknown;
+}
+
+void NativeCompiler::endScope() {
+    nextSlot = scopes.back().base;
+    scopes.pop_back();
+}
+
+int NativeCompiler::liveIn(int depth, int slot, const std::string& global) {
+    for (size_t i = 0; i < code.liveIns.size(); ++i) {
+        const auto& existing = code.liveIns[i];
+        if (existing.depth == depth && existing.slot == slot && existing.global == global) {
+            return 1 + static_cast<int>(i);
+        }
+    }
+    if (code.liveIns.size() >= MAX_LIVE_INS) throw Unsupported{ "too many outer variables" };
+    code.liveIns.push_back(Jit::CompiledCode::LiveIn{ depth, slot, global });
+    return static_cast<int>(code.liveIns.size());
+}
+
+// Native slot of a variable use. Live-ins occupy slots 1..MAX_LIVE_INS and are numbers.
+int NativeCompiler::variableSlot(const VariableSlot& resolved, const std::string& name, bool write) {
+    int slot;
+    if (resolved.depth < 0) {
+        if (function) throw Unsupported{ "global variable in function" };
+        slot = liveIn(-1, 0, name);
+    } else {
+        int scope = static_cast<int>(scopes.size()) - 1 - resolved.depth;
+        if (scope >= 0) {
+            return scopes[scope].base + resolved.slot;
+        }
+        if (function) throw Unsupported{ "closure variable" };
+        slot = liveIn(resolved.depth - static_cast<int>(scopes.size()), resolved.slot, "");
+    }
+    if (write) code.liveIns[slot - 1].written = true;
+    return slot;
+}
+
+void NativeCompiler::storeVariable(int slot, NativeType type) {
+    NativeType declared = slot < firstLocal ? NativeType::Number : slotTypes[slot];
+    if (declared != type) throw Unsupported{ "variable changes type" };
+    as.storeDouble(RBP, slotOffset(slot), 0);
+}
+
+int NativeCompiler::pushTemp() {
+    int temp = temps++;
+    if (temps > maxTemps) maxTemps = temps;
+    return temp;
+}
+
+// Interpreter::isTruthy for numbers and booleans: anything but 0 (NaN included) is true.
+void NativeCompiler::jumpIfFalsy(int label) {
+    int truthy = as.newLabel();
+    as.zero(1);
+    as.ucomisd(0, 1);
+    as.jumpIf(CC_P, truthy);
+    as.jumpIf(CC_E, label);
+    as.bind(truthy);
+}
+
+void NativeCompiler::truthiness() {
+    as.zero(1);
+    as.ucomisd(0, 1);
+    as.setFlag(CC_NE);
+    as.orFlag(CC_P);
+    as.flagToDouble();
+}
+
+void NativeCompiler::bailIfZero(int xmm) {
+    int nonZero = as.newLabel();
+    as.zero(2);
+    as.ucomisd(xmm, 2);
+    as.jumpIf(CC_P, nonZero);
+    as.jumpIf(CC_E, bailLabel);
+    as.bind(nonZero);
+}
+
+void NativeCompiler::finishFrame(int framePatch) {
+    int bytes = 8 * (maxSlot + maxTemps);
+    as.patchInt32(framePatch, (bytes + 15) & ~15);
+}
+
+void NativeCompiler::install() {
+    as.finish();
+#if MYLANG_JIT_SUPPORTED
+    size_t page = 4096;
+    size_t size = (as.code.size() + page - 1) / page * page;
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) throw Unsupported{ "no executable memory" };
+    std::memcpy(memory, as.code.data(), as.code.size());
+    if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, size);
+        throw Unsupported{ "no executable memory" };
+    }
+    code.memory = memory;
+    code.size = size;
+#else
+    throw Unsupported{ "unsupported platform" };
+#endif
+}
+
+void NativeCompiler::addDependency(const std::string& name, const FunctionStatement* declaration) {
+    for (const auto& dependency : code.dependencies) {
+        if (dependency.first == name && dependency.second == declaration) return;
+    }
+    code.dependencies.emplace_back(name, declaration);
+}
+
+void NativeCompiler::compileFunction(const FunctionStatement& declaration) {
+    function = &declaration;
+    int arity = static_cast<int>(declaration.parameters.size());
+    if (arity > MAX_ARGUMENTS) throw Unsupported{ "too many parameters" };
+    code.arity = arity;
+    bailLabel = as.newLabel();
+    exitLabel = as.newLabel();
+    bodyLabel = as.newLabel();
+
+    // C ABI entry: the arguments arrive as an array in rdi.
+    as.prologue();
+    for (int i = 0; i < arity; ++i) {
+        as.loadDouble(i, RDI, 8 * i);
+    }
+    as.call(bodyLabel);
+    as.returnFromStub();
+
+    // Body: arguments in xmm0.., result in xmm0, status in eax.
+    as.bind(bodyLabel);
+    as.prologue();
+    int framePatch = as.reserveFrame();
+    beginScope(declaration.slotCount);
+    for (int i = 0; i < arity; ++i) {
+        slotTypes[i] = NativeType::Number;
+        as.storeDouble(RBP, slotOffset(i), i);
+    }
+    for (const auto& statement : declaration.getBody()->statements) {
+        compile(*statement);
+    }
+    endScope();
+    // Falling off the end returns null, which only the interpreter can produce.
+    as.bind(bailLabel);
+    as.setStatus(1);
+    as.bind(exitLabel);
+    as.epilogue();
+
+    if (code.returnType == NativeType::Unknown) throw Unsupported{ "no return statement" };
+    if (selfCalled && code.returnType != NativeType::Number) throw Unsupported{ "recursive call result is not a number" };
+    finishFrame(framePatch);
+    install();
+    code.entry = code.memory;
+    code.body = static_cast<char*>(code.memory) + as.offsetOf(bodyLabel);
+}
+
+void NativeCompiler::compileLoop(const WhileStatement& loop) {
+    bailLabel = as.newLabel();
+    exitLabel = as.newLabel();
+    int loadLabel = as.newLabel();
+    int topLabel = as.newLabel();
+    int doneLabel = as.newLabel();
+
+    // Slot 0 holds the live-in array (rdi); the live-ins follow. Which variables those are
+    // is only known once the loop is compiled, so the code copying them sits at the end.
+    as.prologue();
+    int framePatch = as.reserveFrame();
+    as.storePointer(slotOffset(0), RDI);
+    as.jump(loadLabel);
+
+    firstLocal = nextSlot = maxSlot = 1 + MAX_LIVE_INS;
+    as.bind(topLabel);
+    compile(*loop.condition);
+    jumpIfFalsy(doneLabel);
+    compile(*loop.thenBranch);
+    as.jump(topLabel);
+
+    as.bind(doneLabel);
+    as.loadPointer(RCX, slotOffset(0));
+    for (size_t i = 0; i < code.liveIns.size(); ++i) {
+        if (code.liveIns[i].written) {
+            as.loadDouble(0, RBP, slotOffset(1 + static_cast<int>(i)));
+            as.storeDouble(RCX, 8 * static_cast<int>(i), 0);
+        }
+    }
+    as.setStatus(0);
+    as.jump(exitLabel);
+
+    as.bind(loadLabel);
+    as.loadPointer(RCX, slotOffset(0));
+    for (size_t i = 0; i < code.liveIns.size(); ++i) {
+        as.loadDouble(0, RCX, 8 * static_cast<int>(i));
+        as.storeDouble(RBP, slotOffset(1 + static_cast<int>(i)), 0);
+    }
+    as.jump(topLabel);
+
+    as.bind(bailLabel);
+    as.setStatus(1);
+    as.bind(exitLabel);
+    as.epilogue();
+
+    finishFrame(framePatch);
+    install();
+    code.entry = code.memory;
+}
+
+Value NativeCompiler::visit(const NumberExpr& expr) {
+    as.loadConstant(0, expr.value);
+    resultType = NativeType::Number;
+    return Value();
+}
+
+Value NativeCompiler::visit(const StringExpr& expr) {
+    throw Unsupported{ "string" };
+}
+
+Value NativeCompiler::visit(const BooleanExpr& expr) {
+    as.loadConstant(0, expr.value ? 1.0 : 0.0);
+    resultType = NativeType::Bool;
+    return Value();
+}
+
+Value NativeCompiler::visit(const VariableExpr& expr) {
+    int slot = variableSlot(expr.resolved, expr.name.str(), false);
+    NativeType type = slot < firstLocal ? NativeType::Number : slotTypes[slot];
+    if (type == NativeType::Unknown) throw Unsupported{ "variable of unknown type" };
+    as.loadDouble(0, RBP, slotOffset(slot));
+    resultType = type;
+    return Value();
+}
+
+Value NativeCompiler::visit(const ArrayExpr& expr) {
+    throw Unsupported{ "array" };
+}
+
+Value NativeCompiler::visit(const IndexExpr& expr) {
+    throw Unsupported{ "array" };
+}
+
+Value NativeCompiler::visit(const IndexAssignmentExpr& expr) {
+    throw Unsupported{ "array" };
+}
+
+Value NativeCompiler::visit(const BinaryExpr& expr) {
+    switch (expr.op) {
+        case BinaryOp::Assign: {
+            const VariableExpr* target = dynamic_cast<const VariableExpr*>(expr.left);
+            if (!target) throw Unsupported{ "assignment target" };
+            NativeType type = compile(*expr.right);
+            storeVariable(variableSlot(target->resolved, target->name.str(), true), type);
+            resultType = type;
+            return Value();
+        }
+        case BinaryOp::And: {
+            int falsy = as.newLabel();
+            int end = as.newLabel();
+            compile(*expr.left);
+            jumpIfFalsy(falsy);
+            compile(*expr.right);
+            truthiness();
+            as.jump(end);
+            as.bind(falsy);
+            as.zero(0);
+            as.bind(end);
+            resultType = NativeType::Bool;
+            return Value();
+        }
+        case BinaryOp::Or: {
+            int right = as.newLabel();
+            int end = as.newLabel();
+            compile(*expr.left);
+            jumpIfFalsy(right);
+            as.loadConstant(0, 1.0);
+            as.jump(end);
+            as.bind(right);
+            compile(*expr.right);
+            truthiness();
+            as.bind(end);
+            resultType = NativeType::Bool;
+            return Value();
+        }
+        case BinaryOp::Equal:
+        case BinaryOp::NotEqual: {
+            NativeType leftType = compile(*expr.left);
+            int temp = pushTemp();
+            as.storeDouble(RSP, tempOffset(temp), 0);
+            if (compile(*expr.right) != leftType) throw Unsupported{ "comparison of different types" };
+            as.move(1, 0);
+            as.loadDouble(0, RSP, tempOffset(temp));
+            popTemp();
+            as.ucomisd(0, 1);
+            if (expr.op == BinaryOp::Equal) {
+                as.setFlag(CC_E);
+                as.andFlag(CC_NP);
+            } else {
+                as.setFlag(CC_NE);
+                as.orFlag(CC_P);
+            }
+            as.flagToDouble();
+            resultType = NativeType::Bool;
+            return Value();
+        }
+        default:
+            break;
+    }
+
+    // Arithmetic and ordering: both operands must be numbers, left in xmm0 and right in xmm1.
+    compileNumber(*expr.left);
+    int temp = pushTemp();
+    as.storeDouble(RSP, tempOffset(temp), 0);
+    compileNumber(*expr.right);
+    as.move(1, 0);
+    as.loadDouble(0, RSP, tempOffset(temp));
+    popTemp();
+
+    resultType = NativeType::Number;
+    switch (expr.op) {
+        case BinaryOp::Add: as.addsd(0, 1); break;
+        case BinaryOp::Subtract: as.subsd(0, 1); break;
+        case BinaryOp::Multiply: as.mulsd(0, 1); break;
+        case BinaryOp::Divide:
+            bailIfZero(1);
+            as.divsd(0, 1);
+            break;
+        case BinaryOp::Modulo: {
+            // Zero or fractional operands are runtime errors the interpreter reports.
+            int minusOne = as.newLabel();
+            int end = as.newLabel();
+            bailIfZero(1);
+            as.truncate(RAX, 0);
+            as.ucomisd(2, 0);
+            as.jumpIf(CC_P, bailLabel);
+            as.jumpIf(CC_NE, bailLabel);
+            as.truncate(RCX, 1);
+            as.ucomisd(2, 1);
+            as.jumpIf(CC_P, bailLabel);
+            as.jumpIf(CC_NE, bailLabel);
+            as.compareRcxMinusOne();
+            as.jumpIf(CC_E, minusOne);
+            as.signedRemainder();
+            as.remainderToDouble();
+            as.jump(end);
+            as.bind(minusOne);
+            as.zero(0);
+            as.bind(end);
+            break;
+        }
+        case BinaryOp::Greater:
+            as.ucomisd(0, 1);
+            as.setFlag(CC_A);
+            as.flagToDouble();
+            resultType = NativeType::Bool;
+            break;
+        case BinaryOp::GreaterEqual:
+            as.ucomisd(0, 1);
+            as.setFlag(CC_AE);
+            as.flagToDouble();
+            resultType = NativeType::Bool;
+            break;
+        case BinaryOp::Less:
+            as.ucomisd(1, 0);
+            as.setFlag(CC_A);
+            as.flagToDouble();
+            resultType = NativeType::Bool;
+            break;
+        case BinaryOp::LessEqual:
+            as.ucomisd(1, 0);
+            as.setFlag(CC_AE);
+            as.flagToDouble();
+            resultType = NativeType::Bool;
+            break;
+        default:
+            throw Unsupported{ "operator" };
+    }
+    return Value();
+}
+
+Value NativeCompiler::visit(const UnaryExpr& expr) {
+    if (expr.op == UnaryOp::Negate) {
+        compileNumber(*expr.right);
+        as.negate(0);
+        resultType = NativeType::Number;
+        return Value();
+    }
+    compile(*expr.right);
+    as.zero(1);
+    as.ucomisd(0, 1);
+    as.setFlag(CC_E);
+    as.andFlag(CC_NP);
+    as.flagToDouble();
+    resultType = NativeType::Bool;
+    return Value();
+}
+
+// Only calls to global functions that compile themselves; the callee's body is called directly.
+Value NativeCompiler::visit(const CallExpr& expr) {
+    const VariableExpr* callee = dynamic_cast<const VariableExpr*>(expr.callee);
+    if (!callee || callee->resolved.depth >= 0) throw Unsupported{ "call through a local" };
+    const std::string& name = callee->name.str();
+
+    const FunctionStatement* target = nullptr;
+    try {
+        Value value = jit.globals.get(name);
+        if (value.isCallable()) {
+            if (auto* loxFunction = dynamic_cast<LoxFunction*>(value.asCallable().get())) {
+                target = &loxFunction->declaration;
+            }
+        }
+    } catch (const std::runtime_error&) {
+    }
+    if (!target) throw Unsupported{ "callee is not a global function" };
+    if (target->parameters.size() != expr.arguments.size()) throw Unsupported{ "wrong argument count" };
+
+    Jit::CompiledCode* targetCode = nullptr;
+    if (target != function) {
+        targetCode = jit.compileFunction(*target);
+        if (!targetCode) throw Unsupported{ "callee cannot be compiled" };
+    }
+
+    int firstTemp = temps;
+    for (const auto& argument : expr.arguments) {
+        compileNumber(*argument);
+        as.storeDouble(RSP, tempOffset(pushTemp()), 0);
+    }
+    for (size_t i = 0; i < expr.arguments.size(); ++i) {
+        as.loadDouble(static_cast<int>(i), RSP, tempOffset(firstTemp + static_cast<int>(i)));
+    }
+    temps = firstTemp;
+
+    addDependency(name, target);
+    if (targetCode) {
+        as.callAbsolute(targetCode->body);
+        for (const auto& dependency : targetCode->dependencies) {
+            addDependency(dependency.first, dependency.second);
+        }
+        resultType = targetCode->returnType;
+    } else {
+        as.call(bodyLabel);
+        selfCalled = true;
+        resultType = NativeType::Number;
+    }
+    as.testStatus();
+    as.jumpIf(CC_NE, bailLabel);
+    return Value();
+}
+
+Value NativeCompiler::visit(const UpdateExpr& expr) {
+    throw Unsupported{ "update expression" };
+}
+
+Value NativeCompiler::visit(const GroupingExpr& expr) {
+    compile(*expr.expression);
+    return Value();
+}
+
+Value NativeCompiler::visit(const LetStatement& stmt) {
+    if (stmt.slot < 0 || scopes.empty()) throw Unsupported{ "global declaration" };
+    int slot = scopes.back().base + stmt.slot;
+    NativeType type = stmt.initializer ? compile(*stmt.initializer) : NativeType::Unknown;
+    if (type == NativeType::Unknown) throw Unsupported{ "declaration without a value" };
+    slotTypes[slot] = type;
+    as.storeDouble(RBP, slotOffset(slot), 0);
+    return Value();
+}
+
+Value NativeCompiler::visit(const PrintStatement& stmt) {
+    throw Unsupported{ "print" };
+}
+
+Value NativeCompiler::visit(const ExpressionStatement& stmt) {
+    compile(*stmt.expression);
+    return Value();
+}
+
+Value NativeCompiler::visit(const UpdateStatement& stmt) {
+    int slot = variableSlot(stmt.resolved, stmt.name.str(), true);
+    if (slot >= firstLocal && slotTypes[slot] != NativeType::Number) throw Unsupported{ "update of a non-number" };
+    as.loadDouble(0, RBP, slotOffset(slot));
+    as.loadConstant(1, 1.0);
+    if (stmt.op == UpdateOp::Increment) as.addsd(0, 1);
+    else as.subsd(0, 1);
+    as.storeDouble(RBP, slotOffset(slot), 0);
+    return Value();
+}
+
+Value NativeCompiler::visit(const AssignmentUpdateStatement& stmt) {
+    int slot = variableSlot(stmt.resolved, stmt.name.str(), true);
+    if (slot >= firstLocal && slotTypes[slot] != NativeType::Number) throw Unsupported{ "update of a non-number" };
+    compileNumber(*stmt.value);
+    as.move(1, 0);
+    as.loadDouble(0, RBP, slotOffset(slot));
+    switch (stmt.op) {
+        case BinaryOp::Add: as.addsd(0, 1); break;
+        case BinaryOp::Subtract: as.subsd(0, 1); break;
+        case BinaryOp::Multiply: as.mulsd(0, 1); break;
+        case BinaryOp::Divide:
+            bailIfZero(1);
+            as.divsd(0, 1);
+            break;
+        default: throw Unsupported{ "operator" };
+    }
+    as.storeDouble(RBP, slotOffset(slot), 0);
+    return Value();
+}
+
+Value NativeCompiler::visit(const BlockStatement& stmt) {
+    beginScope(stmt.slotCount);
+    for (const auto& statement : stmt.statements) {
+        compile(*statement);
+    }
+    endScope();
+    return Value();
+}
+
+Value NativeCompiler::visit(const IfStatement& stmt) {
+    int elseLabel = as.newLabel();
+    int end = as.newLabel();
+    compile(*stmt.condition);
+    jumpIfFalsy(elseLabel);
+    compile(*stmt.thenBranch);
+    as.jump(end);
+    as.bind(elseLabel);
+    if (stmt.elseBranch) {
+        compile(*stmt.elseBranch);
+    }
+    as.bind(end);
+    return Value();
+}
+
+Value NativeCompiler::visit(const WhileStatement& stmt) {
+    int top = as.newLabel();
+    int end = as.newLabel();
+    as.bind(top);
+    compile(*stmt.condition);
+    jumpIfFalsy(end);
+    compile(*stmt.thenBranch);
+    as.jump(top);
+    as.bind(end);
+    return Value();
+}
+
+Value NativeCompiler::visit(const FunctionStatement& stmt) {
+    throw Unsupported{ "nested function" };
+}
+
+Value NativeCompiler::visit(const ReturnStatement& stmt) {
+    if (!function || !stmt.expression) throw Unsupported{ "return outside a compiled function" };
+    NativeType type = compile(*stmt.expression);
+    if (code.returnType != NativeType::Unknown && code.returnType != type) throw Unsupported{ "mixed return types" };
+    code.returnType = type;
+    as.setStatus(0);
+    as.jump(exitLabel);
+    return Value();
+}
+
+bool Jit::isSupported() {
+    return MYLANG_JIT_SUPPORTED;
+}
+
+Jit::Jit(Environment& globals) : globals(globals) {}
+
+Jit::~Jit() = default;
+
+Jit::CompiledCode* Jit::compileFunction(const FunctionStatement& declaration) {
+    auto it = functions.find(&declaration);
+    if (it != functions.end()) {
+        CompiledCode* code = it->second.get();
+        return code && !code->compiling ? code : nullptr;
+    }
+    // A caller can be compiled before a callee with a deferred body has run. A body that does
+    // not parse is left for the interpreter to report when it is called.
+    try {
+        declaration.getBody();
+    } catch (const std::runtime_error&) {
+        return nullptr;
+    }
+    std::unique_ptr<CompiledCode>& entry = functions[&declaration];
+    entry = std::make_unique<CompiledCode>();
+    try {
+        NativeCompiler compiler(*this, *entry);
+        compiler.compileFunction(declaration);
+    } catch (const Unsupported& unsupported) {
+        TRACE(Jit, Info, "Not compiling function " << declaration.name << ": " << unsupported.reason);
+        entry.reset();
+        return nullptr;
+    }
+    entry->compiling = false;
+    TRACE(Jit, Info, "Compiled function " << declaration.name);
+    return entry.get();
+}
+
+Jit::CompiledCode* Jit::compileLoop(const WhileStatement& loop) {
+    auto it = loops.find(&loop);
+    if (it != loops.end()) {
+        return it->second.get();
+    }
+    std::unique_ptr<CompiledCode>& entry = loops[&loop];
+    entry = std::make_unique<CompiledCode>();
+    try {
+        NativeCompiler compiler(*this, *entry);
+        compiler.compileLoop(loop);
+    } catch (const Unsupported& unsupported) {
+        TRACE(Jit, Info, "Not compiling loop at line " << loop.line << ": " << unsupported.reason);
+        entry.reset();
+        return nullptr;
+    }
+    entry->compiling = false;
+    TRACE(Jit, Info, "Compiled loop at line " << loop.line << " with " << entry->liveIns.size() << " outer variables");
+    return entry.get();
+}
+
+bool Jit::dependenciesHold(const CompiledCode& code) const {
+    for (const auto& dependency : code.dependencies) {
+        Value value;
+        try {
+            value = globals.get(dependency.first);
+        } catch (const std::runtime_error&) {
+            return false;
+        }
+        if (!value.isCallable()) return false;
+        auto* function = dynamic_cast<LoxFunction*>(value.asCallable().get());
+        if (!function || &function->declaration != dependency.second) return false;
+    }
+    return true;
+}
+
+bool Jit::bailedOut(CompiledCode& code, Feedback<int>& counter) {
+    TRACE(Jit, Debug, "Bailing out to the interpreter");
+    if (++code.bailouts >= MAX_BAILOUTS) {
+        counter = PARKED;
+    }
+    return false;
+}
+
+bool Jit::tryCall(const LoxFunction& function, const std::vector<Value>& arguments, Value& result) {
+    const FunctionStatement& declaration = function.declaration;
+    CompiledCode* code = compileFunction(declaration);
+    if (!code) {
+        declaration.jitCounter = PARKED;
+        return false;
+    }
+
+    double values[MAX_ARGUMENTS];
+    for (size_t i = 0; i < arguments.size(); ++i) {
+        if (!arguments[i].isNumber()) return false;
+        values[i] = arguments[i].asNumber();
+    }
+    if (!dependenciesHold(*code)) return bailedOut(*code, declaration.jitCounter);
+
+    NativeResult native = reinterpret_cast<NativeFunctionEntry>(code->entry)(values);
+    if (native.status != 0) return bailedOut(*code, declaration.jitCounter);
+    result = code->returnType == NativeType::Bool ? Value(native.value != 0) : Value(native.value);
+    return true;
+}
+
+bool Jit::prepare(const FunctionStatement& declaration) {
+    return compileFunction(declaration) != nullptr;
+}
+
+bool Jit::callCompiled(const LoxFunction& function, const std::vector<Value>& arguments, Value& result) const {
+    auto it = functions.find(&function.declaration);
+    if (it == functions.end() || !it->second || it->second->compiling) return false;
+    const CompiledCode& code = *it->second;
+
+    double values[MAX_ARGUMENTS];
+    for (size_t i = 0; i < arguments.size(); ++i) {
+        if (!arguments[i].isNumber()) return false;
+        values[i] = arguments[i].asNumber();
+    }
+    if (!dependenciesHold(code)) return false;
+
+    NativeResult native = reinterpret_cast<NativeFunctionEntry>(code.entry)(values);
+    if (native.status != 0) return false;
+    result = code.returnType == NativeType::Bool ? Value(native.value != 0) : Value(native.value);
+    return true;
+}
+
+bool Jit::tryRunLoop(const WhileStatement& loop, Environment& environment) {
+    CompiledCode* code = compileLoop(loop);
+    if (!code) {
+        loop.jitCounter = PARKED;
+        return false;
+    }
+    if (!dependenciesHold(*code)) return bailedOut(*code, loop.jitCounter);
+
+    double values[MAX_LIVE_INS];
+    for (size_t i = 0; i < code->liveIns.size(); ++i) {
+        const CompiledCode::LiveIn& liveIn = code->liveIns[i];
+        Value value;
+        if (liveIn.depth < 0) {
+            try {
+                value = globals.get(liveIn.global);
+            } catch (const std::runtime_error&) {
+                return bailedOut(*code, loop.jitCounter);
+            }
+        } else {
+            value = environment.getAt(liveIn.depth, liveIn.slot);
+        }
+        if (!value.isNumber()) return bailedOut(*code, loop.jitCounter);
+        values[i] = value.asNumber();
+    }
+
+    if (reinterpret_cast<NativeLoopEntry>(code->entry)(values) != 0) {
+        return bailedOut(*code, loop.jitCounter);
+    }
+    for (size_t i = 0; i < code->liveIns.size(); ++i) {
+        const CompiledCode::LiveIn& liveIn = code->liveIns[i];
+        if (!liveIn.written) continue;
+        if (liveIn.depth < 0) {
+            globals.assign(liveIn.global, Value(values[i]));
+        } else {
+            environment.assignAt(liveIn.depth, liveIn.slot, Value(values[i]));
+        }
+    }
+    return true;
+}
@@ -1,228 +1,301 @@
 ﻿#include "../hpp/Lexer.hpp"
+#include <algorithm>
+#include <cstring>
+#include <exception>
 #include <stdexcept>
-#include <cctype>
 #include <string>
-#include <map>
 #include "../hpp/Token.hpp"
+#include "../hpp/Trace.hpp"
+#include "../hpp/ThreadPool.hpp"
 #include <vector>
 
-bool isAlpha(char c) {
-    return std::isalpha(static_cast<unsigned char>(c)) || c == '_';
+static inline bool isDigit(char c) {
+    return c >= '0' && c <= '9';
 }
 
-bool isAlphaNumeric(char c) {
-    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+static inline bool isAlpha(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
 }
 
-static const std::map<std::string, TokenType> keywords = {
-    {"and", TokenType::AndAnd},
-    {"else", TokenType::Else},
-    {"False", TokenType::False},
-    {"function", TokenType::Function},
-    {"if", TokenType::If},
-    {"let", TokenType::Let},
-    {"print", TokenType::Print},
-    {"return", TokenType::Return},
-    {"True", TokenType::True},
-    {"while", TokenType::While},
-};
-
-std::vector<Token> tokenizeLine(const std::string& line, int line_number)
+static inline bool isAlphaNumeric(char c) {
+    return isAlpha(c) || isDigit(c);
+}
+
+// Keywords are recognised by switching on the first character, so no identifier is hashed or
+// copied. "and" is an alias for "&&".
+static TokenType identifierType(std::string_view text) {
+    switch (text[0]) {
+        case 'a': if (text == "and") return TokenType::AndAnd; break;
+        case 'e': if (text == "else") return TokenType::Else; break;
+        case 'F': if (text == "False") return TokenType::False; break;
+        case 'f': if (text == "function") return TokenType::Function; break;
+        case 'i': if (text == "if") return TokenType::If; break;
+        case 'l': if (text == "let") return TokenType::Let; break;
+        case 'p': if (text == "print") return TokenType::Print; break;
+        case 'r': if (text == "return") return TokenType::Return; break;
+        case 'T': if (text == "True") return TokenType::True; break;
+        case 'w': if (text == "while") return TokenType::While; break;
+    }
+    return TokenType::Identifier;
+}
+
+// The scanner behind Lexer::next() and tokenize(): hands tokens to emit, in order, until emit
+// returns false or the source is used up. Each caller gets its own instantiation with emit
+// inlined, so bulk lexing pays no call per token.
+template <typename Emit>
+static void scan(std::string_view source, size_t& i, int& line_number, Emit emit)
 {
-    std::vector<Token> tokens;
-    int i = 0;
+    const size_t length = source.size();
+
+    bool more = true;
+    // Emits a token of `size` characters starting at i and advances past it.
+    auto add = [&](TokenType type, size_t size) {
+        more = emit(Token(type, source.substr(i, size), line_number));
+        i += size;
+    };
+    auto next = [&](char expected) {
+        return i + 1 < length && source[i + 1] == expected;
+    };
 
-    while (i < line.length()) {
-        char c = line[i];
+    while (more && i < length) {
+        char c = source[i];
 
         switch (c) {
-            case '(': tokens.emplace_back(TokenType::LParen, "(", line_number); i++; break;
-            case ')': tokens.emplace_back(TokenType::RParen, ")", line_number); i++; break;
-            case '{': tokens.emplace_back(TokenType::LBrace, "{", line_number); i++; break;
-            case '}': tokens.emplace_back(TokenType::RBrace, "}", line_number); i++; break;
-            case ',': tokens.emplace_back(TokenType::Comma, ",", line_number); i++; break;
-            case '.': tokens.emplace_back(TokenType::Dot, ".", line_number); i++; break;
-            case ';': tokens.emplace_back(TokenType::Semicolon, ";", line_number); i++; break;
-            case '[': tokens.emplace_back(TokenType::LeftSquare, "[", line_number); i++; break;
-            case ']': tokens.emplace_back(TokenType::RightSquare, "]", line_number); i++; break;
+            case '(': add(TokenType::LParen, 1); break;
+            case ')': add(TokenType::RParen, 1); break;
+            case '{': add(TokenType::LBrace, 1); break;
+            case '}': add(TokenType::RBrace, 1); break;
+            case ',': add(TokenType::Comma, 1); break;
+            case '.': add(TokenType::Dot, 1); break;
+            case ';': add(TokenType::Semicolon, 1); break;
+            case '[': add(TokenType::LeftSquare, 1); break;
+            case ']': add(TokenType::RightSquare, 1); break;
+            case '%': add(TokenType::Modulo, 1); break;
 
             case '*':
-                if (i + 1 < line.length() && line[i + 1] == '=') {
-                    tokens.emplace_back(TokenType::StarEqual, "*=", line_number);
-                    i += 2;
-                } else {
-                    tokens.emplace_back(TokenType::Star, "*", line_number);
-                    i++;
-                }
+                if (next('=')) add(TokenType::StarEqual, 2);
+                else add(TokenType::Star, 1);
                 break;
 
             case '+':
-                if (i + 1 < line.length()) {
-                    if (line[i + 1] == '=') {
-                        tokens.emplace_back(TokenType::PlusEqual, "+=", line_number);
-                        i += 2;
-                        break;
-                    } else if (line[i + 1] == '+') {
-                        tokens.emplace_back(TokenType::PlusPlus, "++", line_number);
-                        i += 2;
-                        break;
-                    }
-                }
-                tokens.emplace_back(TokenType::Plus, "+", line_number);
-                i++;
+                if (next('=')) add(TokenType::PlusEqual, 2);
+                else if (next('+')) add(TokenType::PlusPlus, 2);
+                else add(TokenType::Plus, 1);
                 break;
 
             case '-':
-                if (i + 1 < line.length()) {
-                    if (line[i + 1] == '-') {
-                        tokens.emplace_back(TokenType::MinusMinus, "--", line_number);
-                        i += 2;
-                        break;
-                    } else if (line[i + 1] == '=') {
-                        tokens.emplace_back(TokenType::MinusEqual, "-=", line_number);
-                        i += 2;
-                        break;
-                    }
-                }
-                tokens.emplace_back(TokenType::Minus, "-", line_number);
-                i++;
+                if (next('-')) add(TokenType::MinusMinus, 2);
+                else if (next('=')) add(TokenType::MinusEqual, 2);
+                else add(TokenType::Minus, 1);
                 break;
 
             case '/':
-                if (i + 1 < line.length()) {
-                    if (line[i + 1] == '=') {
-                        tokens.emplace_back(TokenType::SlashEqual, "/=", line_number);
-                        i += 2;
-                        break;
-                    } else if (line[i + 1] == '/') {
-                        i = line.length();
-                        break;
+                if (next('=')) {
+                    add(TokenType::SlashEqual, 2);
+                } else if (next('/')) {
+                    while (i < length && source[i] != '\n') {
+                        i++;
                     }
+                } else {
+                    add(TokenType::Slash, 1);
                 }
-                tokens.emplace_back(TokenType::Slash, "/", line_number);
-                i++;
                 break;
 
             case '=':
-                if (i + 1 < line.length() && line[i + 1] == '=') {
-                    tokens.emplace_back(TokenType::EqualEqual, "==", line_number);
-                    i += 2;
-                } else {
-                    tokens.emplace_back(TokenType::Equal, "=", line_number);
-                    i++;
-                }
+                if (next('=')) add(TokenType::EqualEqual, 2);
+                else add(TokenType::Equal, 1);
                 break;
 
             case '!':
-                if (i + 1 < line.length() && line[i + 1] == '=') {
-                    tokens.emplace_back(TokenType::BangEqual, "!=", line_number);
-                    i += 2;
-                } else {
-                    tokens.emplace_back(TokenType::Bang, "!", line_number);
-                    i++;
-                }
+                if (next('=')) add(TokenType::BangEqual, 2);
+                else add(TokenType::Bang, 1);
                 break;
 
             case '>':
-                if (i + 1 < line.length() && line[i + 1] == '=') {
-                    tokens.emplace_back(TokenType::GreaterEqual, ">=", line_number);
-                    i += 2;
-                } else {
-                    tokens.emplace_back(TokenType::Greater, ">", line_number);
-                    i++;
-                }
+                if (next('=')) add(TokenType::GreaterEqual, 2);
+                else add(TokenType::Greater, 1);
                 break;
 
             case '<':
-                if (i + 1 < line.length() && line[i + 1] == '=') {
-                    tokens.emplace_back(TokenType::LessEqual, "<=", line_number);
-                    i += 2;
-                } else {
-                    tokens.emplace_back(TokenType::Less, "<", line_number);
-                    i++;
-                }
+                if (next('=')) add(TokenType::LessEqual, 2);
+                else add(TokenType::Less, 1);
                 break;
 
             case '&':
-                if (i + 1 < line.length() && line[i + 1] == '&') {
-                    tokens.emplace_back(TokenType::AndAnd, "&&", line_number);
-                    i += 2;
+                if (next('&')) {
+                    add(TokenType::AndAnd, 2);
                 } else {
                     throw std::runtime_error("Unexpected character '&' at line " + std::to_string(line_number) + ". Expected '&&'.");
                 }
                 break;
 
             case '|':
-                if (i + 1 < line.length() && line[i + 1] == '|') {
-                    tokens.emplace_back(TokenType::OrOr, "||", line_number);
-                    i += 2;
+                if (next('|')) {
+                    add(TokenType::OrOr, 2);
                 } else {
                     throw std::runtime_error("Unexpected character '|' at line " + std::to_string(line_number) + ". Expected '||'.");
                 }
                 break;
 
-            case ' ':
-            case '\t':
-            case '\r':
+            case '\n':
+                line_number++;
                 i++;
                 break;
 
-            case '%':
-                tokens.emplace_back(TokenType::Modulo, "%", line_number);
+            case ' ':
+            case '\t':
+            case '\r':
                 i++;
                 break;
 
             case '"': {
-                i++;
-                int start_string = i;
-                while (i < line.length() && line[i] != '"') {
-                    if (line[i] == '\n') {
-                        throw std::runtime_error("Unterminated string literal (newline) at line " + std::to_string(line_number));
-                    }
+                size_t start_string = ++i;
+                while (i < length && source[i] != '"' && source[i] != '\n') {
                     i++;
                 }
-                if (i == line.length()) {
+                if (i == length || source[i] == '\n') {
                     throw std::runtime_error("Unterminated string literal at line " + std::to_string(line_number));
                 }
-                tokens.emplace_back(TokenType::String, line.substr(start_string, i - start_string), line_number);
+                more = emit(Token(TokenType::String, source.substr(start_string, i - start_string), line_number));
                 i++;
                 break;
             }
 
             case '0': case '1': case '2': case '3': case '4':
             case '5': case '6': case '7': case '8': case '9': {
-                int start_num = i;
-                while (i < line.length() && std::isdigit(static_cast<unsigned char>(line[i]))) {
+                size_t start_num = i;
+                while (i < length && isDigit(source[i])) {
                     i++;
                 }
-                if (i < line.length() && line[i] == '.') {
+                if (i < length && source[i] == '.') {
                     i++;
-                    while (i < line.length() && std::isdigit(static_cast<unsigned char>(line[i]))) {
+                    while (i < length && isDigit(source[i])) {
                         i++;
                     }
                 }
-                tokens.emplace_back(TokenType::Number, line.substr(start_num, i - start_num), line_number);
+                more = emit(Token(TokenType::Number, source.substr(start_num, i - start_num), line_number));
                 break;
             }
 
             default:
                 if (isAlpha(c)) {
-                    int start_id = i;
-                    while (i < line.length() && isAlphaNumeric(line[i])) {
+                    size_t start_id = i;
+                    while (i < length && isAlphaNumeric(source[i])) {
                         i++;
                     }
-                    std::string text = line.substr(start_id, i - start_id);
-                    auto it = keywords.find(text);
-                    if (it != keywords.end()) {
-                        tokens.emplace_back(it->second, text, line_number);
-                    } else {
-                        tokens.emplace_back(TokenType::Identifier, text, line_number);
-                    }
+                    std::string_view text = source.substr(start_id, i - start_id);
+                    more = emit(Token(identifierType(text), text, line_number));
                 } else {
                     throw std::runtime_error("Unexpected character '" + std::string(1, c) + "' at line " + std::to_string(line_number));
                 }
                 break;
         }
     }
+}
+
+// Matches the line-by-line reader, which put EndOfFile one past the last line.
+static Token endOfFile(std::string_view source, int line_number)
+{
+    int eofLine = (source.empty() || source.back() != '\n') ? line_number + 1 : line_number;
+    return Token(TokenType::EndOfFile, std::string_view(), eofLine);
+}
+
+Token Lexer::next()
+{
+    Token token = endOfFile(source, line_number);
+    scan(source, i, line_number, [&](const Token& scanned) {
+        token = scanned;
+        return false;
+    });
+    return token;
+}
+
+std::vector<Token> tokenize(std::string_view source, int firstLine)
+{
+    std::vector<Token> tokens;
+    // Generous on purpose: capacity that is never written costs address space, not memory.
+    tokens.reserve(source.size() / 2 + 1);
+    size_t i = 0;
+    int line_number = firstLine;
+    scan(source, i, line_number, [&](const Token& token) {
+        tokens.push_back(token);
+        return true;
+    });
+    tokens.push_back(endOfFile(source, line_number));
+    TRACE(Lexer, Debug, "Lexed " << source.size() << " bytes into " << tokens.size() << " tokens");
+    return tokens;
+}
+
+// Below this a source is lexed on the calling thread; handing it to the pool costs more.
+static constexpr size_t PARALLEL_THRESHOLD = 1 << 20;
+static constexpr size_t MIN_CHUNK = 256 * 1024;
+static constexpr size_t CHUNKS_PER_THREAD = 4;
+
+std::vector<Token> tokenizeParallel(std::string_view source)
+{
+    ThreadPool& pool = ThreadPool::shared();
+    if (source.size() < PARALLEL_THRESHOLD || pool.size() == 1) {
+        return tokenize(source);
+    }
+
+    // Every chunk but the last ends just after a newline.
+    size_t target = std::max(MIN_CHUNK, source.size() / (pool.size() * CHUNKS_PER_THREAD));
+    std::vector<std::string_view> chunks;
+    for (size_t start = 0; start < source.size();) {
+        size_t end = std::min(start + target, source.size());
+        if (end < source.size()) {
+            const void* newline = std::memchr(source.data() + end, '\n', source.size() - end);
+            end = newline ? static_cast<const char*>(newline) - source.data() + 1 : source.size();
+        }
+        chunks.push_back(source.substr(start, end - start));
+        start = end;
+    }
+    if (chunks.size() == 1) {
+        return tokenize(source);
+    }
+
+    // Counting newlines is far cheaper than lexing, so each chunk learns its first line up front
+    // and lexes with the right numbers, error messages included.
+    std::vector<int> firstLines(chunks.size());
+    pool.run(chunks.size(), [&](size_t chunk, size_t) {
+        firstLines[chunk] = static_cast<int>(std::count(chunks[chunk].begin(), chunks[chunk].end(), '\n'));
+    });
+    int line = 1;
+    for (int& first : firstLines) {
+        int newlines = first;
+        first = line;
+        line += newlines;
+    }
+
+    std::vector<std::vector<Token>> lexed(chunks.size());
+    std::vector<std::exception_ptr> errors(chunks.size());
+    pool.run(chunks.size(), [&](size_t chunk, size_t) {
+        try {
+            lexed[chunk] = tokenize(chunks[chunk], firstLines[chunk]);
+        } catch (...) {
+            errors[chunk] = std::current_exception();
+        }
+    });
+    for (const std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    // Each chunk ends in its own EndOfFile; only the last one's is kept.
+    size_t total = 1;
+    for (const std::vector<Token>& part : lexed) {
+        total += part.size() - 1;
+    }
+    std::vector<Token> tokens;
+    tokens.reserve(total);
+    for (size_t chunk = 0; chunk < lexed.size(); ++chunk) {
+        std::vector<Token>& part = lexed[chunk];
+        size_t keep = chunk + 1 == lexed.size() ? part.size() : part.size() - 1;
+        tokens.insert(tokens.end(), part.begin(), part.begin() + static_cast<std::ptrdiff_t>(keep));
+        std::vector<Token>().swap(part);
+    }
+    TRACE(Lexer, Debug, "Lexed " << source.size() << " bytes in " << chunks.size() << " chunks on "
+                                 << pool.size() << " threads");
     return tokens;
 }
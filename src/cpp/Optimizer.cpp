@@ -0,0 +1,269 @@
+#include "../hpp/Optimizer.hpp"
+#include "../hpp/Trace.hpp"
+#include <stdexcept>
+
+// The Visitor interface hands out const nodes, but the Optimizer owns the tree it is rewriting
+// (every node is a non-const object in the Program's arena), so its visits cast constness away.
+
+Optimizer::Optimizer(Program& program) : program(program) {}
+
+void Optimizer::optimize() {
+    program.statements = optimize(program.statements);
+    TRACE(Optimizer, Info, "Optimizer folded " << foldedExpressions << " expressions, removed "
+          << removedStatements << " unreachable statements, shared " << constantArrays << " array literals");
+}
+
+void Optimizer::optimizeBody(BlockStatement& body) {
+    body.statements = optimize(body.statements);
+}
+
+Statement* Optimizer::optimizeStatement(Statement* statement) {
+    return optimize(statement);
+}
+
+Expression* Optimizer::optimize(Expression* expr) {
+    expressionResult = expr;
+    expr->accept(*this);
+    return expressionResult;
+}
+
+Statement* Optimizer::optimize(Statement* stmt) {
+    statementResult = stmt;
+    stmt->accept(*this);
+    return statementResult;
+}
+
+StatementList Optimizer::optimize(StatementList statements) {
+    std::vector<Statement*> kept;
+    kept.reserve(statements.size());
+    for (Statement* statement : statements) {
+        if (Statement* result = optimize(statement)) {
+            kept.push_back(result);
+        }
+    }
+    if (kept.size() != statements.size()) {
+        return program.arena.copy(kept);
+    }
+    for (size_t i = 0; i < kept.size(); ++i) {
+        statements[i] = kept[i];
+    }
+    return statements;
+}
+
+bool Optimizer::isLiteral(const Expression* expr) {
+    return dynamic_cast<const NumberExpr*>(expr) || dynamic_cast<const StringExpr*>(expr) ||
+           dynamic_cast<const BooleanExpr*>(expr);
+}
+
+Expression* Optimizer::literalFor(const Value& value) {
+    if (value.isNumber()) return program.arena.make<NumberExpr>(value.asNumber());
+    if (value.isBool()) return program.arena.make<BooleanExpr>(value.asBool());
+    if (value.isString()) return program.arena.make<StringExpr>(value.asString());
+    return nullptr;
+}
+
+// Evaluates an expression whose operands are literals. Returns nullptr when it would fail at
+// runtime, so the failure is kept for the program to report.
+Expression* Optimizer::fold(const Expression& expr) {
+    Value result;
+    try {
+        result = expr.accept(folder);
+    } catch (const std::runtime_error&) {
+        return nullptr;
+    }
+    Expression* literal = literalFor(result);
+    if (literal) {
+        foldedExpressions++;
+    }
+    return literal;
+}
+
+Value Optimizer::visit(const NumberExpr& expr) {
+    return Value();
+}
+
+Value Optimizer::visit(const StringExpr& expr) {
+    return Value();
+}
+
+Value Optimizer::visit(const BooleanExpr& expr) {
+    return Value();
+}
+
+Value Optimizer::visit(const VariableExpr& expr) {
+    return Value();
+}
+
+Value Optimizer::visit(const ArrayExpr& expr) {
+    auto& node = const_cast<ArrayExpr&>(expr);
+    bool allLiterals = true;
+    for (Expression*& element : node.elements) {
+        element = optimize(element);
+        allLiterals = allLiterals && isLiteral(element);
+    }
+    // Elements that are arrays themselves are left out: each evaluation must create new ones.
+    if (allLiterals) {
+        node.constant = node.accept(folder);
+        constantArrays++;
+    }
+    expressionResult = &node;
+    return Value();
+}
+
+Value Optimizer::visit(const IndexExpr& expr) {
+    auto& node = const_cast<IndexExpr&>(expr);
+    node.array = optimize(node.array);
+    node.index = optimize(node.index);
+    expressionResult = &node;
+    return Value();
+}
+
+Value Optimizer::visit(const IndexAssignmentExpr& expr) {
+    auto& node = const_cast<IndexAssignmentExpr&>(expr);
+    node.array = optimize(node.array);
+    node.index = optimize(node.index);
+    node.value = optimize(node.value);
+    expressionResult = &node;
+    return Value();
+}
+
+Value Optimizer::visit(const BinaryExpr& expr) {
+    auto& node = const_cast<BinaryExpr&>(expr);
+    if (node.op != BinaryOp::Assign) {
+        node.left = optimize(node.left);
+    }
+    node.right = optimize(node.right);
+
+    Expression* folded = nullptr;
+    if (node.op != BinaryOp::Assign && isLiteral(node.left) && isLiteral(node.right)) {
+        folded = fold(node);
+    }
+    expressionResult = folded ? folded : &node;
+    return Value();
+}
+
+Value Optimizer::visit(const UnaryExpr& expr) {
+    auto& node = const_cast<UnaryExpr&>(expr);
+    node.right = optimize(node.right);
+
+    Expression* folded = isLiteral(node.right) ? fold(node) : nullptr;
+    expressionResult = folded ? folded : &node;
+    return Value();
+}
+
+Value Optimizer::visit(const CallExpr& expr) {
+    auto& node = const_cast<CallExpr&>(expr);
+    node.callee = optimize(node.callee);
+    for (Expression*& argument : node.arguments) {
+        argument = optimize(argument);
+    }
+    expressionResult = &node;
+    return Value();
+}
+
+Value Optimizer::visit(const UpdateExpr& expr) {
+    auto& node = const_cast<UpdateExpr&>(expr);
+    if (node.right) {
+        node.right = optimize(node.right);
+    }
+    expressionResult = &node;
+    return Value();
+}
+
+Value Optimizer::visit(const GroupingExpr& expr) {
+    auto& node = const_cast<GroupingExpr&>(expr);
+    node.expression = optimize(node.expression);
+    expressionResult = isLiteral(node.expression) ? node.expression : &node;
+    return Value();
+}
+
+Value Optimizer::visit(const LetStatement& stmt) {
+    auto& node = const_cast<LetStatement&>(stmt);
+    if (node.initializer) {
+        node.initializer = optimize(node.initializer);
+    }
+    statementResult = &node;
+    return Value();
+}
+
+Value Optimizer::visit(const PrintStatement& stmt) {
+    auto& node = const_cast<PrintStatement&>(stmt);
+    node.expression = optimize(node.expression);
+    statementResult = &node;
+    return Value();
+}
+
+Value Optimizer::visit(const ExpressionStatement& stmt) {
+    auto& node = const_cast<ExpressionStatement&>(stmt);
+    node.expression = optimize(node.expression);
+    statementResult = &node;
+    return Value();
+}
+
+Value Optimizer::visit(const UpdateStatement& stmt) {
+    return Value();
+}
+
+Value Optimizer::visit(const AssignmentUpdateStatement& stmt) {
+    auto& node = const_cast<AssignmentUpdateStatement&>(stmt);
+    node.value = optimize(node.value);
+    statementResult = &node;
+    return Value();
+}
+
+Value Optimizer::visit(const BlockStatement& stmt) {
+    auto& node = const_cast<BlockStatement&>(stmt);
+    node.statements = optimize(node.statements);
+    statementResult = &node;
+    return Value();
+}
+
+Value Optimizer::visit(const IfStatement& stmt) {
+    auto& node = const_cast<IfStatement&>(stmt);
+    node.condition = optimize(node.condition);
+    node.thenBranch = optimize(node.thenBranch);
+    if (node.elseBranch) {
+        node.elseBranch = optimize(node.elseBranch);
+    }
+
+    // Branches are blocks, so the one that is kept still opens its own scope.
+    statementResult = &node;
+    if (isLiteral(node.condition)) {
+        statementResult = folder.isTruthy(node.condition->accept(folder)) ? node.thenBranch : node.elseBranch;
+        removedStatements++;
+    }
+    return Value();
+}
+
+Value Optimizer::visit(const WhileStatement& stmt) {
+    auto& node = const_cast<WhileStatement&>(stmt);
+    node.condition = optimize(node.condition);
+    if (isLiteral(node.condition) && !folder.isTruthy(node.condition->accept(folder))) {
+        statementResult = nullptr;
+        removedStatements++;
+        return Value();
+    }
+    node.thenBranch = optimize(node.thenBranch);
+    statementResult = &node;
+    return Value();
+}
+
+Value Optimizer::visit(const FunctionStatement& stmt) {
+    auto& node = const_cast<FunctionStatement&>(stmt);
+    if (!node.isParsed()) {
+        node.deferred->optimize = true;
+    } else {
+        node.body->statements = optimize(node.body->statements);
+    }
+    statementResult = &node;
+    return Value();
+}
+
+Value Optimizer::visit(const ReturnStatement& stmt) {
+    auto& node = const_cast<ReturnStatement&>(stmt);
+    if (node.expression) {
+        node.expression = optimize(node.expression);
+    }
+    statementResult = &node;
+    return Value();
+}
@@ -0,0 +1,133 @@
+#include "../hpp/Builtins.hpp"
+#include "../hpp/Interpreter.hpp"
+#include "../hpp/ThreadPool.hpp"
+#include "../hpp/Jit.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+// Enough chunks per thread for stealing to even out uneven element costs.
+constexpr size_t CHUNKS_PER_THREAD = 8;
+
+// Owner ids for pool threads; every parallel call takes a fresh block (see Obj::owner).
+std::atomic<uint32_t> nextOwner{1};
+
+double integerArgument(const char* function, const Value& value) {
+    if (!value.isNumber() || std::floor(value.asNumber()) != value.asNumber()) {
+        throw std::runtime_error(std::string(function) + " expects integer bounds.");
+    }
+    return value.asNumber();
+}
+
+std::shared_ptr<Callable> callbackArgument(const char* function, const Value& value, int minArity, int maxArity) {
+    std::shared_ptr<Callable> callback = Interpreter::callableOf(value);
+    if (callback->arity() < minArity || callback->arity() > maxArity) {
+        std::string expected = minArity == maxArity ? std::to_string(minArity)
+                                                    : std::to_string(minArity) + " or " + std::to_string(maxArity);
+        throw std::runtime_error(std::string(function) + " callback must take " + expected + " arguments.");
+    }
+    return callback;
+}
+
+// Calls callback with argumentsFor(i) for every i in [0, count) and returns the results in
+// order. Script functions are split into chunks over the thread pool, each pool thread calling
+// them through its own Interpreter on the shared globals. Other callables (natives, VM
+// closures), and calls made from inside a parallel function, run on the calling thread.
+std::vector<Value> callAll(Interpreter& interpreter, Callable& callback, size_t count,
+                           const std::function<std::vector<Value>(size_t)>& argumentsFor) {
+    std::vector<Value> results(count);
+    auto* function = dynamic_cast<LoxFunction*>(&callback);
+    bool parallel = count > 1 && Obj::currentOwner == 0 && function != nullptr;
+    if (!parallel || ThreadPool::shared().size() == 1) {
+        for (size_t i = 0; i < count; ++i) {
+            results[i] = callback.call(interpreter, argumentsFor(i));
+        }
+        return results;
+    }
+
+    ThreadPool& pool = ThreadPool::shared();
+    // A deferred body is parsed here, where a syntax error in it is reported like any other.
+    function->declaration.getBody();
+    if (Jit* jit = interpreter.getJit()) {
+        jit->prepare(function->declaration);
+    }
+    size_t chunkSize = (count + pool.size() * CHUNKS_PER_THREAD - 1) / (pool.size() * CHUNKS_PER_THREAD);
+    size_t chunks = (count + chunkSize - 1) / chunkSize;
+    std::vector<std::unique_ptr<Interpreter>> workers(pool.size());
+    uint32_t firstOwner = nextOwner.fetch_add(static_cast<uint32_t>(pool.size()));
+    InternTable* strings = &InternTable::current();
+
+    Obj::concurrent.fetch_add(1);
+    try {
+        pool.run(chunks, [&](size_t chunk, size_t thread) {
+            Obj::currentOwner = firstOwner + static_cast<uint32_t>(thread);
+            InternTable::makeCurrent(strings);
+            if (!workers[thread]) {
+                workers[thread] = std::make_unique<Interpreter>(interpreter.getGlobals(), interpreter.getJit(),
+                                                                interpreter.output());
+            }
+            size_t end = std::min(count, (chunk + 1) * chunkSize);
+            for (size_t i = chunk * chunkSize; i < end; ++i) {
+                results[i] = callback.call(*workers[thread], argumentsFor(i));
+            }
+        });
+    } catch (...) {
+        Obj::currentOwner = 0;
+        Obj::concurrent.fetch_sub(1);
+        throw;
+    }
+    Obj::currentOwner = 0;
+    Obj::concurrent.fetch_sub(1);
+    return results;
+}
+
+} // namespace
+
+void defineParallelBuiltins(Environment& builtins) {
+    defineNative(builtins, "parallel_map", 2, [](Interpreter& interpreter, std::vector<Value> arguments) {
+        const Value& array = arguments[0];
+        if (!array.isArray() && !array.isFloat64Array()) {
+            throw std::runtime_error("parallel_map expects an array.");
+        }
+        std::shared_ptr<Callable> callback = callbackArgument("parallel_map", arguments[1], 1, 2);
+        bool withIndex = callback->arity() == 2;
+
+        if (array.isArray()) {
+            Value snapshot = Value::copyArray(array);
+            ArrayView elements = snapshot.asArray();
+            return Value(callAll(interpreter, *callback, elements.size(), [&](size_t i) {
+                std::vector<Value> call{ elements[i] };
+                if (withIndex) call.push_back(Value(static_cast<double>(i)));
+                return call;
+            }));
+        }
+        std::vector<double> elements = array.asFloat64Array();
+        std::vector<Value> results = callAll(interpreter, *callback, elements.size(), [&](size_t i) {
+            std::vector<Value> call{ Value(elements[i]) };
+            if (withIndex) call.push_back(Value(static_cast<double>(i)));
+            return call;
+        });
+        std::vector<double> numbers(results.size());
+        for (size_t i = 0; i < results.size(); ++i) {
+            if (!results[i].isNumber()) {
+                throw std::runtime_error("parallel_map over a Float64Array must produce numbers.");
+            }
+            numbers[i] = results[i].asNumber();
+        }
+        return Value::float64Array(std::move(numbers));
+    });
+    defineNative(builtins, "parallel_for", 3, [](Interpreter& interpreter, std::vector<Value> arguments) {
+        double start = integerArgument("parallel_for", arguments[0]);
+        double end = integerArgument("parallel_for", arguments[1]);
+        if (end < start) {
+            throw std::runtime_error("parallel_for needs start <= end.");
+        }
+        std::shared_ptr<Callable> callback = callbackArgument("parallel_for", arguments[2], 1, 1);
+        size_t count = static_cast<size_t>(end - start);
+        return Value(callAll(interpreter, *callback, count, [&](size_t i) {
+            return std::vector<Value>{ Value(start + static_cast<double>(i)) };
+        }));
+    });
+}
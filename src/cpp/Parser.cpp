@@ -2,77 +2,126 @@
 #include "../hpp/Token.hpp"  
 #include <stdexcept>
 #include <iostream> 
+#include <mutex>
+#include <array>
+#include "../hpp/Trace.hpp"
 #include "../hpp/AST.hpp"    
+#include "../hpp/Lexer.hpp"
+#include "../hpp/Optimizer.hpp"
+#include "../hpp/Resolver.hpp"
 
-Parser::Parser(const std::vector<Token>& tokens) : tokens(tokens) {
-    std::cout << "DEBUG: Parser constructor called. Total tokens received: " << tokens.size() << std::endl;
+Parser::Parser(const std::vector<Token>& tokens, bool deferBodies)
+    : Parser(TokenStream(tokens), parsed, deferBodies) {
+    TRACE(Parser, Debug, "Parser constructor called. Total tokens received: " << tokens.size());
     if (!tokens.empty()) {
-        std::cout << "DEBUG: First token received in parser: '" << tokens[0].getLexeme() << "' (Type: " << (int)tokens[0].getTokenType() << ")" << std::endl;
+        TRACE(Parser, Debug, "First token received in parser: '" << tokens[0].getLexeme() << "' (Type: " << (int)tokens[0].getTokenType() << ")");
     }
     else {
-        std::cout << "DEBUG: Parser received an empty token list." << std::endl;
+        TRACE(Parser, Debug, "Parser received an empty token list.");
     }
 }
 
-std::vector<std::unique_ptr<Statement>> Parser::parse() {
-    std::cout << "DEBUG: Entering Parser::parse()" << std::endl;
-    std::vector<std::unique_ptr<Statement>> statements;
+Parser::Parser(TokenStream tokens, Program& target, bool deferBodies)
+    : tokens(tokens),
+      lookahead{ Token(TokenType::EndOfFile, "", 0), Token(TokenType::EndOfFile, "", 0) },
+      last(TokenType::EndOfFile, "", 0), program(target), deferBodies(deferBodies) {}
 
-    while (!isAtEnd()) {
-        statements.push_back(parseStatement());
+Program Parser::parse() {
+    TRACE(Parser, Debug, "Entering Parser::parse()");
+    std::vector<Statement*> statements;
+
+    while (Statement* statement = parseNext()) {
+        statements.push_back(statement);
     }
-    std::cout << "DEBUG: Exiting Parser::parse() successfully" << std::endl;
-    return statements;
+    program.statements = program.arena.copy(statements);
+    TRACE(Parser, Debug, "Exiting Parser::parse() successfully, " << program.arena.bytesUsed() << " bytes of AST");
+    return std::move(parsed);
 }
 
-const Token& Parser::peek() const {
-    std::cout << "DEBUG: Entering peek(). current index: " << current << ", total tokens: " << tokens.size() << std::endl;
-    if (current >= tokens.size()) {
-        static Token eof_token(TokenType::EndOfFile, "", tokens.empty() ? 0 : tokens.back().getLine());
-        std::cout << "DEBUG: peek() returning EndOfFile token due to current index being out of bounds." << std::endl;
-        return eof_token;
+Statement* Parser::parseNext() {
+    if (isAtEnd()) {
+        return nullptr;
     }
+    int line = peek().getLine();
+    Statement* statement = parseStatement();
+    statement->line = line;
+    return statement;
+}
 
-    std::cout << "DEBUG: peek() returning token: '" << tokens[current].getLexeme() << "' (type: " << (int)tokens[current].getTokenType() << ")" << std::endl;
-    return tokens[current];
+BlockStatement* Parser::parseDeferred(std::string_view text, int line, Program& program) {
+    Parser parser(TokenStream(text, line), program);
+    BlockStatement* body = parser.parseBlockStatement();
+    if (!parser.isAtEnd()) {
+        throw std::runtime_error("Internal Parser Error: deferred body continues after its closing brace.");
+    }
+    return body;
 }
 
-const Token& Parser::peekNext() const {
-    std::cout << "DEBUG: Entering peekNext(). current index: " << current << ", total tokens: " << tokens.size() << std::endl;
-    if (current + 1 >= tokens.size()) {
-        static Token eof_token(TokenType::EndOfFile, "", tokens.empty() ? 0 : tokens.back().getLine());
-        std::cout << "DEBUG: peek() returning EndOfFile token due to current index being out of bounds." << std::endl;
-        return eof_token;
+// Deferred bodies belong to top-level functions, so they are resolved as if no local scope
+// enclosed them, just as the Resolver would have done in the first place. Calls from pool
+// threads may race to parse the same body; the lock makes one of them do it.
+BlockStatement* FunctionStatement::parseDeferredBody() const {
+    static std::mutex parseMutex;
+    std::lock_guard<std::mutex> lock(parseMutex);
+    if (body) {
+        return body;
+    }
+    TRACE(Parser, Debug, "Parsing the deferred body of " << name);
+    Program& program = *deferred->program;
+    BlockStatement* parsedBody = Parser::parseDeferred(deferred->text, deferred->line, program);
+    if (deferred->optimize) {
+        Optimizer(program).optimizeBody(*parsedBody);
     }
+    Resolver().resolveBody(*this, *parsedBody);
+    __atomic_store_n(&body, parsedBody, __ATOMIC_RELEASE);
+    return parsedBody;
+}
 
-    std::cout << "DEBUG: peek() returning token: '" << tokens[current+1].getLexeme() << "' (type: " << (int)tokens[current+1].getTokenType() << ")" << std::endl;
-    return tokens[current+1];
+Symbol Parser::intern(const Token& token) {
+    return program.symbols.intern(token.getLexeme());
 }
 
+void Parser::fill(int count) const {
+    while (buffered < count) {
+        lookahead[buffered++] = tokens.next();
+    }
+}
 
+const Token& Parser::peek() const {
+    fill(1);
+    TRACE(Parser, Verbose, "peek() returning token " << consumed << ": '" << lookahead[0].getLexeme() << "' (type: " << (int)lookahead[0].getTokenType() << ")");
+    return lookahead[0];
+}
+
+const Token& Parser::peekNext() const {
+    fill(2);
+    TRACE(Parser, Verbose, "peekNext() returning token " << consumed + 1 << ": '" << lookahead[1].getLexeme() << "' (type: " << (int)lookahead[1].getTokenType() << ")");
+    return lookahead[1];
+}
 
 bool Parser::isAtEnd() const {
-    std::cout << "DEBUG: Entering isAtEnd(). current index: " << current << ", total tokens: " << tokens.size() << std::endl;
-    bool atEnd = current >= tokens.size() || tokens[current].getTokenType() == TokenType::EndOfFile;
-    std::cout << "DEBUG: isAtEnd() result: " << (atEnd ? "true" : "false") << std::endl;
+    bool atEnd = peek().getTokenType() == TokenType::EndOfFile;
+    TRACE(Parser, Verbose, "isAtEnd() result: " << (atEnd ? "true" : "false"));
     return atEnd;
 }
 const Token& Parser::previous() const {
-    if (current == 0)
+    if (consumed == 0)
         throw std::runtime_error("Internal Parser Error: Attempted to get previous token at start of stream.");
-    return tokens[current - 1];
+    return last;
 }
 
 
 void Parser::advance() {
-    if (!isAtEnd())
-        current += 1;
+    if (isAtEnd())
+        return;
+    last = lookahead[0];
+    lookahead[0] = lookahead[1];
+    buffered--;
+    consumed++;
 }
 
 bool Parser::check(TokenType type) const {
-    if (isAtEnd())
-        return type == TokenType::EndOfFile;
-    return tokens[current].getTokenType() == type;
+    return peek().getTokenType() == type;
 }
 
 bool Parser::match(std::initializer_list<TokenType> types) {
@@ -86,7 +135,7 @@ bool Parser::match(std::initializer_list<TokenType> types) {
 }
 
 Token Parser::consume(TokenType type, const std::string& message) {
-    std::cout << "DEBUG: Consuming. Current token: '" << peek().getLexeme() << "' (" << (int)peek().getTokenType() << "). Expected type: " << (int)type << std::endl;
+    TRACE(Parser, Verbose, "Consuming. Current token: '" << peek().getLexeme() << "' (" << (int)peek().getTokenType() << "). Expected type: " << (int)type);
     if (check(type)) {
         Token tok = peek();
         advance();
@@ -96,164 +145,172 @@ Token Parser::consume(TokenType type, const std::string& message) {
     throw std::runtime_error("Parse error: " + message + " at line " + std::to_string(peek().getLine()));
 }
 
-std::unique_ptr<Expression> Parser::parseExpression() {
-    std::cout << "DEBUG: Entering parseExpression(), current token: '" << peek().getLexeme() << "'" << std::endl;
-    return parseAssignment();
-}
-
-std::unique_ptr<Expression> Parser::parseAssignment() {
-    std::cout << "DEBUG: Entering parseAssignment(), current token: '" << peek().getLexeme() << "'" << std::endl;
-    std::unique_ptr<Expression> expr = parseLogicalOr();
-
-    if (match({ TokenType::Equal })) {
-        std::cout << "DEBUG: Matched Equal in Assignment, current token: '" << peek().getLexeme() << "'" << std::endl;
-        Token equals = previous();
-        std::unique_ptr<Expression> value = parseAssignment();
-
-        if (auto varExpr = dynamic_cast<VariableExpr*>(expr.get())) {
-            return std::make_unique<BinaryExpr>(
-                std::make_unique<VariableExpr>(varExpr->name),
-                std::move(value),
-                equals.getLexeme()
-            );
+BinaryOp Parser::binaryOpFor(TokenType type) {
+    switch (type) {
+        case TokenType::Greater: return BinaryOp::Greater;
+        case TokenType::GreaterEqual: return BinaryOp::GreaterEqual;
+        case TokenType::Less: return BinaryOp::Less;
+        case TokenType::LessEqual: return BinaryOp::LessEqual;
+        case TokenType::Plus: case TokenType::PlusEqual: return BinaryOp::Add;
+        case TokenType::Minus: case TokenType::MinusEqual: return BinaryOp::Subtract;
+        case TokenType::Star: case TokenType::StarEqual: return BinaryOp::Multiply;
+        case TokenType::Slash: case TokenType::SlashEqual: return BinaryOp::Divide;
+        case TokenType::Modulo: return BinaryOp::Modulo;
+        default: throw std::runtime_error("Internal Parser Error: token is not a binary operator.");
+    }
+}
+
+namespace {
+
+// What a token does when it follows an operand. Binary operators carry their operation; '=',
+// '(' and '[' are handled by the parser itself. Any other token is left at Precedence::None,
+// below every level, so it ends the expression.
+struct InfixRule {
+    Precedence precedence = Precedence::None;
+    BinaryOp op = BinaryOp::Assign;
+};
+
+constexpr size_t TOKEN_TYPES = static_cast<size_t>(TokenType::EndOfFile) + 1;
+
+constexpr std::array<InfixRule, TOKEN_TYPES> makeInfixRules() {
+    std::array<InfixRule, TOKEN_TYPES> rules{};
+    auto set = [&rules](TokenType type, Precedence precedence, BinaryOp op) {
+        rules[static_cast<size_t>(type)] = InfixRule{ precedence, op };
+    };
+    set(TokenType::Equal, Precedence::Assignment, BinaryOp::Assign);
+    set(TokenType::OrOr, Precedence::Or, BinaryOp::Or);
+    set(TokenType::AndAnd, Precedence::And, BinaryOp::And);
+    set(TokenType::EqualEqual, Precedence::Equality, BinaryOp::Equal);
+    set(TokenType::BangEqual, Precedence::Equality, BinaryOp::NotEqual);
+    set(TokenType::Greater, Precedence::Comparison, BinaryOp::Greater);
+    set(TokenType::GreaterEqual, Precedence::Comparison, BinaryOp::GreaterEqual);
+    set(TokenType::Less, Precedence::Comparison, BinaryOp::Less);
+    set(TokenType::LessEqual, Precedence::Comparison, BinaryOp::LessEqual);
+    set(TokenType::Plus, Precedence::Term, BinaryOp::Add);
+    set(TokenType::Minus, Precedence::Term, BinaryOp::Subtract);
+    set(TokenType::Star, Precedence::Factor, BinaryOp::Multiply);
+    set(TokenType::Slash, Precedence::Factor, BinaryOp::Divide);
+    set(TokenType::Modulo, Precedence::Factor, BinaryOp::Modulo);
+    set(TokenType::LParen, Precedence::Call, BinaryOp::Assign);
+    set(TokenType::LeftSquare, Precedence::Call, BinaryOp::Assign);
+    return rules;
+}
+
+constexpr std::array<InfixRule, TOKEN_TYPES> INFIX_RULES = makeInfixRules();
+
+Precedence tighter(Precedence precedence) {
+    return static_cast<Precedence>(static_cast<uint8_t>(precedence) + 1);
+}
+
+} // namespace
+
+Expression* Parser::parseExpression() {
+    TRACE(Parser, Debug, "Entering parseExpression(), current token: '" << peek().getLexeme() << "'");
+    return parsePrecedence(Precedence::Assignment);
+}
+
+// Parses a prefix expression, then keeps extending it with every following operator that binds
+// at least as tightly as minimum. Binary operators take a right operand of the next tighter
+// level, which makes them left-associative; assignment takes one of its own level, which makes
+// it right-associative. Calls and indexing bind tightest, so they only ever extend an operand.
+Expression* Parser::parsePrecedence(Precedence minimum) {
+    Expression* expr = parsePrefix();
+    while (true) {
+        TokenType type = peek().getTokenType();
+        const InfixRule& rule = INFIX_RULES[static_cast<size_t>(type)];
+        if (rule.precedence < minimum) {
+            return expr;
+        }
+        advance();
+        switch (type) {
+            case TokenType::Equal:
+                expr = finishAssignment(expr);
+                break;
+            case TokenType::LParen:
+                expr = finishCall(expr);
+                break;
+            case TokenType::LeftSquare: {
+                Expression* index = parseExpression();
+                consume(TokenType::RightSquare, "Expect ] after index.");
+                expr = make<IndexExpr>(expr, index);
+                break;
+            }
+            default:
+                expr = make<BinaryExpr>(expr, parsePrecedence(tighter(rule.precedence)), rule.op);
+                break;
         }
-
-        throw std::runtime_error("Invalid assignment target at line " + std::to_string(equals.getLine()));
-    }
-    std::cout << "DEBUG: Exiting parseAssignment(), current token: '" << peek().getLexeme() << "'" << std::endl;
-    return expr;
-}
-
-std::unique_ptr<Expression> Parser::parseLogicalOr() {
-    std::cout << "DEBUG: Entering parseLogicalOr(), current token: '" << peek().getLexeme() << "'" << std::endl;
-    std::unique_ptr<Expression> expr = parseLogicalAnd();
-
-    while (match({ TokenType::OrOr })) {
-        std::cout << "DEBUG: Matched OrOr, current token: '" << peek().getLexeme() << "'" << std::endl;
-        Token op = previous();
-        std::unique_ptr<Expression> right = parseLogicalAnd();
-        expr = std::make_unique<BinaryExpr>(std::move(expr), std::move(right), op.getLexeme());
-    }
-    std::cout << "DEBUG: Exiting parseLogicalOr(), current token: '" << peek().getLexeme() << "'" << std::endl;
-    return expr;
-}
-
-std::unique_ptr<Expression> Parser::parseLogicalAnd() {
-    std::cout << "DEBUG: Entering parseLogicalAnd(), current token: '" << peek().getLexeme() << "'" << std::endl;
-    std::unique_ptr<Expression> expr = parseEquality();
-
-    while (match({ TokenType::AndAnd })) {
-        std::cout << "DEBUG: Matched AndAnd, current token: '" << peek().getLexeme() << "'" << std::endl;
-        Token op = previous();
-        std::unique_ptr<Expression> right = parseEquality();
-        expr = std::make_unique<BinaryExpr>(std::move(expr), std::move(right), op.getLexeme());
-    }
-    std::cout << "DEBUG: Exiting parseLogicalAnd(), current token: '" << peek().getLexeme() << "'" << std::endl;
-    return expr;
-}
-
-std::unique_ptr<Expression> Parser::parseEquality() {
-    std::cout << "DEBUG: Entering parseEquality(), current token: '" << peek().getLexeme() << "'" << std::endl;
-    std::unique_ptr<Expression> expr = parseComparison();
-
-    while (match({ TokenType::EqualEqual, TokenType::BangEqual })) {
-        std::cout << "DEBUG: Matched EqualEqual or NotEqual, current token: '" << peek().getLexeme() << "'" << std::endl;
-        Token op = previous();
-        std::unique_ptr<Expression> right = parseComparison();
-        expr = std::make_unique<BinaryExpr>(std::move(expr), std::move(right), op.getLexeme());
-    }
-    std::cout << "DEBUG: Exiting parseEquality(), current token: '" << peek().getLexeme() << "'" << std::endl;
-    return expr;
-}
-
-std::unique_ptr<Expression> Parser::parseComparison() {
-    std::cout << "DEBUG: Entering parseComparison(), current token: '" << peek().getLexeme() << "'" << std::endl;
-    std::unique_ptr<Expression> expr = parseTerm();
-
-    while (match({ TokenType::Greater, TokenType::GreaterEqual, TokenType::Less, TokenType::LessEqual })) {
-        std::cout << "DEBUG: Matched Comparison op, current token: '" << peek().getLexeme() << "'" << std::endl;
-        Token op = previous();
-        std::unique_ptr<Expression> right = parseTerm();
-        expr = std::make_unique<BinaryExpr>(std::move(expr), std::move(right), op.getLexeme());
     }
-    std::cout << "DEBUG: Exiting parseComparison(), current token: '" << peek().getLexeme() << "'" << std::endl;
-    return expr;
 }
 
-std::unique_ptr<Expression> Parser::parseTerm() {
-    std::cout << "DEBUG: Entering parseTerm(), current token: '" << peek().getLexeme() << "'" << std::endl;
-    std::unique_ptr<Expression> expr = parseFactor();
-
-    while (match({ TokenType::Plus, TokenType::Minus })) {
-        std::cout << "DEBUG: Matched Plus or Minus, current token: '" << peek().getLexeme() << "'" << std::endl;
-        Token op = previous();
-        std::unique_ptr<Expression> right = parseFactor();
-        expr = std::make_unique<BinaryExpr>(std::move(expr), std::move(right), op.getLexeme());
+Expression* Parser::parsePrefix() {
+    TRACE(Parser, Debug, "Entering parsePrefix(), current token: '" << peek().getLexeme() << "'");
+    switch (peek().getTokenType()) {
+        case TokenType::False:
+            advance();
+            return make<BooleanExpr>(false);
+        case TokenType::True:
+            advance();
+            return make<BooleanExpr>(true);
+        case TokenType::Number: {
+            advance();
+            double value = std::stod(std::string(previous().getLexeme()));
+            return make<NumberExpr>(value);
+        }
+        case TokenType::String:
+            advance();
+            return make<StringExpr>(std::string(previous().getLexeme()));
+        case TokenType::Identifier:
+            advance();
+            return make<VariableExpr>(intern(previous()));
+        case TokenType::Bang:
+        case TokenType::Minus: {
+            UnaryOp op = peek().getTokenType() == TokenType::Minus ? UnaryOp::Negate : UnaryOp::Not;
+            advance();
+            return make<UnaryExpr>(op, parsePrecedence(Precedence::Unary));
+        }
+        case TokenType::LeftSquare: {
+            advance();
+            std::vector<Expression*> elements;
+            if (!check(TokenType::RightSquare)) {
+                do {
+                    elements.push_back(parseExpression());
+                } while (match({ TokenType::Comma }));
+            }
+            consume(TokenType::RightSquare, "Expect ']' after array elements.");
+            return make<ArrayExpr>(program.arena.copy(elements));
+        }
+        case TokenType::LParen: {
+            advance();
+            auto expr = parseExpression();
+            if (!match({ TokenType::RParen })) {
+                throw std::runtime_error("Expected ')' after expression at line " + std::to_string(previous().getLine()));
+            }
+            return make<GroupingExpr>(expr);
+        }
+        default:
+            throw std::runtime_error("Expected expression at line " + std::to_string(peek().getLine()) + ", found '" + std::string(peek().getLexeme()) + "'");
     }
-    std::cout << "DEBUG: Exiting parseTerm(), current token: '" << peek().getLexeme() << "'" << std::endl;
-    return expr;
 }
 
-std::unique_ptr<Expression> Parser::parseFactor() {
-    std::cout << "DEBUG: Entering parseFactor(), current token: '" << peek().getLexeme() << "'" << std::endl;
+// Called after '='; target is everything to its left.
+Expression* Parser::finishAssignment(Expression* target) {
+    int line = previous().getLine();
+    Expression* value = parsePrecedence(Precedence::Assignment);
 
-    std::unique_ptr<Expression> expr = parseUnary();
-
-    while (match({ TokenType::Star, TokenType::Slash ,TokenType::Modulo})) {
-        std::cout << "DEBUG: Matched Star or Slash, current token: '" << peek().getLexeme() << "'" << std::endl;
-        Token op = previous();
-        
-        std::unique_ptr<Expression> right = parseUnary();
-        expr = std::make_unique<BinaryExpr>(std::move(expr), std::move(right), op.getLexeme());
+    if (dynamic_cast<VariableExpr*>(target)) {
+        return make<BinaryExpr>(target, value, BinaryOp::Assign);
     }
-    std::cout << "DEBUG: Exiting parseFactor(), current token: '" << peek().getLexeme() << "'" << std::endl;
-    return expr;
-}
-
-std::unique_ptr<Expression> Parser::parseUnary() {
-    std::cout << "DEBUG: Entering parseUnary(), current token: '" << peek().getLexeme() << "'" << std::endl;
 
-    if (match({ TokenType::Bang, TokenType::Minus })) {
-        Token op = previous(); 
-
-        auto right = parseUnary(); 
-
-        if (!right) {
-            throw std::runtime_error("Expected expression after unary operator at line " + std::to_string(op.getLine()));
-        }
-
-        return std::make_unique<UnaryExpr>(op, std::move(right));
+    if (auto indexExpr = dynamic_cast<IndexExpr*>(target)) {
+        return make<IndexAssignmentExpr>(indexExpr->array, indexExpr->index, value);
     }
 
-    return parseCall();
+    throw std::runtime_error("Invalid assignment target at line " + std::to_string(line));
 }
 
-std::unique_ptr<Expression> Parser::parseCall() {
-    std::cout << "DEBUG: Entering parseCall(), current token: '" << peek().getLexeme() << "'" << std::endl;
-    std::unique_ptr<Expression> expr = parsePrimary();
-    while (true) {
-        if (match({ TokenType::LParen })) {
-            std::cout << "DEBUG: Matched LParen for Call, current token: '" << peek().getLexeme() << "'" << std::endl;
-            expr = finishCall(std::move(expr));
-        }
-        else if (match({ TokenType::LeftSquare })) 
-        {
-            std::cout << "DEBUG: Matched LeftSquare for index access, current token: '" << peek().getLexeme() << "'" << std::endl;
-            std::unique_ptr<Expression> index = parseExpression();
-            consume(TokenType::RightSquare, "Expect ] after index."); 
-            expr = std::make_unique<IndexExpr>(std::move(expr), std::move(index));
-        }
-        else {
-            break;
-        }
-    }
-    std::cout << "DEBUG: Exiting parseCall(), current token: '" << peek().getLexeme() << "'" << std::endl;
-    return expr;
-}
-
-std::unique_ptr<Expression> Parser::finishCall(std::unique_ptr<Expression> callee) {
-    std::cout << "DEBUG: Entering finishCall(), current token: '" << peek().getLexeme() << "'" << std::endl;
-    std::vector<std::unique_ptr<Expression>> arguments;
+Expression* Parser::finishCall(Expression* callee) {
+    TRACE(Parser, Debug, "Entering finishCall(), current token: '" << peek().getLexeme() << "'");
+    std::vector<Expression*> arguments;
 
     if (!check(TokenType::RParen)) {
         do {
@@ -265,119 +322,70 @@ std::unique_ptr<Expression> Parser::finishCall(std::unique_ptr<Expression> calle
     }
 
     consume(TokenType::RParen, "Expect ')' after arguments.");
-    std::cout << "DEBUG: Exiting finishCall(), current token: '" << peek().getLexeme() << "'" << std::endl;
-    return std::make_unique<CallExpr>(std::move(callee), std::move(arguments));
-}
-
-std::unique_ptr<Expression> Parser::parsePrimary() {
-    std::cout << "DEBUG: Entering parsePrimary(), current token: '" << peek().getLexeme() << "'" << std::endl;
-
-    if (match({ TokenType::False })) {
-        return std::make_unique<BooleanExpr>(false);
-    }
-    if (match({ TokenType::True })) {
-        return std::make_unique<BooleanExpr>(true);
-    }
-
-    if (match({ TokenType::Number })) {
-        double value = std::stod(previous().getLexeme()); 
-        return std::make_unique<NumberExpr>(value);
-    }
-    if (match({ TokenType::LeftSquare })) 
-    {
-        std::vector<std::unique_ptr<Expression>> elements;
-        if (!check(TokenType::RightSquare)) 
-        {
-            do
-            {
-                elements.push_back(parseExpression());
-            } while (match({ TokenType::Comma }));
-        }
-        consume(TokenType::RightSquare, "Expect ']' after array elements."); 
-        return std::make_unique<ArrayExpr>(std::move(elements));
-    }
-    if (match({ TokenType::String })) {
-        return std::make_unique<StringExpr>(previous().getLexeme());
-    }
-
-    if (match({ TokenType::Identifier })) {
-        return std::make_unique<VariableExpr>(previous().getLexeme()); 
-    }
-
-    if (match({ TokenType::LParen })) {
-        auto expr = parseExpression(); 
-        if (!match({ TokenType::RParen })) {
-            
-            throw std::runtime_error("Expected ')' after expression at line " + std::to_string(previous().getLine()));
-        }
-        return std::make_unique<GroupingExpr>(std::move(expr)); 
-    }
-
-    throw std::runtime_error("Expected expression at line " + std::to_string(peek().getLine()) + ", found '" + peek().getLexeme() + "'");
-}
-
-std::unique_ptr<Statement> Parser::parseStatement() {
-    std::cout << "DEBUG: Entering parseStatement(), current token: '" << peek().getLexeme() << "'" << std::endl;
-    if (match({ TokenType::Print })) return parsePrintStatement();
-    if (match({ TokenType::Let })) return parseLetStatement();
-    if (match({ TokenType::If })) return parseIfStatement();
-    if (match({ TokenType::While })) return parseWhileStatement();
-    if (match({ TokenType::Return })) return parseReturnStatement();
-    if (match({ TokenType::Function })) return parseFunctionStatement();
-    if (check(TokenType::LBrace)) return parseBlockStatement();
-    if (check(TokenType::PlusPlus) || check(TokenType::MinusMinus)) {
-        return parseUpdateStatement(true);
-    }
-    if (check(TokenType::Identifier)) {
-        size_t temp_current = current; 
-        advance(); 
-        if (check(TokenType::PlusPlus) || check(TokenType::MinusMinus)) {
-            
-            current = temp_current; 
-            return parseUpdateStatement(false); 
-        }
-        current = temp_current; 
-    }
-    if (check(TokenType::Identifier)) {
-        size_t temp_current = current;
-        advance(); 
-        if (check(TokenType::PlusEqual) || check(TokenType::MinusEqual) ||
-            check(TokenType::StarEqual) || check(TokenType::SlashEqual)) {
-            current = temp_current; 
-            return parseAssignmentUpdateStatement();
-        }
-        current = temp_current; 
+    TRACE(Parser, Debug, "Exiting finishCall(), current token: '" << peek().getLexeme() << "'");
+    return make<CallExpr>(callee, program.arena.copy(arguments));
+}
+
+Statement* Parser::parseStatement() {
+    TRACE(Parser, Debug, "Entering parseStatement(), current token: '" << peek().getLexeme() << "'");
+    switch (peek().getTokenType()) {
+        case TokenType::Print: advance(); return parsePrintStatement();
+        case TokenType::Let: advance(); return parseLetStatement();
+        case TokenType::If: advance(); return parseIfStatement();
+        case TokenType::While: advance(); return parseWhileStatement();
+        case TokenType::Return: advance(); return parseReturnStatement();
+        case TokenType::Function: advance(); return parseFunctionStatement();
+        case TokenType::LBrace: return parseBlockStatement();
+        case TokenType::PlusPlus:
+        case TokenType::MinusMinus:
+            return parseUpdateStatement(true);
+        case TokenType::Identifier:
+            // `x++;` and `x += e;` are told apart from an expression by the token after the name.
+            switch (peekNext().getTokenType()) {
+                case TokenType::PlusPlus:
+                case TokenType::MinusMinus:
+                    return parseUpdateStatement(false);
+                case TokenType::PlusEqual:
+                case TokenType::MinusEqual:
+                case TokenType::StarEqual:
+                case TokenType::SlashEqual:
+                    return parseAssignmentUpdateStatement();
+                default:
+                    break;
+            }
+            break;
+        default:
+            break;
     }
-
-    return parseExpressionStatement(); 
+    return parseExpressionStatement();
 }
 
-std::unique_ptr<Statement> Parser::parsePrintStatement() {
-    std::cout << "DEBUG: Entering parsePrintStatement(), current token: '" << peek().getLexeme() << "'" << std::endl;
+Statement* Parser::parsePrintStatement() {
+    TRACE(Parser, Debug, "Entering parsePrintStatement(), current token: '" << peek().getLexeme() << "'");
     auto value = parseExpression();
     consume(TokenType::Semicolon, "Expect ';' after value.");
-    std::cout << "DEBUG: Exiting parsePrintStatement()" << std::endl;
-    return std::make_unique<PrintStatement>(std::move(value));
+    TRACE(Parser, Debug, "Exiting parsePrintStatement()");
+    return make<PrintStatement>(value);
 }
 
-std::unique_ptr<Statement> Parser::parseLetStatement() {
-    std::cout << "DEBUG: Entering parseLetStatement(), current token: '" << peek().getLexeme() << "'" << std::endl;
+Statement* Parser::parseLetStatement() {
+    TRACE(Parser, Debug, "Entering parseLetStatement(), current token: '" << peek().getLexeme() << "'");
     Token nameToken = consume(TokenType::Identifier, "Expect variable name after 'let'.");
     consume(TokenType::Equal, "Expect '=' after variable name.");
 
     auto initializer = parseExpression();
 
     consume(TokenType::Semicolon, "Expect ';' after variable declaration.");
-    std::cout << "DEBUG: Exiting parseLetStatement()" << std::endl;
-    return std::make_unique<LetStatement>(nameToken.getLexeme(), std::move(initializer));
+    TRACE(Parser, Debug, "Exiting parseLetStatement()");
+    return make<LetStatement>(intern(nameToken), initializer);
 }
 
 
-std::unique_ptr<Statement> Parser::parseUpdateStatement(bool isPrefix) {
-    std::cout << "DEBUG: Entering parseUpdateStatement(isPrefix=" << (isPrefix ? "true" : "false") << "), current token: '" << peek().getLexeme() << "'" << std::endl;
+Statement* Parser::parseUpdateStatement(bool isPrefix) {
+    TRACE(Parser, Debug, "Entering parseUpdateStatement(isPrefix=" << (isPrefix ? "true" : "false") << "), current token: '" << peek().getLexeme() << "'");
 
-    Token nameToken = tokens[current];
-    Token op = tokens[current];
+    Token nameToken = peek();
+    Token op = peek();
 
     if (isPrefix) {
         op = consume(
@@ -396,15 +404,16 @@ std::unique_ptr<Statement> Parser::parseUpdateStatement(bool isPrefix) {
 
     consume(TokenType::Semicolon, "Expect ';' after update statement.");
 
-    std::cout << "DEBUG: Parsed " << (isPrefix ? "prefix" : "postfix") << " update: " << (isPrefix ? op.getLexeme() : "") << nameToken.getLexeme() << (isPrefix ? "" : op.getLexeme()) << std::endl;
-    return std::make_unique<UpdateStatement>(std::move(nameToken), std::move(op), isPrefix);
+    TRACE(Parser, Debug, "Parsed " << (isPrefix ? "prefix" : "postfix") << " update: " << (isPrefix ? op.getLexeme() : "") << nameToken.getLexeme() << (isPrefix ? "" : op.getLexeme()));
+    return make<UpdateStatement>(intern(nameToken),
+        op.getTokenType() == TokenType::PlusPlus ? UpdateOp::Increment : UpdateOp::Decrement, isPrefix);
 }
-std::unique_ptr<Statement> Parser::parseAssignmentUpdateStatement() {
-    std::cout << "DEBUG: Entering parseAssignmentUpdateStatement(), current token: '" << peek().getLexeme() << "'" << std::endl;
+Statement* Parser::parseAssignmentUpdateStatement() {
+    TRACE(Parser, Debug, "Entering parseAssignmentUpdateStatement(), current token: '" << peek().getLexeme() << "'");
 
     Token variableNameToken = consume(TokenType::Identifier, "Expected variable name before assignment update operator.");
     
-    Token opToken = tokens[current];
+    Token opToken = peek();
     if (match({ TokenType::PlusEqual })) {
         opToken = previous(); 
     } else if (match({ TokenType::MinusEqual })) {
@@ -414,68 +423,60 @@ std::unique_ptr<Statement> Parser::parseAssignmentUpdateStatement() {
     } else if (match({ TokenType::SlashEqual })) {
         opToken = previous();
     } else {
-        throw std::runtime_error("Expected assignment update operator like '+=', '-=', '*=' or '/=' at line " + std::to_string(peek().getLine()) + ", found '" + peek().getLexeme() + "'");
+        throw std::runtime_error("Expected assignment update operator like '+=', '-=', '*=' or '/=' at line " + std::to_string(peek().getLine()) + ", found '" + std::string(peek().getLexeme()) + "'");
     }
 
     auto expr = parseExpression(); 
 
     consume(TokenType::Semicolon, "Expect ';' after assignment update statement.");
 
-    std::cout << "DEBUG: Parsed assignment update: " << variableNameToken.getLexeme() << opToken.getLexeme() << " <expr>" << std::endl;
-    return std::make_unique<AssignmentUpdateStatement>(
-        std::move(variableNameToken),
-        std::move(opToken),
-        std::move(expr)
-    );
+    TRACE(Parser, Debug, "Parsed assignment update: " << variableNameToken.getLexeme() << opToken.getLexeme() << " <expr>");
+    return make<AssignmentUpdateStatement>(intern(variableNameToken), binaryOpFor(opToken.getTokenType()), expr);
 }
 
 
-std::unique_ptr<Statement> Parser::parseIfStatement() {
-    std::cout << "DEBUG: Entering parseIfStatement(), current token: '" << peek().getLexeme() << "'" << std::endl;
+Statement* Parser::parseIfStatement() {
+    TRACE(Parser, Debug, "Entering parseIfStatement(), current token: '" << peek().getLexeme() << "'");
     consume(TokenType::LParen, "Expect '(' after 'if'.");
     auto condition = parseExpression();
     consume(TokenType::RParen, "Expect ')' after condition.");
 
-    std::unique_ptr<Statement> thenBranch = parseBlockStatement();
-    std::unique_ptr<Statement> elseBranch = nullptr;
+    Statement* thenBranch = parseBlockStatement();
+    Statement* elseBranch = nullptr;
     if (match({ TokenType::Else })) {
         elseBranch = parseBlockStatement();
     }
-    std::cout << "DEBUG: Exiting parseIfStatement()" << std::endl;
-    return std::make_unique<IfStatement>(
-        std::move(condition),
-        std::move(thenBranch),
-        std::move(elseBranch)
-    );
+    TRACE(Parser, Debug, "Exiting parseIfStatement()");
+    return make<IfStatement>(condition, thenBranch, elseBranch);
 }
 
-std::unique_ptr<Statement> Parser::parseWhileStatement() {
-    std::cout << "DEBUG: Entering parseWhileStatement(), current token: '" << peek().getLexeme() << "'" << std::endl;
+Statement* Parser::parseWhileStatement() {
+    TRACE(Parser, Debug, "Entering parseWhileStatement(), current token: '" << peek().getLexeme() << "'");
     consume(TokenType::LParen, "Expect '(' after 'while'.");
     auto condition = parseExpression();
     consume(TokenType::RParen, "Expect ')' after condition.");
 
-    std::unique_ptr<Statement> body = parseBlockStatement(); 
-    std::cout << "DEBUG: Exiting parseWhileStatement()" << std::endl;
-    return std::make_unique<WhileStatement>(std::move(condition), std::move(body));
+    Statement* body = parseBlockStatement(); 
+    TRACE(Parser, Debug, "Exiting parseWhileStatement()");
+    return make<WhileStatement>(condition, body);
 }
 
-std::unique_ptr<Statement> Parser::parseReturnStatement() {
-    std::cout << "DEBUG: Entering parseReturnStatement(), current token: '" << peek().getLexeme() << "'" << std::endl;
+Statement* Parser::parseReturnStatement() {
+    TRACE(Parser, Debug, "Entering parseReturnStatement(), current token: '" << peek().getLexeme() << "'");
     auto returnExpression = parseExpression();
     consume(TokenType::Semicolon, "Expect ';' after return value.");
-    std::cout << "DEBUG: Exiting parseReturnStatement()" << std::endl;
-    return std::make_unique<ReturnStatement>(std::move(returnExpression));
+    TRACE(Parser, Debug, "Exiting parseReturnStatement()");
+    return make<ReturnStatement>(returnExpression);
 }
 
-std::unique_ptr<FunctionStatement> Parser::parseFunctionStatement() { 
-    std::cout << "DEBUG: Entering parseFunctionStatement(), current token: '" << peek().getLexeme() << "'" << std::endl;
+FunctionStatement* Parser::parseFunctionStatement() { 
+    TRACE(Parser, Debug, "Entering parseFunctionStatement(), current token: '" << peek().getLexeme() << "'");
     Token nameToken = consume(TokenType::Identifier, "Expect function name.");
-    std::string functionName = nameToken.getLexeme();
+    Symbol functionName = intern(nameToken);
 
     consume(TokenType::LParen, "Expect '(' after function name.");
 
-    std::vector<std::string> parameters;
+    std::vector<Symbol> parameters;
 
     if (!check(TokenType::RParen)) {
         do {
@@ -483,38 +484,77 @@ std::unique_ptr<FunctionStatement> Parser::parseFunctionStatement() {
                 throw std::runtime_error("Cannot have more than 255 parameters at line " + std::to_string(peek().getLine()));
             }
             Token param = consume(TokenType::Identifier, "Expect parameter name.");
-            parameters.push_back(param.getLexeme());
+            parameters.push_back(intern(param));
         } while (match({ TokenType::Comma }));
     }
 
     consume(TokenType::RParen, "Expect ')' after parameters.");
 
-    std::unique_ptr<BlockStatement> body = parseBlockStatement(); 
+    if (deferBodies && blockDepth == 0) {
+        DeferredBody* deferred = skipFunctionBody();
+        auto function = make<FunctionStatement>(functionName, program.arena.copy(parameters), nullptr);
+        function->deferred = deferred;
+        TRACE(Parser, Debug, "Deferred the body of " << functionName);
+        return function;
+    }
+
+    BlockStatement* body = parseBlockStatement(); 
 
-    std::cout << "DEBUG: Exiting parseFunctionStatement()" << std::endl;
-    return std::make_unique<FunctionStatement>(std::move(functionName), std::move(parameters), std::move(body));
+    TRACE(Parser, Debug, "Exiting parseFunctionStatement()");
+    return make<FunctionStatement>(functionName, program.arena.copy(parameters), body);
+}
+
+// Steps over a function body, only matching braces, and records where its source lies.
+DeferredBody* Parser::skipFunctionBody() {
+    Token open = consume(TokenType::LBrace, "Expect '{' at beginning of block.");
+    int depth = 1;
+    while (depth > 0) {
+        if (isAtEnd()) {
+            throw std::runtime_error("Parse error: Expect '}' at end of block. at line " + std::to_string(peek().getLine()));
+        }
+        if (check(TokenType::LBrace)) {
+            depth++;
+        } else if (check(TokenType::RBrace)) {
+            depth--;
+        }
+        advance();
+    }
+    const Token& close = previous();
+    const char* begin = open.getLexeme().data();
+    const char* end = close.getLexeme().data() + close.getLexeme().size();
+    DeferredBody* deferred = make<DeferredBody>(
+        DeferredBody{ std::string_view(begin, static_cast<size_t>(end - begin)), open.getLine(), false, &program });
+    program.deferred.push_back(deferred);
+    return deferred;
 }
 
-std::unique_ptr<BlockStatement> Parser::parseBlockStatement() { 
-    std::cout << "DEBUG: Entering parseBlockStatement(), current token: '" << peek().getLexeme() << "'" << std::endl;
+BlockStatement* Parser::parseBlockStatement() { 
+    TRACE(Parser, Debug, "Entering parseBlockStatement(), current token: '" << peek().getLexeme() << "'");
+    int line = peek().getLine();
     consume(TokenType::LBrace, "Expect '{' at beginning of block.");
+    blockDepth++;
 
-    std::vector<std::unique_ptr<Statement>> statements;
+    std::vector<Statement*> statements;
 
     while (!check(TokenType::RBrace) && !isAtEnd()) {
+        int statementLine = peek().getLine();
         statements.push_back(parseStatement());
+        statements.back()->line = statementLine;
     }
 
     consume(TokenType::RBrace, "Expect '}' at end of block.");
-    std::cout << "DEBUG: Exiting parseBlockStatement()" << std::endl;
-    return std::make_unique<BlockStatement>(std::move(statements));
+    blockDepth--;
+    TRACE(Parser, Debug, "Exiting parseBlockStatement()");
+    auto block = make<BlockStatement>(program.arena.copy(statements));
+    block->line = line;
+    return block;
 }
 
-std::unique_ptr<Statement> Parser::parseExpressionStatement() {
-    std::cout << "DEBUG: Entering parseExpressionStatement(), current token: '" << peek().getLexeme() << "'" << std::endl;
+Statement* Parser::parseExpressionStatement() {
+    TRACE(Parser, Debug, "Entering parseExpressionStatement(), current token: '" << peek().getLexeme() << "'");
     
     auto expr = parseExpression();
     consume(TokenType::Semicolon, "Expect ';' after expression.");
-    std::cout << "DEBUG: Exiting parseExpressionStatement()" << std::endl;
-    return std::make_unique<ExpressionStatement>(std::move(expr));
+    TRACE(Parser, Debug, "Exiting parseExpressionStatement()");
+    return make<ExpressionStatement>(expr);
 }
\ No newline at end of file
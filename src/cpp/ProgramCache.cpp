@@ -0,0 +1,612 @@
+#include "../hpp/ProgramCache.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+#include "../hpp/Visitor.hpp"
+#include "../hpp/Trace.hpp"
+
+namespace {
+
+constexpr char MAGIC[8] = { 'M', 'Y', 'L', 'A', 'N', 'G', 'C', '\0' };
+constexpr uint32_t OPTIMIZED = 1;
+constexpr uint32_t DEFERRED_BODIES = 2;
+
+uint32_t flagsFor(ProgramCache::Settings settings) {
+    return (settings.optimized ? OPTIMIZED : 0) | (settings.deferredBodies ? DEFERRED_BODIES : 0);
+}
+
+// Numbers are stored in the machine's own byte order; a cache moved to a machine with another
+// one fails the version check.
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t sourceSize;
+    uint64_t sourceHash;
+    uint64_t payloadSize;
+    uint64_t payloadHash;
+};
+
+// The payload is the symbol table (a count, then each name) followed by the statements. Every
+// node is its tag and then its fields in declaration order; a missing optional child is None.
+// A function's body is preceded by a flag; when set, the body was deferred and is stored as its
+// offset, length and line in the source, and whether to optimize it.
+enum class Tag : uint8_t {
+    None,
+    Number,
+    String,
+    Boolean,
+    Variable,
+    Array,
+    Index,
+    IndexAssignment,
+    Binary,
+    Unary,
+    Call,
+    Update,
+    Grouping,
+    Let,
+    Print,
+    Expression,
+    UpdateStatement,
+    AssignmentUpdate,
+    Block,
+    If,
+    While,
+    Function,
+    Return
+};
+
+// FNV-1a over 8-byte words, so checking a large source costs little next to reading it.
+uint64_t hashBytes(const char* data, size_t size) {
+    uint64_t hash = 14695981039346656037ull ^ size;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * 1099511628211ull;
+    }
+    for (; i < size; ++i) {
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * 1099511628211ull;
+    }
+    return hash ^ (hash >> 29);
+}
+
+class ProgramWriter : public Visitor {
+public:
+    explicit ProgramWriter(const std::string& source) : source(source) {}
+
+    std::string encode(const Program& program) {
+        statements(program.statements);
+        std::string payload;
+        std::swap(payload, out);
+        count(names.size());
+        for (const std::string* name : names) {
+            text(*name);
+        }
+        return out + payload;
+    }
+
+    Value visit(const NumberExpr& expr) override {
+        tag(Tag::Number);
+        scalar(expr.value);
+        return Value();
+    }
+    Value visit(const StringExpr& expr) override {
+        tag(Tag::String);
+        text(expr.constant.asString());
+        return Value();
+    }
+    Value visit(const BooleanExpr& expr) override {
+        tag(Tag::Boolean);
+        scalar<uint8_t>(expr.value);
+        return Value();
+    }
+    Value visit(const VariableExpr& expr) override {
+        tag(Tag::Variable);
+        symbol(expr.name);
+        return Value();
+    }
+    Value visit(const ArrayExpr& expr) override {
+        tag(Tag::Array);
+        expressions(expr.elements);
+        scalar<uint8_t>(expr.constant.isArray());
+        return Value();
+    }
+    Value visit(const IndexExpr& expr) override {
+        tag(Tag::Index);
+        expression(expr.array);
+        expression(expr.index);
+        return Value();
+    }
+    Value visit(const IndexAssignmentExpr& expr) override {
+        tag(Tag::IndexAssignment);
+        expression(expr.array);
+        expression(expr.index);
+        expression(expr.value);
+        return Value();
+    }
+    Value visit(const BinaryExpr& expr) override {
+        tag(Tag::Binary);
+        scalar(expr.op);
+        expression(expr.left);
+        expression(expr.right);
+        return Value();
+    }
+    Value visit(const UnaryExpr& expr) override {
+        tag(Tag::Unary);
+        scalar(expr.op);
+        expression(expr.right);
+        return Value();
+    }
+    Value visit(const CallExpr& expr) override {
+        tag(Tag::Call);
+        expression(expr.callee);
+        expressions(expr.arguments);
+        return Value();
+    }
+    Value visit(const UpdateExpr& expr) override {
+        tag(Tag::Update);
+        symbol(expr.name);
+        scalar(expr.op);
+        expression(expr.right);
+        return Value();
+    }
+    Value visit(const GroupingExpr& expr) override {
+        tag(Tag::Grouping);
+        expression(expr.expression);
+        return Value();
+    }
+
+    Value visit(const LetStatement& stmt) override {
+        header(Tag::Let, stmt);
+        symbol(stmt.name);
+        expression(stmt.initializer);
+        return Value();
+    }
+    Value visit(const PrintStatement& stmt) override {
+        header(Tag::Print, stmt);
+        expression(stmt.expression);
+        return Value();
+    }
+    Value visit(const ExpressionStatement& stmt) override {
+        header(Tag::Expression, stmt);
+        expression(stmt.expression);
+        return Value();
+    }
+    Value visit(const UpdateStatement& stmt) override {
+        header(Tag::UpdateStatement, stmt);
+        symbol(stmt.name);
+        scalar(stmt.op);
+        scalar<uint8_t>(stmt.isPrefix);
+        return Value();
+    }
+    Value visit(const AssignmentUpdateStatement& stmt) override {
+        header(Tag::AssignmentUpdate, stmt);
+        symbol(stmt.name);
+        scalar(stmt.op);
+        expression(stmt.value);
+        return Value();
+    }
+    Value visit(const BlockStatement& stmt) override {
+        header(Tag::Block, stmt);
+        statements(stmt.statements);
+        return Value();
+    }
+    Value visit(const IfStatement& stmt) override {
+        header(Tag::If, stmt);
+        expression(stmt.condition);
+        statement(stmt.thenBranch);
+        statement(stmt.elseBranch);
+        return Value();
+    }
+    Value visit(const WhileStatement& stmt) override {
+        header(Tag::While, stmt);
+        expression(stmt.condition);
+        statement(stmt.thenBranch);
+        return Value();
+    }
+    Value visit(const FunctionStatement& stmt) override {
+        header(Tag::Function, stmt);
+        symbol(stmt.name);
+        count(stmt.parameters.size());
+        for (Symbol parameter : stmt.parameters) {
+            symbol(parameter);
+        }
+        const DeferredBody* deferred = stmt.deferred;
+        if (deferred && deferred->text.data() >= source.data() &&
+            deferred->text.data() + deferred->text.size() <= source.data() + source.size()) {
+            scalar<uint8_t>(1);
+            scalar<uint64_t>(static_cast<uint64_t>(deferred->text.data() - source.data()));
+            scalar<uint64_t>(deferred->text.size());
+            scalar<int32_t>(deferred->line);
+            scalar<uint8_t>(deferred->optimize);
+        } else {
+            scalar<uint8_t>(0);
+            statement(stmt.getBody());
+        }
+        return Value();
+    }
+    Value visit(const ReturnStatement& stmt) override {
+        header(Tag::Return, stmt);
+        expression(stmt.expression);
+        return Value();
+    }
+
+private:
+    const std::string& source;
+    std::string out;
+    std::vector<const std::string*> names;
+    std::unordered_map<const std::string*, uint32_t> symbolIds;
+
+    template <typename T>
+    void scalar(T value) {
+        char bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        out.append(bytes, sizeof(T));
+    }
+    void tag(Tag tag) { scalar(tag); }
+    void count(size_t n) { scalar(static_cast<uint32_t>(n)); }
+    void text(const std::string& value) {
+        count(value.size());
+        out += value;
+    }
+    void symbol(Symbol name) {
+        auto inserted = symbolIds.emplace(&name.str(), static_cast<uint32_t>(names.size()));
+        if (inserted.second) {
+            names.push_back(&name.str());
+        }
+        count(inserted.first->second);
+    }
+    void header(Tag kind, const Statement& stmt) {
+        tag(kind);
+        scalar<int32_t>(stmt.line);
+    }
+    void expression(const Expression* expr) {
+        if (expr) {
+            expr->accept(*this);
+        } else {
+            tag(Tag::None);
+        }
+    }
+    void expressions(const NodeList<Expression*>& list) {
+        count(list.size());
+        for (const Expression* expr : list) {
+            expression(expr);
+        }
+    }
+    void statement(const Statement* stmt) {
+        if (stmt) {
+            stmt->accept(*this);
+        } else {
+            tag(Tag::None);
+        }
+    }
+    void statements(const StatementList& list) {
+        count(list.size());
+        for (const Statement* stmt : list) {
+            statement(stmt);
+        }
+    }
+};
+
+// Rebuilds a tree written by ProgramWriter. Every read is bounds-checked and every tag, operator
+// and symbol id validated, so a damaged payload fails to decode instead of building a bad tree.
+class ProgramReader {
+public:
+    ProgramReader(const char* data, size_t size, const std::string& source, Program& program)
+        : cursor(data), end(data + size), source(source), program(program) {}
+
+    void read() {
+        uint32_t symbolCount = count();
+        for (uint32_t i = 0; i < symbolCount; ++i) {
+            symbols.push_back(program.symbols.intern(text()));
+        }
+        program.statements = statements();
+        if (cursor != end) fail();
+    }
+
+private:
+    const char* cursor;
+    const char* end;
+    const std::string& source;
+    Program& program;
+    std::vector<Symbol> symbols;
+
+    [[noreturn]] static void fail() { throw std::runtime_error("Program cache is corrupt."); }
+
+    template <typename T>
+    T scalar() {
+        if (static_cast<size_t>(end - cursor) < sizeof(T)) fail();
+        T value;
+        std::memcpy(&value, cursor, sizeof(T));
+        cursor += sizeof(T);
+        return value;
+    }
+    // Every counted item takes at least one byte, which bounds what a bad count can allocate.
+    uint32_t count() {
+        uint32_t n = scalar<uint32_t>();
+        if (n > static_cast<size_t>(end - cursor)) fail();
+        return n;
+    }
+    std::string text() {
+        uint32_t length = count();
+        std::string value(cursor, length);
+        cursor += length;
+        return value;
+    }
+    Symbol symbol() {
+        uint32_t id = scalar<uint32_t>();
+        if (id >= symbols.size()) fail();
+        return symbols[id];
+    }
+    template <typename Op>
+    Op op(Op last) {
+        uint8_t value = scalar<uint8_t>();
+        if (value > static_cast<uint8_t>(last)) fail();
+        return static_cast<Op>(value);
+    }
+    bool flag() {
+        uint8_t value = scalar<uint8_t>();
+        if (value > 1) fail();
+        return value == 1;
+    }
+
+    Expression* required(Expression* expr) {
+        if (!expr) fail();
+        return expr;
+    }
+    Statement* required(Statement* stmt) {
+        if (!stmt) fail();
+        return stmt;
+    }
+
+    NodeList<Expression*> expressions() {
+        std::vector<Expression*> list(count());
+        for (Expression*& expr : list) {
+            expr = required(expression());
+        }
+        return program.arena.copy(list);
+    }
+
+    StatementList statements() {
+        std::vector<Statement*> list(count());
+        for (Statement*& stmt : list) {
+            stmt = required(statement());
+        }
+        return program.arena.copy(list);
+    }
+
+    // The Optimizer only folds arrays of scalar literals, which are rebuilt from the elements.
+    static Value constantArray(const NodeList<Expression*>& elements) {
+        std::vector<Value> values;
+        values.reserve(elements.size());
+        for (const Expression* element : elements) {
+            if (auto number = dynamic_cast<const NumberExpr*>(element)) {
+                values.push_back(Value(number->value));
+            } else if (auto string = dynamic_cast<const StringExpr*>(element)) {
+                values.push_back(string->constant);
+            } else if (auto boolean = dynamic_cast<const BooleanExpr*>(element)) {
+                values.push_back(Value(boolean->value));
+            } else {
+                fail();
+            }
+        }
+        return Value(std::move(values));
+    }
+
+    Expression* expression() {
+        AstArena& arena = program.arena;
+        switch (scalar<Tag>()) {
+            case Tag::None:
+                return nullptr;
+            case Tag::Number:
+                return arena.make<NumberExpr>(scalar<double>());
+            case Tag::String:
+                return arena.make<StringExpr>(text());
+            case Tag::Boolean:
+                return arena.make<BooleanExpr>(flag());
+            case Tag::Variable:
+                return arena.make<VariableExpr>(symbol());
+            case Tag::Array: {
+                auto* array = arena.make<ArrayExpr>(expressions());
+                if (flag()) {
+                    array->constant = constantArray(array->elements);
+                }
+                return array;
+            }
+            case Tag::Index: {
+                Expression* array = required(expression());
+                return arena.make<IndexExpr>(array, required(expression()));
+            }
+            case Tag::IndexAssignment: {
+                Expression* array = required(expression());
+                Expression* index = required(expression());
+                return arena.make<IndexAssignmentExpr>(array, index, required(expression()));
+            }
+            case Tag::Binary: {
+                BinaryOp binary = op(BinaryOp::Modulo);
+                Expression* left = required(expression());
+                return arena.make<BinaryExpr>(left, required(expression()), binary);
+            }
+            case Tag::Unary: {
+                UnaryOp unary = op(UnaryOp::Not);
+                return arena.make<UnaryExpr>(unary, required(expression()));
+            }
+            case Tag::Call: {
+                Expression* callee = required(expression());
+                return arena.make<CallExpr>(callee, expressions());
+            }
+            case Tag::Update: {
+                Symbol name = symbol();
+                UpdateOp update = op(UpdateOp::Decrement);
+                return arena.make<UpdateExpr>(name, update, expression());
+            }
+            case Tag::Grouping:
+                return arena.make<GroupingExpr>(required(expression()));
+            default:
+                fail();
+        }
+    }
+
+    Statement* statement() {
+        Tag kind = scalar<Tag>();
+        if (kind == Tag::None) {
+            return nullptr;
+        }
+        int32_t line = scalar<int32_t>();
+        Statement* stmt = nullptr;
+        AstArena& arena = program.arena;
+        switch (kind) {
+            case Tag::Let: {
+                Symbol name = symbol();
+                stmt = arena.make<LetStatement>(name, expression());
+                break;
+            }
+            case Tag::Print:
+                stmt = arena.make<PrintStatement>(required(expression()));
+                break;
+            case Tag::Expression:
+                stmt = arena.make<ExpressionStatement>(required(expression()));
+                break;
+            case Tag::UpdateStatement: {
+                Symbol name = symbol();
+                UpdateOp update = op(UpdateOp::Decrement);
+                stmt = arena.make<UpdateStatement>(name, update, flag());
+                break;
+            }
+            case Tag::AssignmentUpdate: {
+                Symbol name = symbol();
+                BinaryOp binary = op(BinaryOp::Modulo);
+                stmt = arena.make<AssignmentUpdateStatement>(name, binary, expression());
+                break;
+            }
+            case Tag::Block:
+                stmt = arena.make<BlockStatement>(statements());
+                break;
+            case Tag::If: {
+                Expression* condition = required(expression());
+                Statement* thenBranch = required(statement());
+                stmt = arena.make<IfStatement>(condition, thenBranch, statement());
+                break;
+            }
+            case Tag::While: {
+                Expression* condition = required(expression());
+                stmt = arena.make<WhileStatement>(condition, required(statement()));
+                break;
+            }
+            case Tag::Function: {
+                Symbol name = symbol();
+                std::vector<Symbol> parameters(count());
+                for (Symbol& parameter : parameters) {
+                    parameter = symbol();
+                }
+                if (flag()) {
+                    uint64_t offset = scalar<uint64_t>();
+                    uint64_t length = scalar<uint64_t>();
+                    int32_t bodyLine = scalar<int32_t>();
+                    bool optimize = flag();
+                    if (offset > source.size() || length > source.size() - offset) fail();
+                    auto* deferred = arena.make<DeferredBody>(DeferredBody{
+                        std::string_view(source.data() + offset, static_cast<size_t>(length)), bodyLine, optimize,
+                        &program });
+                    program.deferred.push_back(deferred);
+                    auto* function = arena.make<FunctionStatement>(name, arena.copy(parameters), nullptr);
+                    function->deferred = deferred;
+                    stmt = function;
+                    break;
+                }
+                Statement* body = statement();
+                auto* block = dynamic_cast<BlockStatement*>(body);
+                if (body && !block) fail();
+                stmt = arena.make<FunctionStatement>(name, arena.copy(parameters), block);
+                break;
+            }
+            case Tag::Return:
+                stmt = arena.make<ReturnStatement>(expression());
+                break;
+            default:
+                fail();
+        }
+        stmt->line = line;
+        return stmt;
+    }
+};
+
+} // namespace
+
+ProgramCache::ProgramCache(const std::string& sourcePath) : cachePath(sourcePath + ".cache") {}
+
+bool ProgramCache::load(const std::string& source, Settings settings, Program& program) const {
+    std::ifstream file(cachePath, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::string image;
+    file.seekg(0, std::ios::end);
+    image.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0, std::ios::beg);
+    file.read(&image[0], static_cast<std::streamsize>(image.size()));
+    if (!file || image.size() < sizeof(Header)) {
+        TRACE(Parser, Info, "Ignoring truncated cache " << cachePath);
+        return false;
+    }
+
+    Header header;
+    std::memcpy(&header, image.data(), sizeof(Header));
+    const char* payload = image.data() + sizeof(Header);
+    size_t payloadSize = image.size() - sizeof(Header);
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != FORMAT_VERSION ||
+        header.flags != flagsFor(settings) || header.sourceSize != source.size() ||
+        header.sourceHash != hashBytes(source.data(), source.size())) {
+        TRACE(Parser, Info, "Cache " << cachePath << " is stale");
+        return false;
+    }
+    if (header.payloadSize != payloadSize || header.payloadHash != hashBytes(payload, payloadSize)) {
+        TRACE(Parser, Info, "Cache " << cachePath << " is corrupt");
+        return false;
+    }
+
+    Program loaded;
+    try {
+        ProgramReader(payload, payloadSize, source, loaded).read();
+    } catch (const std::runtime_error& error) {
+        TRACE(Parser, Info, "Cache " << cachePath << ": " << error.what());
+        return false;
+    }
+    program = std::move(loaded);
+    TRACE(Parser, Info, "Loaded " << program.statements.size() << " statements from " << cachePath);
+    return true;
+}
+
+void ProgramCache::store(const std::string& source, Settings settings, const Program& program) const {
+    std::string payload = ProgramWriter(source).encode(program);
+    Header header;
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = FORMAT_VERSION;
+    header.flags = flagsFor(settings);
+    header.sourceSize = source.size();
+    header.sourceHash = hashBytes(source.data(), source.size());
+    header.payloadSize = payload.size();
+    header.payloadHash = hashBytes(payload.data(), payload.size());
+
+    // Written aside and renamed into place, so a reader never sees a half-written cache.
+    std::string temporary = cachePath + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        out.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+        if (!out) {
+            out.close();
+            std::remove(temporary.c_str());
+            TRACE(Parser, Info, "Could not write cache " << cachePath);
+            return;
+        }
+    }
+    if (std::rename(temporary.c_str(), cachePath.c_str()) != 0) {
+        std::remove(temporary.c_str());
+    }
+}
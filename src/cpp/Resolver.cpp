@@ -0,0 +1,221 @@
+#include "../hpp/Resolver.hpp"
+#include <stdexcept>
+
+void Resolver::resolve(const StatementList& statements) {
+    for (const auto& statement : statements) {
+        resolve(*statement);
+    }
+}
+
+void Resolver::resolve(const Statement& stmt) {
+    stmt.accept(*this);
+}
+
+void Resolver::resolve(const Expression& expr) {
+    expr.accept(*this);
+}
+
+void Resolver::beginScope() {
+    scopes.push_back(std::make_shared<Scope>());
+}
+
+int Resolver::endScope() {
+    int slotCount = static_cast<int>(scopes.back()->size());
+    scopes.pop_back();
+    if (scopes.empty() && !pending.empty()) {
+        resolvePending();
+    }
+    return slotCount;
+}
+
+// Runs once the outermost local scope has closed, so every scope a pending body refers to
+// holds all of its names. Bodies nested in these are queued again and handled in turn.
+void Resolver::resolvePending() {
+    for (size_t i = 0; i < pending.size(); ++i) {
+        PendingBody next = pending[i];
+        scopes = std::move(next.scopes);
+        resolveBody(*next.function, *next.body);
+    }
+    pending.clear();
+    scopes.clear();
+}
+
+int Resolver::declare(const std::string& name) {
+    if (scopes.empty()) {
+        return -1;
+    }
+    Scope& scope = *scopes.back();
+    if (scope.count(name)) {
+        return REDECLARED_SLOT;
+    }
+    int slot = static_cast<int>(scope.size());
+    scope.emplace(name, slot);
+    return slot;
+}
+
+VariableSlot Resolver::resolveLocal(const std::string& name) const {
+    for (int i = static_cast<int>(scopes.size()) - 1; i >= 0; --i) {
+        auto it = scopes[i]->find(name);
+        if (it != scopes[i]->end()) {
+            return VariableSlot{ static_cast<int>(scopes.size()) - 1 - i, it->second };
+        }
+    }
+    return VariableSlot{};
+}
+
+Value Resolver::visit(const NumberExpr& expr) {
+    return Value();
+}
+
+Value Resolver::visit(const StringExpr& expr) {
+    return Value();
+}
+
+Value Resolver::visit(const BooleanExpr& expr) {
+    return Value();
+}
+
+Value Resolver::visit(const VariableExpr& expr) {
+    expr.resolved = resolveLocal(expr.name.str());
+    return Value();
+}
+
+Value Resolver::visit(const ArrayExpr& expr) {
+    for (const auto& element : expr.elements) {
+        resolve(*element);
+    }
+    return Value();
+}
+
+Value Resolver::visit(const IndexExpr& expr) {
+    resolve(*expr.array);
+    resolve(*expr.index);
+    return Value();
+}
+
+Value Resolver::visit(const IndexAssignmentExpr& expr) {
+    resolve(*expr.array);
+    resolve(*expr.index);
+    resolve(*expr.value);
+    return Value();
+}
+
+Value Resolver::visit(const BinaryExpr& expr) {
+    resolve(*expr.left);
+    resolve(*expr.right);
+    return Value();
+}
+
+Value Resolver::visit(const UnaryExpr& expr) {
+    resolve(*expr.right);
+    return Value();
+}
+
+Value Resolver::visit(const CallExpr& expr) {
+    resolve(*expr.callee);
+    for (const auto& argument : expr.arguments) {
+        resolve(*argument);
+    }
+    return Value();
+}
+
+Value Resolver::visit(const UpdateExpr& expr) {
+    if (expr.right) {
+        resolve(*expr.right);
+    }
+    expr.resolved = resolveLocal(expr.name.str());
+    return Value();
+}
+
+Value Resolver::visit(const GroupingExpr& expr) {
+    resolve(*expr.expression);
+    return Value();
+}
+
+Value Resolver::visit(const LetStatement& stmt) {
+    // The initializer sees any outer variable of the same name, as at runtime.
+    if (stmt.initializer) {
+        resolve(*stmt.initializer);
+    }
+    stmt.slot = declare(stmt.name.str());
+    return Value();
+}
+
+Value Resolver::visit(const PrintStatement& stmt) {
+    resolve(*stmt.expression);
+    return Value();
+}
+
+Value Resolver::visit(const ExpressionStatement& stmt) {
+    resolve(*stmt.expression);
+    return Value();
+}
+
+Value Resolver::visit(const UpdateStatement& stmt) {
+    stmt.resolved = resolveLocal(stmt.name.str());
+    return Value();
+}
+
+Value Resolver::visit(const AssignmentUpdateStatement& stmt) {
+    stmt.resolved = resolveLocal(stmt.name.str());
+    resolve(*stmt.value);
+    return Value();
+}
+
+Value Resolver::visit(const BlockStatement& stmt) {
+    beginScope();
+    resolve(stmt.statements);
+    stmt.slotCount = endScope();
+    return Value();
+}
+
+Value Resolver::visit(const IfStatement& stmt) {
+    resolve(*stmt.condition);
+    resolve(*stmt.thenBranch);
+    if (stmt.elseBranch) {
+        resolve(*stmt.elseBranch);
+    }
+    return Value();
+}
+
+Value Resolver::visit(const WhileStatement& stmt) {
+    resolve(*stmt.condition);
+    resolve(*stmt.thenBranch);
+    return Value();
+}
+
+Value Resolver::visit(const FunctionStatement& stmt) {
+    // Declared before the body so the function can call itself.
+    stmt.slot = declare(stmt.name.str());
+    // A deferred body is resolved once it is parsed (FunctionStatement::getBody()). A top-level
+    // function only sees globals, so it needs no waiting.
+    if (!stmt.isParsed()) {
+        return Value();
+    }
+    if (scopes.empty()) {
+        resolveBody(stmt, *stmt.body);
+    } else {
+        pending.push_back(PendingBody{ &stmt, stmt.body, scopes });
+    }
+    return Value();
+}
+
+void Resolver::resolveBody(const FunctionStatement& function, const BlockStatement& body) {
+    // Parameters and the body's top-level declarations share the call's Environment.
+    beginScope();
+    for (const auto& parameter : function.parameters) {
+        // Arguments fill slots by position, so a repeated parameter cannot wait for the call.
+        if (declare(parameter.str()) == REDECLARED_SLOT) {
+            throw std::runtime_error("Variable '" + parameter.str() + "' already defined in this scope.");
+        }
+    }
+    resolve(body.statements);
+    function.slotCount = endScope();
+}
+
+Value Resolver::visit(const ReturnStatement& stmt) {
+    if (stmt.expression) {
+        resolve(*stmt.expression);
+    }
+    return Value();
+}
@@ -0,0 +1,57 @@
+#include "../hpp/Script.hpp"
+#include <sstream>
+#include "../hpp/Lexer.hpp"
+#include "../hpp/Parser.hpp"
+#include "../hpp/Optimizer.hpp"
+#include "../hpp/Resolver.hpp"
+#include "../hpp/Isolate.hpp"
+#include "../hpp/Jit.hpp"
+
+std::shared_ptr<const Script> compile(const std::string& source, bool optimize) {
+    std::shared_ptr<Script> script(new Script());
+    // Literals are interned into the script's own table rather than the caller's isolate.
+    InternTable* previous = InternTable::makeCurrent(&script->strings);
+    try {
+        std::vector<Token> tokens = tokenize(source);
+        Parser parser(tokens);
+        script->program = parser.parse();
+        if (optimize) {
+            Optimizer(script->program).optimize();
+        }
+        Resolver resolver;
+        resolver.resolve(script->program.statements);
+    } catch (...) {
+        InternTable::makeCurrent(previous);
+        throw;
+    }
+    InternTable::makeCurrent(previous);
+    script->strings.freeze();
+    return script;
+}
+
+ScriptResult run(const std::shared_ptr<const Script>& script,
+                 const std::unordered_map<std::string, Value>& inputs, bool useJit) {
+    std::ostringstream output;
+    ScriptResult result;
+    result.script = script;
+    {
+        Isolate isolate(output);
+        Isolate::Scope scope(isolate);
+        Interpreter& interpreter = isolate.interpreter();
+        std::shared_ptr<Environment> globals = interpreter.getGlobals();
+        for (const auto& input : inputs) {
+            globals->define(input.first, input.second);
+        }
+        if (useJit && Jit::isSupported()) {
+            interpreter.enableJit();
+        }
+        interpreter.run(script->statements());
+        for (const auto& global : globals->getValues()) {
+            if (!global.second.isCallable()) {
+                result.globals.emplace(global.first, global.second);
+            }
+        }
+    }
+    result.output = output.str();
+    return result;
+}
@@ -0,0 +1,355 @@
+#include "../hpp/Simd.hpp"
+#include <cmath>
+#include <limits>
+
+#if (defined(__x86_64__) || defined(_M_X64)) && defined(__GNUC__)
+#include <immintrin.h>
+#define MYLANG_SIMD_X86 1
+#else
+#define MYLANG_SIMD_X86 0
+#endif
+
+namespace simd {
+
+namespace {
+
+constexpr double NOT_A_NUMBER = std::numeric_limits<double>::quiet_NaN();
+
+double compareScalar(Compare op, double left, double right) {
+    switch (op) {
+        case Compare::Less: return left < right ? 1.0 : 0.0;
+        case Compare::Greater: return left > right ? 1.0 : 0.0;
+        case Compare::Equal: return left == right ? 1.0 : 0.0;
+    }
+    return 0.0;
+}
+
+#if !MYLANG_SIMD_X86
+
+namespace scalar {
+
+double sum(const double* data, size_t count) {
+    double result = 0;
+    for (size_t i = 0; i < count; ++i) result += data[i];
+    return result;
+}
+
+double dot(const double* left, const double* right, size_t count) {
+    double result = 0;
+    for (size_t i = 0; i < count; ++i) result += left[i] * right[i];
+    return result;
+}
+
+double min(const double* data, size_t count) {
+    double result = data[0];
+    for (size_t i = 0; i < count; ++i) {
+        if (std::isnan(data[i])) return NOT_A_NUMBER;
+        if (data[i] < result) result = data[i];
+    }
+    return result;
+}
+
+double max(const double* data, size_t count) {
+    double result = data[0];
+    for (size_t i = 0; i < count; ++i) {
+        if (std::isnan(data[i])) return NOT_A_NUMBER;
+        if (data[i] > result) result = data[i];
+    }
+    return result;
+}
+
+void scale(const double* data, double factor, double* out, size_t count) {
+    for (size_t i = 0; i < count; ++i) out[i] = data[i] * factor;
+}
+
+void add(const double* left, const double* right, double* out, size_t count) {
+    for (size_t i = 0; i < count; ++i) out[i] = left[i] + right[i];
+}
+
+void compare(Compare op, const double* left, const double* right, bool broadcast, double* out, size_t count) {
+    for (size_t i = 0; i < count; ++i) out[i] = compareScalar(op, left[i], broadcast ? right[0] : right[i]);
+}
+
+void prefixSum(const double* data, double* out, size_t count) {
+    double running = 0;
+    for (size_t i = 0; i < count; ++i) out[i] = running += data[i];
+}
+
+} // namespace scalar
+
+#else
+
+// SSE2 is part of x86-64, so these need no runtime check.
+namespace sse2 {
+
+double horizontalSum(__m128d value) {
+    return _mm_cvtsd_f64(value) + _mm_cvtsd_f64(_mm_unpackhi_pd(value, value));
+}
+
+double sum(const double* data, size_t count) {
+    __m128d first = _mm_setzero_pd();
+    __m128d second = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        first = _mm_add_pd(first, _mm_loadu_pd(data + i));
+        second = _mm_add_pd(second, _mm_loadu_pd(data + i + 2));
+    }
+    double result = horizontalSum(_mm_add_pd(first, second));
+    for (; i < count; ++i) result += data[i];
+    return result;
+}
+
+double dot(const double* left, const double* right, size_t count) {
+    __m128d first = _mm_setzero_pd();
+    __m128d second = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        first = _mm_add_pd(first, _mm_mul_pd(_mm_loadu_pd(left + i), _mm_loadu_pd(right + i)));
+        second = _mm_add_pd(second, _mm_mul_pd(_mm_loadu_pd(left + i + 2), _mm_loadu_pd(right + i + 2)));
+    }
+    double result = horizontalSum(_mm_add_pd(first, second));
+    for (; i < count; ++i) result += left[i] * right[i];
+    return result;
+}
+
+// minpd/maxpd drop a NaN in the accumulator, so NaNs are tracked in a separate mask.
+template <bool Minimum>
+double extreme(const double* data, size_t count) {
+    __m128d result = _mm_set1_pd(data[0]);
+    __m128d nans = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m128d value = _mm_loadu_pd(data + i);
+        result = Minimum ? _mm_min_pd(result, value) : _mm_max_pd(result, value);
+        nans = _mm_or_pd(nans, _mm_cmpunord_pd(value, value));
+    }
+    if (_mm_movemask_pd(nans) != 0) return NOT_A_NUMBER;
+    double lanes[2];
+    _mm_storeu_pd(lanes, result);
+    double extremum = Minimum ? (lanes[1] < lanes[0] ? lanes[1] : lanes[0]) : (lanes[1] > lanes[0] ? lanes[1] : lanes[0]);
+    for (; i < count; ++i) {
+        if (std::isnan(data[i])) return NOT_A_NUMBER;
+        if (Minimum ? data[i] < extremum : data[i] > extremum) extremum = data[i];
+    }
+    return extremum;
+}
+
+double min(const double* data, size_t count) { return extreme<true>(data, count); }
+double max(const double* data, size_t count) { return extreme<false>(data, count); }
+
+void scale(const double* data, double factor, double* out, size_t count) {
+    __m128d multiplier = _mm_set1_pd(factor);
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        _mm_storeu_pd(out + i, _mm_mul_pd(_mm_loadu_pd(data + i), multiplier));
+    }
+    for (; i < count; ++i) out[i] = data[i] * factor;
+}
+
+void add(const double* left, const double* right, double* out, size_t count) {
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        _mm_storeu_pd(out + i, _mm_add_pd(_mm_loadu_pd(left + i), _mm_loadu_pd(right + i)));
+    }
+    for (; i < count; ++i) out[i] = left[i] + right[i];
+}
+
+template <Compare op, bool broadcast>
+void compareLoop(const double* left, const double* right, double* out, size_t count) {
+    const __m128d ones = _mm_set1_pd(1.0);
+    const __m128d scalarRight = _mm_set1_pd(right[0]);
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m128d a = _mm_loadu_pd(left + i);
+        __m128d b = broadcast ? scalarRight : _mm_loadu_pd(right + i);
+        __m128d mask = op == Compare::Less ? _mm_cmplt_pd(a, b) : op == Compare::Greater ? _mm_cmpgt_pd(a, b) : _mm_cmpeq_pd(a, b);
+        _mm_storeu_pd(out + i, _mm_and_pd(mask, ones));
+    }
+    for (; i < count; ++i) out[i] = compareScalar(op, left[i], broadcast ? right[0] : right[i]);
+}
+
+template <bool broadcast>
+void compareAs(Compare op, const double* left, const double* right, double* out, size_t count) {
+    switch (op) {
+        case Compare::Less: compareLoop<Compare::Less, broadcast>(left, right, out, count); break;
+        case Compare::Greater: compareLoop<Compare::Greater, broadcast>(left, right, out, count); break;
+        case Compare::Equal: compareLoop<Compare::Equal, broadcast>(left, right, out, count); break;
+    }
+}
+
+void compare(Compare op, const double* left, const double* right, bool broadcast, double* out, size_t count) {
+    if (broadcast) compareAs<true>(op, left, right, out, count);
+    else compareAs<false>(op, left, right, out, count);
+}
+
+// Scans two elements at a time: [a, b] + [0, a] gives both prefixes, then the carry is added.
+void prefixSum(const double* data, double* out, size_t count) {
+    __m128d carry = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m128d value = _mm_loadu_pd(data + i);
+        value = _mm_add_pd(value, _mm_unpacklo_pd(_mm_setzero_pd(), value));
+        value = _mm_add_pd(value, carry);
+        _mm_storeu_pd(out + i, value);
+        carry = _mm_unpackhi_pd(value, value);
+    }
+    double running = _mm_cvtsd_f64(carry);
+    for (; i < count; ++i) out[i] = running += data[i];
+}
+
+} // namespace sse2
+
+#define MYLANG_AVX __attribute__((target("avx")))
+
+namespace avx {
+
+MYLANG_AVX double horizontalSum(__m256d value) {
+    __m128d pair = _mm_add_pd(_mm256_castpd256_pd128(value), _mm256_extractf128_pd(value, 1));
+    return _mm_cvtsd_f64(pair) + _mm_cvtsd_f64(_mm_unpackhi_pd(pair, pair));
+}
+
+MYLANG_AVX double sum(const double* data, size_t count) {
+    __m256d first = _mm256_setzero_pd();
+    __m256d second = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        first = _mm256_add_pd(first, _mm256_loadu_pd(data + i));
+        second = _mm256_add_pd(second, _mm256_loadu_pd(data + i + 4));
+    }
+    double result = horizontalSum(_mm256_add_pd(first, second));
+    for (; i < count; ++i) result += data[i];
+    return result;
+}
+
+MYLANG_AVX double dot(const double* left, const double* right, size_t count) {
+    __m256d first = _mm256_setzero_pd();
+    __m256d second = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        first = _mm256_add_pd(first, _mm256_mul_pd(_mm256_loadu_pd(left + i), _mm256_loadu_pd(right + i)));
+        second = _mm256_add_pd(second, _mm256_mul_pd(_mm256_loadu_pd(left + i + 4), _mm256_loadu_pd(right + i + 4)));
+    }
+    double result = horizontalSum(_mm256_add_pd(first, second));
+    for (; i < count; ++i) result += left[i] * right[i];
+    return result;
+}
+
+template <bool Minimum>
+MYLANG_AVX double extreme(const double* data, size_t count) {
+    __m256d result = _mm256_set1_pd(data[0]);
+    __m256d nans = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d value = _mm256_loadu_pd(data + i);
+        result = Minimum ? _mm256_min_pd(result, value) : _mm256_max_pd(result, value);
+        nans = _mm256_or_pd(nans, _mm256_cmp_pd(value, value, _CMP_UNORD_Q));
+    }
+    if (_mm256_movemask_pd(nans) != 0) return NOT_A_NUMBER;
+    double lanes[4];
+    _mm256_storeu_pd(lanes, result);
+    double extremum = lanes[0];
+    for (double lane : lanes) {
+        if (Minimum ? lane < extremum : lane > extremum) extremum = lane;
+    }
+    for (; i < count; ++i) {
+        if (std::isnan(data[i])) return NOT_A_NUMBER;
+        if (Minimum ? data[i] < extremum : data[i] > extremum) extremum = data[i];
+    }
+    return extremum;
+}
+
+MYLANG_AVX double min(const double* data, size_t count) { return extreme<true>(data, count); }
+MYLANG_AVX double max(const double* data, size_t count) { return extreme<false>(data, count); }
+
+MYLANG_AVX void scale(const double* data, double factor, double* out, size_t count) {
+    __m256d multiplier = _mm256_set1_pd(factor);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_loadu_pd(data + i), multiplier));
+    }
+    for (; i < count; ++i) out[i] = data[i] * factor;
+}
+
+MYLANG_AVX void add(const double* left, const double* right, double* out, size_t count) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_loadu_pd(left + i), _mm256_loadu_pd(right + i)));
+    }
+    for (; i < count; ++i) out[i] = left[i] + right[i];
+}
+
+template <int predicate, bool broadcast>
+MYLANG_AVX void compareLoop(Compare op, const double* left, const double* right, double* out, size_t count) {
+    const __m256d ones = _mm256_set1_pd(1.0);
+    const __m256d scalarRight = _mm256_set1_pd(right[0]);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d b = broadcast ? scalarRight : _mm256_loadu_pd(right + i);
+        __m256d mask = _mm256_cmp_pd(_mm256_loadu_pd(left + i), b, predicate);
+        _mm256_storeu_pd(out + i, _mm256_and_pd(mask, ones));
+    }
+    for (; i < count; ++i) out[i] = compareScalar(op, left[i], broadcast ? right[0] : right[i]);
+}
+
+template <bool broadcast>
+MYLANG_AVX void compareAs(Compare op, const double* left, const double* right, double* out, size_t count) {
+    switch (op) {
+        case Compare::Less: compareLoop<_CMP_LT_OQ, broadcast>(op, left, right, out, count); break;
+        case Compare::Greater: compareLoop<_CMP_GT_OQ, broadcast>(op, left, right, out, count); break;
+        case Compare::Equal: compareLoop<_CMP_EQ_OQ, broadcast>(op, left, right, out, count); break;
+    }
+}
+
+MYLANG_AVX void compare(Compare op, const double* left, const double* right, bool broadcast, double* out, size_t count) {
+    if (broadcast) compareAs<true>(op, left, right, out, count);
+    else compareAs<false>(op, left, right, out, count);
+}
+
+} // namespace avx
+
+#endif
+
+// The kernel set in use, chosen on first use.
+struct Kernels {
+    const char* name;
+    double (*sum)(const double*, size_t);
+    double (*dot)(const double*, const double*, size_t);
+    double (*min)(const double*, size_t);
+    double (*max)(const double*, size_t);
+    void (*scale)(const double*, double, double*, size_t);
+    void (*add)(const double*, const double*, double*, size_t);
+    void (*compare)(Compare, const double*, const double*, bool, double*, size_t);
+    void (*prefixSum)(const double*, double*, size_t);
+};
+
+const Kernels& kernels() {
+    static const Kernels selected = [] {
+#if MYLANG_SIMD_X86
+        // A scan's lanes depend on each other; without AVX2 lane permutes the SSE2 one is as fast.
+        if (__builtin_cpu_supports("avx")) {
+            return Kernels{ "avx", avx::sum, avx::dot, avx::min, avx::max, avx::scale, avx::add, avx::compare, sse2::prefixSum };
+        }
+        return Kernels{ "sse2", sse2::sum, sse2::dot, sse2::min, sse2::max, sse2::scale, sse2::add, sse2::compare, sse2::prefixSum };
+#else
+        return Kernels{ "scalar", scalar::sum, scalar::dot, scalar::min, scalar::max, scalar::scale, scalar::add, scalar::compare, scalar::prefixSum };
+#endif
+    }();
+    return selected;
+}
+
+} // namespace
+
+double sum(const double* data, size_t count) { return kernels().sum(data, count); }
+double dot(const double* left, const double* right, size_t count) { return kernels().dot(left, right, count); }
+double min(const double* data, size_t count) { return kernels().min(data, count); }
+double max(const double* data, size_t count) { return kernels().max(data, count); }
+void scale(const double* data, double factor, double* out, size_t count) { kernels().scale(data, factor, out, count); }
+void add(const double* left, const double* right, double* out, size_t count) { kernels().add(left, right, out, count); }
+void compare(Compare op, const double* left, const double* right, bool broadcast, double* out, size_t count) {
+    kernels().compare(op, left, right, broadcast, out, count);
+}
+void prefixSum(const double* data, double* out, size_t count) { kernels().prefixSum(data, out, count); }
+
+const char* implementation() { return kernels().name; }
+
+} // namespace simd
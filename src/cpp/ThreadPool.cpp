@@ -0,0 +1,135 @@
+#include "../hpp/ThreadPool.hpp"
+#include <algorithm>
+
+size_t ThreadPool::configuredThreads = 0;
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool(configuredThreads != 0 ? configuredThreads
+                                                  : std::max<size_t>(1, std::thread::hardware_concurrency()));
+    return pool;
+}
+
+void ThreadPool::setThreadCount(size_t count) {
+    configuredThreads = count;
+}
+
+ThreadPool::ThreadPool(size_t threads) {
+    for (size_t i = 0; i < threads; ++i) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (size_t i = 1; i < threads; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::run(size_t count, const std::function<void(size_t index, size_t thread)>& task) {
+    if (count == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> jobLock(jobMutex);
+    for (size_t i = 0; i < count; ++i) {
+        Queue& queue = *queues[i % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(i);
+    }
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        job = &task;
+        error = nullptr;
+        running = workers.size();
+        ++generation;
+    }
+    wake.notify_all();
+
+    work(0);
+
+    std::exception_ptr failure;
+    {
+        std::unique_lock<std::mutex> lock(stateMutex);
+        finished.wait(lock, [this] { return running == 0; });
+        job = nullptr;
+        failure = error;
+        error = nullptr;
+    }
+    if (failure) {
+        std::rethrow_exception(failure);
+    }
+}
+
+void ThreadPool::workerLoop(size_t thread) {
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(stateMutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+        }
+        work(thread);
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            if (--running == 0) {
+                finished.notify_one();
+            }
+        }
+    }
+}
+
+void ThreadPool::work(size_t thread) {
+    size_t index;
+    while (take(thread, index)) {
+        try {
+            (*job)(index, thread);
+        } catch (...) {
+            {
+                std::lock_guard<std::mutex> lock(stateMutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+            discardTasks();
+        }
+    }
+}
+
+bool ThreadPool::take(size_t thread, size_t& index) {
+    {
+        Queue& own = *queues[thread];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            index = own.tasks.back();
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (size_t offset = 1; offset < queues.size(); ++offset) {
+        Queue& victim = *queues[(thread + offset) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            index = victim.tasks.front();
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::discardTasks() {
+    for (const std::unique_ptr<Queue>& queue : queues) {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        queue->tasks.clear();
+    }
+}
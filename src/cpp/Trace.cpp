@@ -0,0 +1,96 @@
+#include "../hpp/Trace.hpp"
+#include <mutex>
+
+uint32_t Trace::categories = 0;
+TraceLevel Trace::maxLevel = TraceLevel::Debug;
+std::vector<std::string> Trace::ring;
+size_t Trace::ringNext = 0;
+bool Trace::ringFull = false;
+
+// Pool threads running parallel_map and parallel_for trace too.
+static std::mutex writeMutex;
+
+static const char* categoryName(TraceCategory category) {
+    switch (category) {
+        case TraceCategory::Lexer: return "lexer";
+        case TraceCategory::Parser: return "parser";
+        case TraceCategory::Interpreter: return "interpreter";
+        case TraceCategory::Environment: return "environment";
+        case TraceCategory::Jit: return "jit";
+        case TraceCategory::Optimizer: return "optimizer";
+    }
+    return "trace";
+}
+
+bool Trace::enableCategories(const std::string& names) {
+    std::stringstream stream(names);
+    std::string name;
+    while (std::getline(stream, name, ',')) {
+        if (name == "all") {
+            categories = ~0u;
+        } else if (name == "lexer") {
+            categories |= static_cast<uint32_t>(TraceCategory::Lexer);
+        } else if (name == "parser") {
+            categories |= static_cast<uint32_t>(TraceCategory::Parser);
+        } else if (name == "interpreter") {
+            categories |= static_cast<uint32_t>(TraceCategory::Interpreter);
+        } else if (name == "environment") {
+            categories |= static_cast<uint32_t>(TraceCategory::Environment);
+        } else if (name == "jit") {
+            categories |= static_cast<uint32_t>(TraceCategory::Jit);
+        } else if (name == "optimizer") {
+            categories |= static_cast<uint32_t>(TraceCategory::Optimizer);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Trace::setLevel(const std::string& name) {
+    if (name == "info") {
+        maxLevel = TraceLevel::Info;
+    } else if (name == "debug") {
+        maxLevel = TraceLevel::Debug;
+    } else if (name == "verbose") {
+        maxLevel = TraceLevel::Verbose;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void Trace::useRingBuffer(size_t capacity) {
+    ring.assign(capacity, std::string());
+    ringNext = 0;
+    ringFull = false;
+}
+
+void Trace::write(TraceCategory category, const std::string& message) {
+    std::string line = std::string("[") + categoryName(category) + "] " + message;
+    std::lock_guard<std::mutex> lock(writeMutex);
+    if (ring.empty()) {
+        std::clog << line << '\n';
+        return;
+    }
+    ring[ringNext] = std::move(line);
+    ringNext = (ringNext + 1) % ring.size();
+    if (ringNext == 0) {
+        ringFull = true;
+    }
+}
+
+void Trace::dumpRingBuffer(std::ostream& out) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    if (ring.empty() || (!ringFull && ringNext == 0)) {
+        return;
+    }
+    out << "--- Last trace messages ---" << '\n';
+    size_t start = ringFull ? ringNext : 0;
+    size_t count = ringFull ? ring.size() : ringNext;
+    for (size_t i = 0; i < count; ++i) {
+        out << ring[(start + i) % ring.size()] << '\n';
+    }
+    out.flush();
+    useRingBuffer(ring.size());
+}
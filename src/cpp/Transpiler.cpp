@@ -0,0 +1,358 @@
+#include "../hpp/Transpiler.hpp"
+#include <cmath>
+#include <iomanip>
+#include <limits>
+
+Transpiler::Transpiler(std::string sourceName) : sourceName(std::move(sourceName)) {}
+
+std::string Transpiler::translate(const StatementList& statements) {
+    bodies.emplace_back();
+    translateStatements(statements);
+    std::string program = bodies.back().out.str();
+    bodies.pop_back();
+
+    std::ostringstream out;
+    out << "// Translated from " << sourceName << " by MyLang --emit-cpp. Build it against the runtime:\n"
+        << "//   g++ -std=c++17 -O2 -pthread -I<MyLang>/src/hpp <this file> <MyLang>/src/cpp/*.cpp except main.cpp\n"
+        << "#include \"AotRuntime.hpp\"\n"
+        << "#include <stdexcept>\n"
+        << "\n"
+        << "using namespace aot;\n"
+        << "\n"
+        << "namespace {\n"
+        << "\n"
+        << constants.str() << "\n"
+        << declarations.str() << "\n"
+        << definitions.str()
+        << "void program(Interpreter& interpreter) {\n"
+        << program
+        << "}\n"
+        << "\n"
+        << "} // namespace\n"
+        << "\n"
+        << "int main() {\n"
+        << "    return run(program);\n"
+        << "}\n";
+    return out.str();
+}
+
+std::string Transpiler::translate(const Expression& expr) {
+    expr.accept(*this);
+    return std::move(expression);
+}
+
+void Transpiler::translate(const Statement& stmt) {
+    stmt.accept(*this);
+}
+
+void Transpiler::translateStatements(const StatementList& statements) {
+    for (const auto& statement : statements) {
+        translate(*statement);
+    }
+}
+
+std::ostream& Transpiler::line() {
+    Body& body = bodies.back();
+    for (int i = 0; i < body.indent; ++i) body.out << "    ";
+    return body.out;
+}
+
+void Transpiler::open(const std::string& text) {
+    line() << text << "\n";
+    bodies.back().indent++;
+}
+
+void Transpiler::close(const std::string& text) {
+    bodies.back().indent--;
+    line() << text << "\n";
+}
+
+std::string Transpiler::name(const std::string& text) {
+    auto it = names.find(text);
+    if (it != names.end()) {
+        return it->second;
+    }
+    std::string identifier = "name_" + std::to_string(nextConstant++);
+    constants << "const std::string " << identifier << "(" << quote(text) << ", " << text.size() << ");\n";
+    names.emplace(text, identifier);
+    return identifier;
+}
+
+// Strings are interned on first use rather than during static initialization, which would
+// race the runtime's own statics.
+std::string Transpiler::stringConstant(const std::string& text) {
+    std::string identifier = "string_" + std::to_string(nextConstant++);
+    constants << "const Value& " << identifier << "() {\n"
+              << "    static const Value value = Value::intern(std::string(" << quote(text) << ", " << text.size() << "));\n"
+              << "    return value;\n"
+              << "}\n";
+    return identifier + "()";
+}
+
+// Built once and copied on write, like the Interpreter does with ArrayExpr::constant.
+std::string Transpiler::arrayConstant(const ArrayExpr& expr) {
+    std::vector<std::string> elements;
+    for (const auto& element : expr.elements) {
+        elements.push_back(translate(*element));
+    }
+    std::string identifier = "array_" + std::to_string(nextConstant++);
+    constants << "const Value& " << identifier << "() {\n"
+              << "    static const Value value = Value(std::vector<Value>{ ";
+    for (size_t i = 0; i < elements.size(); ++i) {
+        constants << (i ? ", " : "") << elements[i];
+    }
+    constants << " });\n"
+              << "    return value;\n"
+              << "}\n";
+    return "Value::copyArray(" + identifier + "())";
+}
+
+std::string Transpiler::slot(const VariableSlot& resolved) {
+    return "VariableSlot{ " + std::to_string(resolved.depth) + ", " + std::to_string(resolved.slot) + " }";
+}
+
+// Literal that reads back as exactly the same double.
+std::string Transpiler::number(double value) {
+    if (std::isnan(value)) return "std::numeric_limits<double>::quiet_NaN()";
+    if (std::isinf(value)) return value > 0 ? "std::numeric_limits<double>::infinity()" : "-std::numeric_limits<double>::infinity()";
+    std::ostringstream out;
+    out << std::setprecision(std::numeric_limits<double>::max_digits10) << value;
+    std::string text = out.str();
+    if (text.find_first_of(".e") == std::string::npos) {
+        text += ".0";
+    }
+    return text;
+}
+
+std::string Transpiler::quote(const std::string& text) {
+    std::ostringstream out;
+    out << '"';
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (c >= 0x20 && c < 0x7F && c != '?') {
+            out << c;
+        } else {
+            // Three octal digits always end the escape, whatever character follows.
+            out << '\\' << std::oct << std::setw(3) << std::setfill('0') << static_cast<int>(c) << std::dec;
+        }
+    }
+    out << '"';
+    return out.str();
+}
+
+const char* Transpiler::binaryOpName(BinaryOp op) {
+    switch (op) {
+        case BinaryOp::Assign: return "BinaryOp::Assign";
+        case BinaryOp::Or: return "BinaryOp::Or";
+        case BinaryOp::And: return "BinaryOp::And";
+        case BinaryOp::Equal: return "BinaryOp::Equal";
+        case BinaryOp::NotEqual: return "BinaryOp::NotEqual";
+        case BinaryOp::Greater: return "BinaryOp::Greater";
+        case BinaryOp::GreaterEqual: return "BinaryOp::GreaterEqual";
+        case BinaryOp::Less: return "BinaryOp::Less";
+        case BinaryOp::LessEqual: return "BinaryOp::LessEqual";
+        case BinaryOp::Add: return "BinaryOp::Add";
+        case BinaryOp::Subtract: return "BinaryOp::Subtract";
+        case BinaryOp::Multiply: return "BinaryOp::Multiply";
+        case BinaryOp::Divide: return "BinaryOp::Divide";
+        case BinaryOp::Modulo: return "BinaryOp::Modulo";
+    }
+    return "BinaryOp::Assign";
+}
+
+Value Transpiler::visit(const NumberExpr& expr) {
+    expression = "Value(" + number(expr.value) + ")";
+    return Value();
+}
+
+Value Transpiler::visit(const StringExpr& expr) {
+    expression = stringConstant(expr.constant.asString());
+    return Value();
+}
+
+Value Transpiler::visit(const BooleanExpr& expr) {
+    expression = expr.value ? "Value(true)" : "Value(false)";
+    return Value();
+}
+
+Value Transpiler::visit(const VariableExpr& expr) {
+    expression = "interpreter.lookUpVariable(" + name(expr.name.str()) + ", " + slot(expr.resolved) + ")";
+    return Value();
+}
+
+Value Transpiler::visit(const ArrayExpr& expr) {
+    if (expr.constant.isArray()) {
+        expression = arrayConstant(expr);
+        return Value();
+    }
+    std::string elements;
+    for (const auto& element : expr.elements) {
+        elements += (elements.empty() ? "" : ", ") + translate(*element);
+    }
+    expression = "Value(std::vector<Value>{ " + elements + " })";
+    return Value();
+}
+
+Value Transpiler::visit(const IndexExpr& expr) {
+    std::string array = translate(*expr.array);
+    std::string index = translate(*expr.index);
+    expression = "getIndex(interpreter, { " + array + ", " + index + " })";
+    return Value();
+}
+
+Value Transpiler::visit(const IndexAssignmentExpr& expr) {
+    std::string array = translate(*expr.array);
+    std::string index = translate(*expr.index);
+    std::string value = translate(*expr.value);
+    expression = "setIndex(interpreter, { " + array + ", " + index + ", " + value + " })";
+    return Value();
+}
+
+Value Transpiler::visit(const BinaryExpr& expr) {
+    if (expr.op == BinaryOp::Assign) {
+        const VariableExpr* target = dynamic_cast<const VariableExpr*>(expr.left);
+        if (!target) {
+            expression = "(throw std::runtime_error(\"Invalid assignment target.\"), Value())";
+            return Value();
+        }
+        std::string value = translate(*expr.right);
+        expression = "assign(interpreter, " + name(target->name.str()) + ", " + slot(target->resolved) + ", " + value + ")";
+        return Value();
+    }
+
+    std::string left = translate(*expr.left);
+    std::string right = translate(*expr.right);
+    switch (expr.op) {
+        case BinaryOp::And:
+            expression = "Value(interpreter.isTruthy(" + left + ") && interpreter.isTruthy(" + right + "))";
+            break;
+        case BinaryOp::Or:
+            expression = "Value(interpreter.isTruthy(" + left + ") || interpreter.isTruthy(" + right + "))";
+            break;
+        default:
+            expression = std::string("binary<") + binaryOpName(expr.op) + ">(interpreter, { " + left + ", " + right + " })";
+            break;
+    }
+    return Value();
+}
+
+Value Transpiler::visit(const UnaryExpr& expr) {
+    std::string op = expr.op == UnaryOp::Negate ? "UnaryOp::Negate" : "UnaryOp::Not";
+    expression = "interpreter.unaryOperation(" + op + ", " + translate(*expr.right) + ")";
+    return Value();
+}
+
+Value Transpiler::visit(const CallExpr& expr) {
+    std::string callee = translate(*expr.callee);
+    std::string arguments;
+    for (const auto& argument : expr.arguments) {
+        arguments += (arguments.empty() ? "" : ", ") + translate(*argument);
+    }
+    expression = "call(interpreter, { Interpreter::callableOf(" + callee + "), { " + arguments + " } })";
+    return Value();
+}
+
+Value Transpiler::visit(const UpdateExpr& expr) {
+    std::string op = expr.op == UpdateOp::Increment ? "UpdateOp::Increment" : "UpdateOp::Decrement";
+    expression = "interpreter.updateVariable(" + name(expr.name.str()) + ", " + slot(expr.resolved) + ", " + op + ")";
+    return Value();
+}
+
+Value Transpiler::visit(const GroupingExpr& expr) {
+    expression = translate(*expr.expression);
+    return Value();
+}
+
+Value Transpiler::visit(const LetStatement& stmt) {
+    std::string value = stmt.initializer ? translate(*stmt.initializer) : "Value()";
+    line() << "interpreter.defineVariable(" << name(stmt.name.str()) << ", " << stmt.slot << ", " << value << ");\n";
+    return Value();
+}
+
+Value Transpiler::visit(const PrintStatement& stmt) {
+    line() << "print(interpreter, " << translate(*stmt.expression) << ");\n";
+    return Value();
+}
+
+Value Transpiler::visit(const ExpressionStatement& stmt) {
+    line() << translate(*stmt.expression) << ";\n";
+    return Value();
+}
+
+Value Transpiler::visit(const UpdateStatement& stmt) {
+    std::string op = stmt.op == UpdateOp::Increment ? "UpdateOp::Increment" : "UpdateOp::Decrement";
+    line() << "interpreter.updateVariable(" << name(stmt.name.str()) << ", " << slot(stmt.resolved) << ", " << op << ");\n";
+    return Value();
+}
+
+Value Transpiler::visit(const AssignmentUpdateStatement& stmt) {
+    std::string variable = name(stmt.name.str()) + ", " + slot(stmt.resolved);
+    open("{");
+    line() << "Value current = interpreter.lookUpVariable(" << variable << ");\n";
+    line() << "interpreter.assignVariable(" << variable << ", interpreter.compoundValue("
+           << binaryOpName(stmt.op) << ", current, " << translate(*stmt.value) << "));\n";
+    close();
+    return Value();
+}
+
+Value Transpiler::visit(const BlockStatement& stmt) {
+    open("{");
+    line() << "Frame frame(interpreter, interpreter.currentEnvironment(), " << stmt.slotCount << ");\n";
+    translateStatements(stmt.statements);
+    close();
+    return Value();
+}
+
+Value Transpiler::visit(const IfStatement& stmt) {
+    open("if (interpreter.isTruthy(" + translate(*stmt.condition) + ")) {");
+    translate(*stmt.thenBranch);
+    if (stmt.elseBranch) {
+        close("} else {");
+        bodies.back().indent++;
+        translate(*stmt.elseBranch);
+    }
+    close();
+    return Value();
+}
+
+Value Transpiler::visit(const WhileStatement& stmt) {
+    open("while (interpreter.isTruthy(" + translate(*stmt.condition) + ")) {");
+    translate(*stmt.thenBranch);
+    close();
+    return Value();
+}
+
+Value Transpiler::visit(const FunctionStatement& stmt) {
+    // Parsed (and resolved) first if deferred, which also sets slotCount.
+    const BlockStatement* body = stmt.getBody();
+    std::string identifier = "function_" + std::to_string(nextFunction++) + "_" + stmt.name.str();
+    declarations << "Value " << identifier << "(Interpreter& interpreter);\n"
+                 << "const FunctionInfo " << identifier << "_info{ " << quote(stmt.name.str()) << ", "
+                 << stmt.parameters.size() << ", " << stmt.slotCount << ", " << identifier << " };\n";
+
+    // Parameters and the body's top-level declarations share the frame CompiledFunction::call makes.
+    bodies.emplace_back();
+    bodies.back().inFunction = true;
+    translateStatements(body->statements);
+    line() << "return Value();\n";
+    definitions << "Value " << identifier << "(Interpreter& interpreter) {\n" << bodies.back().out.str() << "}\n\n";
+    bodies.pop_back();
+
+    line() << "interpreter.defineVariable(" << name(stmt.name.str()) << ", " << stmt.slot
+           << ", makeFunction(interpreter, " << identifier << "_info));\n";
+    return Value();
+}
+
+Value Transpiler::visit(const ReturnStatement& stmt) {
+    std::string value = stmt.expression ? translate(*stmt.expression) : "Value()";
+    if (bodies.back().inFunction) {
+        line() << "return " << value << ";\n";
+    } else {
+        open("{");
+        line() << value << ";\n";
+        line() << "throw std::runtime_error(\"Cannot return from top-level code.\");\n";
+        close();
+    }
+    return Value();
+}
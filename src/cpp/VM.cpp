@@ -0,0 +1,478 @@
+#include "../hpp/VM.hpp"
+#include <iostream>
+#include <stdexcept>
+#include "../hpp/Trace.hpp"
+
+static bool isTruthy(const Value& val) {
+    if (val.isNull()) return false;
+    if (val.isBool()) return val.asBool();
+    if (val.isNumber()) return val.asNumber() != 0;
+    if (val.isString()) return !val.asString().empty();
+    if (val.isArray()) return !val.asArray().empty();
+    if (val.isFloat64Array()) return !val.asFloat64Array().empty();
+    return true;
+}
+
+static void checkNumberOperand(const char* op_name, const Value& operand) {
+    if (!operand.isNumber()) {
+        throw std::runtime_error(std::string("Operand for '") + op_name + "' must be a number.");
+    }
+}
+
+static void checkNumberOperands(const char* op_name, const Value& left, const Value& right) {
+    if (!left.isNumber() || !right.isNumber()) {
+        throw std::runtime_error(std::string("Operands for '") + op_name + "' must be numbers.");
+    }
+}
+
+static size_t checkArrayIndex(const Value& array_val, const Value& index_val) {
+    if (!array_val.isArray() && !array_val.isFloat64Array()) {
+        throw std::runtime_error("Attempted to index a non-array value.");
+    }
+    if (!index_val.isNumber()) {
+        throw std::runtime_error("Array index must be a number.");
+    }
+    double raw_index = index_val.asNumber();
+    if (static_cast<long long>(raw_index) != raw_index || raw_index < 0) {
+        throw std::runtime_error("Array index must be a non-negative integer.");
+    }
+    long long index_ll = static_cast<long long>(raw_index);
+    size_t size = array_val.isArray() ? array_val.asArray().size() : array_val.asFloat64Array().size();
+    if (index_ll >= size) {
+        throw std::runtime_error("Array index out of bounds. Index: " + std::to_string(index_ll) +
+                                 ", Array size: " + std::to_string(size));
+    }
+    return static_cast<size_t>(index_ll);
+}
+
+static Value add(const char* op_name, const Value& left, const Value& right) {
+    if (left.isNumber() && right.isNumber()) {
+        return Value(left.asNumber() + right.asNumber());
+    }
+    if (left.isString() || right.isString()) {
+        return Value::concat(left, right);
+    }
+    checkNumberOperands(op_name, left, right);
+    return Value();
+}
+
+Value VMClosure::call(Interpreter& interpreter, std::vector<Value> arguments) {
+    return vm.callClosure(*this, arguments);
+}
+
+VM::VM(Interpreter& host) : host(host), stack(STACK_MAX) {
+    resetStack();
+    frames.reserve(FRAMES_MAX);
+
+    for (const auto& entry : host.getBuiltins()->getValues()) {
+        int index = globalNames.indexOf(entry.first);
+        syncGlobals();
+        globals[index] = entry.second;
+        globalDefined[index] = true;
+        globalBuiltin[index] = true;
+    }
+}
+
+void VM::interpret(const StatementList& statements) {
+    std::shared_ptr<FunctionProto> script;
+    try {
+        Compiler compiler(globalNames);
+        script = compiler.compile(statements);
+        syncGlobals();
+    } catch (const std::runtime_error& error) {
+        std::cerr << "Compile Error: " << error.what() << std::endl;
+        Trace::dumpRingBuffer(std::cerr);
+        return;
+    }
+
+    auto closure = std::make_shared<VMClosure>(script, *this);
+    try {
+        push(Value(std::static_pointer_cast<Callable>(closure)));
+        pushFrame(*closure, 0);
+        run(0);
+        pop();
+    } catch (const std::runtime_error& error) {
+        int line = 0;
+        if (!frames.empty()) {
+            const CallFrame& frame = frames.back();
+            const Chunk& chunk = frame.closure->function->chunk;
+            line = chunk.getLine(frame.ip - chunk.code.data() - 1);
+        }
+        std::cerr << "Runtime Error (line " << line << "): " << error.what() << std::endl;
+        Trace::dumpRingBuffer(std::cerr);
+        resetStack();
+    }
+}
+
+Value VM::callClosure(VMClosure& closure, const std::vector<Value>& arguments) {
+    // Slot zero is never read by compiled code; the caller keeps the closure alive.
+    push(Value());
+    for (const auto& argument : arguments) {
+        push(argument);
+    }
+    size_t baseFrame = frames.size();
+    pushFrame(closure, static_cast<int>(arguments.size()));
+    run(baseFrame);
+    return pop();
+}
+
+void VM::push(Value value) {
+    *stackTop++ = std::move(value);
+}
+
+Value VM::pop() {
+    return std::move(*--stackTop);
+}
+
+void VM::resetStack() {
+    stackTop = stack.data();
+    frames.clear();
+    openUpvalues.clear();
+}
+
+void VM::syncGlobals() {
+    globals.resize(globalNames.size());
+    globalDefined.resize(globalNames.size(), false);
+    globalBuiltin.resize(globalNames.size(), false);
+}
+
+void VM::pushFrame(VMClosure& closure, int argCount) {
+    if (frames.size() == FRAMES_MAX || stackTop + 256 > stack.data() + STACK_MAX) {
+        throw std::runtime_error("Stack overflow.");
+    }
+    frames.push_back(CallFrame{ &closure, closure.function->chunk.code.data(), stackTop - argCount - 1 });
+}
+
+void VM::callValue(int argCount) {
+    const Value& callee = stackTop[-1 - argCount];
+    if (!callee.isCallable()) {
+        throw std::runtime_error("Can only call functions and classes. Tried to call: " + callee.toString());
+    }
+
+    std::shared_ptr<Callable> function = callee.asCallable();
+    if (argCount != function->arity()) {
+        throw std::runtime_error("Expected " + std::to_string(function->arity()) +
+                                 " arguments but got " + std::to_string(argCount) + ".");
+    }
+
+    if (VMClosure* closure = dynamic_cast<VMClosure*>(function.get())) {
+        pushFrame(*closure, argCount);
+        return;
+    }
+
+    std::vector<Value> arguments(stackTop - argCount, stackTop);
+    Value result = function->call(host, std::move(arguments));
+    stackTop -= argCount + 1;
+    push(std::move(result));
+}
+
+std::shared_ptr<Upvalue> VM::captureUpvalue(Value* local) {
+    for (const auto& upvalue : openUpvalues) {
+        if (upvalue->location == local) {
+            return upvalue;
+        }
+    }
+    auto created = std::make_shared<Upvalue>(Upvalue{ local, Value() });
+    openUpvalues.push_back(created);
+    return created;
+}
+
+void VM::closeUpvalues(Value* last) {
+    for (auto it = openUpvalues.begin(); it != openUpvalues.end();) {
+        Upvalue& upvalue = **it;
+        if (upvalue.location >= last) {
+            upvalue.closed = *upvalue.location;
+            upvalue.location = &upvalue.closed;
+            it = openUpvalues.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void VM::run(size_t baseFrame) {
+    CallFrame* frame = &frames.back();
+    const uint8_t* ip = frame->ip;
+
+    auto readByte = [&]() -> uint8_t { return *ip++; };
+    auto readShort = [&]() -> uint16_t {
+        ip += 2;
+        return static_cast<uint16_t>((ip[-2] << 8) | ip[-1]);
+    };
+
+    try {
+        for (;;) {
+            switch (static_cast<OpCode>(readByte())) {
+            case OpCode::Constant:
+                push(frame->closure->function->chunk.constants[readShort()]);
+                break;
+            case OpCode::Null: push(Value()); break;
+            case OpCode::Unset: push(Value::unset()); break;
+            case OpCode::True: push(Value(true)); break;
+            case OpCode::False: push(Value(false)); break;
+            case OpCode::Pop: --stackTop; break;
+
+            case OpCode::GetLocal:
+                push(frame->slots[readByte()]);
+                break;
+            case OpCode::SetLocal:
+                frame->slots[readByte()] = stackTop[-1];
+                break;
+            // A captured local that is still unset has not been declared yet; until it is, the
+            // name means the global, as in the interpreter.
+            case OpCode::GetUpvalue: {
+                uint8_t index = readByte();
+                const Value& value = *frame->closure->upvalues[index]->location;
+                if (!value.isUnset()) {
+                    push(value);
+                    break;
+                }
+                uint16_t global = frame->closure->function->upvalueGlobals[index];
+                if (!globalDefined[global]) {
+                    throw std::runtime_error("Undefined variable '" + globalNames.nameOf(global) + "'.");
+                }
+                push(globals[global]);
+                break;
+            }
+            case OpCode::SetUpvalue: {
+                uint8_t index = readByte();
+                Value& target = *frame->closure->upvalues[index]->location;
+                if (!target.isUnset()) {
+                    target = stackTop[-1];
+                    break;
+                }
+                uint16_t global = frame->closure->function->upvalueGlobals[index];
+                if (!globalDefined[global]) {
+                    throw std::runtime_error("Undefined variable '" + globalNames.nameOf(global) + "' for assignment.");
+                }
+                globals[global] = stackTop[-1];
+                break;
+            }
+
+            case OpCode::DefineGlobal: {
+                uint16_t index = readShort();
+                if (globalDefined[index] && !globalBuiltin[index]) {
+                    throw std::runtime_error("Variable '" + globalNames.nameOf(index) + "' already defined in this scope.");
+                }
+                globals[index] = pop();
+                globalDefined[index] = true;
+                globalBuiltin[index] = false;
+                break;
+            }
+            case OpCode::GetGlobal: {
+                uint16_t index = readShort();
+                if (!globalDefined[index]) {
+                    throw std::runtime_error("Undefined variable '" + globalNames.nameOf(index) + "'.");
+                }
+                push(globals[index]);
+                break;
+            }
+            case OpCode::SetGlobal: {
+                uint16_t index = readShort();
+                if (!globalDefined[index]) {
+                    throw std::runtime_error("Undefined variable '" + globalNames.nameOf(index) + "' for assignment.");
+                }
+                globals[index] = stackTop[-1];
+                break;
+            }
+
+            case OpCode::Add:
+            case OpCode::AddUpdate: {
+                const char* op_name = static_cast<OpCode>(ip[-1]) == OpCode::Add ? "+" : "+=";
+                stackTop[-2] = add(op_name, stackTop[-2], stackTop[-1]);
+                --stackTop;
+                break;
+            }
+            case OpCode::Subtract:
+            case OpCode::SubtractUpdate: {
+                const char* op_name = static_cast<OpCode>(ip[-1]) == OpCode::Subtract ? "-" : "-=";
+                checkNumberOperands(op_name, stackTop[-2], stackTop[-1]);
+                stackTop[-2] = Value(stackTop[-2].asNumber() - stackTop[-1].asNumber());
+                --stackTop;
+                break;
+            }
+            case OpCode::Multiply:
+            case OpCode::MultiplyUpdate: {
+                const char* op_name = static_cast<OpCode>(ip[-1]) == OpCode::Multiply ? "*" : "*=";
+                checkNumberOperands(op_name, stackTop[-2], stackTop[-1]);
+                stackTop[-2] = Value(stackTop[-2].asNumber() * stackTop[-1].asNumber());
+                --stackTop;
+                break;
+            }
+            case OpCode::Divide: {
+                checkNumberOperands("/", stackTop[-2], stackTop[-1]);
+                double right = stackTop[-1].asNumber();
+                if (right == 0) throw std::runtime_error("Division by zero.");
+                stackTop[-2] = Value(stackTop[-2].asNumber() / right);
+                --stackTop;
+                break;
+            }
+            case OpCode::DivideUpdate: {
+                checkNumberOperands("/=", stackTop[-2], stackTop[-1]);
+                double right = stackTop[-1].asNumber();
+                if (right == 0) throw std::runtime_error("Division by zero in assignment update.");
+                stackTop[-2] = Value(stackTop[-2].asNumber() / right);
+                --stackTop;
+                break;
+            }
+            case OpCode::Modulo: {
+                checkNumberOperands("%", stackTop[-2], stackTop[-1]);
+                double left = stackTop[-2].asNumber();
+                double right = stackTop[-1].asNumber();
+                if (right == 0) throw std::runtime_error("Modulo by zero.");
+                if (static_cast<long long>(left) != left || static_cast<long long>(right) != right) {
+                    throw std::runtime_error("Modulo operands must be integers.");
+                }
+                stackTop[-2] = Value(static_cast<double>(static_cast<long long>(left) % static_cast<long long>(right)));
+                --stackTop;
+                break;
+            }
+
+            case OpCode::Equal:
+                stackTop[-2] = Value(stackTop[-2] == stackTop[-1]);
+                --stackTop;
+                break;
+            case OpCode::NotEqual:
+                stackTop[-2] = Value(stackTop[-2] != stackTop[-1]);
+                --stackTop;
+                break;
+            case OpCode::Greater:
+                checkNumberOperands(">", stackTop[-2], stackTop[-1]);
+                stackTop[-2] = Value(stackTop[-2].asNumber() > stackTop[-1].asNumber());
+                --stackTop;
+                break;
+            case OpCode::GreaterEqual:
+                checkNumberOperands(">=", stackTop[-2], stackTop[-1]);
+                stackTop[-2] = Value(stackTop[-2].asNumber() >= stackTop[-1].asNumber());
+                --stackTop;
+                break;
+            case OpCode::Less:
+                checkNumberOperands("<", stackTop[-2], stackTop[-1]);
+                stackTop[-2] = Value(stackTop[-2].asNumber() < stackTop[-1].asNumber());
+                --stackTop;
+                break;
+            case OpCode::LessEqual:
+                checkNumberOperands("<=", stackTop[-2], stackTop[-1]);
+                stackTop[-2] = Value(stackTop[-2].asNumber() <= stackTop[-1].asNumber());
+                --stackTop;
+                break;
+
+            case OpCode::Truthy:
+                stackTop[-1] = Value(isTruthy(stackTop[-1]));
+                break;
+            case OpCode::Negate:
+                checkNumberOperand("-", stackTop[-1]);
+                stackTop[-1] = Value(-stackTop[-1].asNumber());
+                break;
+            case OpCode::Not:
+                stackTop[-1] = Value(!isTruthy(stackTop[-1]));
+                break;
+
+            case OpCode::Increment:
+                checkNumberOperand("++", stackTop[-1]);
+                stackTop[-1] = Value(stackTop[-1].asNumber() + 1);
+                break;
+            case OpCode::Decrement:
+                checkNumberOperand("--", stackTop[-1]);
+                stackTop[-1] = Value(stackTop[-1].asNumber() - 1);
+                break;
+
+            case OpCode::Array: {
+                uint16_t count = readShort();
+                std::vector<Value> elements(std::make_move_iterator(stackTop - count), std::make_move_iterator(stackTop));
+                stackTop -= count;
+                push(Value(std::move(elements)));
+                break;
+            }
+            case OpCode::ArrayConstant:
+                push(Value::copyArray(frame->closure->function->chunk.constants[readShort()]));
+                break;
+            case OpCode::Index: {
+                size_t index = checkArrayIndex(stackTop[-2], stackTop[-1]);
+                Value element = stackTop[-2].isFloat64Array() ? Value(stackTop[-2].asFloat64Array()[index])
+                                                               : stackTop[-2].asArray()[index];
+                stackTop[-2] = std::move(element);
+                --stackTop;
+                break;
+            }
+            case OpCode::SetIndex: {
+                size_t index = checkArrayIndex(stackTop[-3], stackTop[-2]);
+                if (stackTop[-3].isFloat64Array()) {
+                    if (!stackTop[-1].isNumber()) throw std::runtime_error("Float64Array elements must be numbers.");
+                    stackTop[-3].asFloat64ArrayMutable()[index] = stackTop[-1].asNumber();
+                } else {
+                    stackTop[-3].asArrayMutable()[index] = stackTop[-1];
+                }
+                stackTop[-3] = std::move(stackTop[-1]);
+                stackTop -= 2;
+                break;
+            }
+            case OpCode::Print:
+                host.output() << pop().toString() << std::endl;
+                break;
+
+            case OpCode::Jump: {
+                uint16_t offset = readShort();
+                ip += offset;
+                break;
+            }
+            case OpCode::JumpIfFalse: {
+                uint16_t offset = readShort();
+                if (!isTruthy(stackTop[-1])) ip += offset;
+                --stackTop;
+                break;
+            }
+            case OpCode::Loop: {
+                uint16_t offset = readShort();
+                ip -= offset;
+                break;
+            }
+
+            case OpCode::Call: {
+                int argCount = readByte();
+                frame->ip = ip;
+                callValue(argCount);
+                frame = &frames.back();
+                ip = frame->ip;
+                break;
+            }
+            case OpCode::Closure: {
+                const auto& function = frame->closure->function->chunk.functions[readShort()];
+                auto closure = std::make_shared<VMClosure>(function, *this);
+                closure->upvalues.reserve(function->upvalueCount);
+                for (int i = 0; i < function->upvalueCount; ++i) {
+                    uint8_t isLocal = readByte();
+                    uint8_t index = readByte();
+                    if (isLocal) {
+                        closure->upvalues.push_back(captureUpvalue(frame->slots + index));
+                    } else {
+                        closure->upvalues.push_back(frame->closure->upvalues[index]);
+                    }
+                }
+                push(Value(std::static_pointer_cast<Callable>(closure)));
+                break;
+            }
+            case OpCode::CloseUpvalue:
+                closeUpvalues(stackTop - 1);
+                --stackTop;
+                break;
+            case OpCode::Return: {
+                Value result = pop();
+                closeUpvalues(frame->slots);
+                stackTop = frame->slots;
+                frames.pop_back();
+                push(std::move(result));
+                if (frames.size() == baseFrame) {
+                    return;
+                }
+                frame = &frames.back();
+                ip = frame->ip;
+                break;
+            }
+            }
+        }
+    } catch (...) {
+        frame->ip = ip;
+        throw;
+    }
+}
@@ -1,43 +1,231 @@
 #include "../hpp/Value.hpp"     
 #include "../hpp/Callable.hpp"  
+#include <mutex>
 
-Value::Value() : data(std::monostate{}) {}
-Value::Value(double v) : data(v) {}
-Value::Value(bool v) : data(v) {}
-Value::Value(const std::string& v) : data(v) {}
-Value::Value(std::vector<Value> v) : data(std::move(v)) {} 
-Value::Value(std::shared_ptr<Callable> callable) : data(callable) {}
+std::atomic<int> Obj::concurrent{0};
+thread_local uint32_t Obj::currentOwner = 0;
 
-bool Value::isNumber() const { return std::holds_alternative<double>(data); }
-bool Value::isBool() const { return std::holds_alternative<bool>(data); }
-bool Value::isString() const { return std::holds_alternative<std::string>(data); }
-bool Value::isNull() const { return std::holds_alternative<std::monostate>(data); }
-bool Value::isArray() const { return std::holds_alternative<std::vector<Value>>(data); } 
-bool Value::isCallable() const { return std::holds_alternative<std::shared_ptr<Callable>>(data); } 
+static thread_local InternTable* currentTable = nullptr;
 
-double Value::asNumber() const {
-    if (!isNumber()) throw std::runtime_error("Value is not a number.");
-    return std::get<double>(data);
+// Taken only while Obj::concurrent is set: intern tables and rope flattening are the two
+// places where threads may write to state they did not create.
+static std::mutex internMutex;
+static std::mutex flattenMutex;
+
+static std::unique_lock<std::mutex> lockIfConcurrent(std::mutex& mutex) {
+    if (Obj::concurrent.load(std::memory_order_relaxed) != 0) return std::unique_lock<std::mutex>(mutex);
+    return std::unique_lock<std::mutex>();
+}
+
+static void ensureFlat(const StringObj* string) {
+    if (string->isFlat()) return;
+    std::unique_lock<std::mutex> lock = lockIfConcurrent(flattenMutex);
+    if (!string->isFlat()) string->flatten();
+}
+
+Value::Value() : bits(NULL_BITS) {}
+Value::Value(double v) { std::memcpy(&bits, &v, sizeof(v)); }
+Value::Value(bool v) : bits(v ? TRUE_BITS : FALSE_BITS) {}
+Value::Value(std::string v) : Value(static_cast<Obj*>(new StringObj(std::move(v)))) {}
+Value::Value(std::vector<Value> v) : Value(static_cast<Obj*>(new ArrayObj(std::move(v)))) {} 
+Value::Value(std::shared_ptr<Callable> callable) : Value(static_cast<Obj*>(new CallableObj(std::move(callable)))) {} 
+
+static const char* const SHARED_WRITE_ERROR =
+    "A parallel_map or parallel_for function cannot modify an array it did not create.";
+
+// Below this length a concatenation is copied flat; a rope node would cost more than it saves.
+static constexpr size_t ROPE_MIN_LENGTH = 256;
+
+// Frees a string whose count just reached zero. Rope children are released with an explicit
+// worklist, since a string built by a long append loop is a very deep left-leaning tree.
+static void destroyString(StringObj* string) {
+    std::vector<StringObj*> pending{ string };
+    while (!pending.empty()) {
+        StringObj* current = pending.back();
+        pending.pop_back();
+        if (current->table) {
+            current->table->erase(current);
+        }
+        if (!current->isFlat()) {
+            if (current->left->release()) pending.push_back(current->left);
+            if (current->right->release()) pending.push_back(current->right);
+        }
+        delete current;
+    }
+}
+
+void StringObj::flatten() const {
+    std::string result;
+    result.reserve(length);
+    std::vector<const StringObj*> pending{ this };
+    while (!pending.empty()) {
+        const StringObj* current = pending.back();
+        pending.pop_back();
+        if (current->isFlat()) {
+            result += current->value;
+        } else {
+            pending.push_back(current->right);
+            pending.push_back(current->left);
+        }
+    }
+    value = std::move(result);
+    hash = hashString(value);
+
+    StringObj* oldLeft = left;
+    StringObj* oldRight = right;
+    right = nullptr;
+    __atomic_store_n(&left, nullptr, __ATOMIC_RELEASE);
+    if (oldLeft->release()) destroyString(oldLeft);
+    if (oldRight->release()) destroyString(oldRight);
+}
+
+Value Value::concat(const Value& left, const Value& right) {
+    Value leftString = left.isString() ? left : Value(left.toString());
+    Value rightString = right.isString() ? right : Value(right.toString());
+    StringObj* leftObj = static_cast<StringObj*>(leftString.asObj());
+    StringObj* rightObj = static_cast<StringObj*>(rightString.asObj());
+
+    if (leftObj->length + rightObj->length < ROPE_MIN_LENGTH) {
+        return Value(leftString.asString() + rightString.asString());
+    }
+    leftObj->retain();
+    rightObj->retain();
+    return Value(static_cast<Obj*>(new StringObj(leftObj, rightObj)));
+}
+
+Value Value::intern(const std::string& v) {
+    return InternTable::current().intern(v);
+}
+
+InternTable::~InternTable() {
+    for (const auto& entry : entries) {
+        if (entry.second->immortal) {
+            delete entry.second;
+        } else {
+            entry.second->table = nullptr;
+        }
+    }
+}
+
+Value InternTable::intern(const std::string& text) {
+    std::unique_lock<std::mutex> lock = lockIfConcurrent(internMutex);
+    auto it = entries.find(text);
+    if (it != entries.end()) {
+        it->second->retain();
+        return Value(static_cast<Obj*>(it->second));
+    }
+    StringObj* string = new StringObj(text);
+    string->table = this;
+    entries.emplace(string->value, string);
+    return Value(static_cast<Obj*>(string));
+}
+
+void InternTable::erase(const StringObj* string) {
+    std::unique_lock<std::mutex> lock = lockIfConcurrent(internMutex);
+    entries.erase(string->value);
+}
+
+void InternTable::freeze() {
+    for (const auto& entry : entries) {
+        entry.second->immortal = true;
+    }
 }
-bool Value::asBool() const {
-    if (!isBool()) throw std::runtime_error("Value is not a boolean.");
-    return std::get<bool>(data);
+
+InternTable& InternTable::current() {
+    static InternTable defaultTable;
+    return currentTable ? *currentTable : defaultTable;
+}
+
+InternTable* InternTable::makeCurrent(InternTable* table) {
+    InternTable* previous = currentTable;
+    currentTable = table;
+    return previous;
 }
+
+void Value::releaseObj(uint64_t bits) {
+    Obj* obj = reinterpret_cast<Obj*>(static_cast<uintptr_t>(bits & ~(SIGN_BIT | QNAN)));
+    if (!obj->release()) {
+        return;
+    }
+    switch (obj->type) {
+        case ObjType::String: destroyString(static_cast<StringObj*>(obj)); break;
+        case ObjType::Array: delete static_cast<ArrayObj*>(obj); break;
+        case ObjType::Float64Array: delete static_cast<Float64ArrayObj*>(obj); break;
+        case ObjType::Callable: delete static_cast<CallableObj*>(obj); break;
+    }
+}
+
+void Value::typeError(const char* message) {
+    throw std::runtime_error(message);
+}
+
 const std::string& Value::asString() const {
-    if (!isString()) throw std::runtime_error("Value is not a string.");
-    return std::get<std::string>(data);
+    if (!isString()) typeError("Value is not a string.");
+    const StringObj* string = static_cast<StringObj*>(asObj());
+    ensureFlat(string);
+    return string->value;
+}
+
+const StringObj* Value::asStringObj() const {
+    if (!isString()) typeError("Value is not a string.");
+    return static_cast<const StringObj*>(asObj());
+}
+Value Value::copyArray(const Value& array) {
+    if (!array.isArray()) typeError("Value is not an array.");
+    const ArrayObj* source = static_cast<ArrayObj*>(array.asObj());
+    if (source->isSlice) {
+        return Value(static_cast<Obj*>(new ArrayObj(source->buffer, source->offset, source->length)));
+    }
+    return Value(static_cast<Obj*>(new ArrayObj(source->buffer)));
+}
+Value Value::sliceArray(const Value& array, size_t begin, size_t end) {
+    if (!array.isArray()) typeError("Value is not an array.");
+    const ArrayObj* source = static_cast<ArrayObj*>(array.asObj());
+    size_t base = source->isSlice ? source->offset : 0;
+    return Value(static_cast<Obj*>(new ArrayObj(source->buffer, base + begin, end - begin)));
 }
-const std::vector<Value>& Value::asArray() const {
-    if (!isArray()) throw std::runtime_error("Value is not an array.");
-    return std::get<std::vector<Value>>(data);
+
+ArrayView Value::asArray() const {
+    if (!isArray()) typeError("Value is not an array.");
+    const ArrayObj* array = static_cast<ArrayObj*>(asObj());
+    if (array->isSlice) return ArrayView(array->buffer->data() + array->offset, array->length);
+    return ArrayView(array->buffer->data(), array->buffer->size());
 }
 std::vector<Value>& Value::asArrayMutable() {
-    if (!isArray()) throw std::runtime_error("Value is not an array.");
-    return std::get<std::vector<Value>>(data);
+    if (!isArray()) typeError("Value is not an array.");
+    ArrayObj* array = static_cast<ArrayObj*>(asObj());
+    if (!array->writable()) typeError(SHARED_WRITE_ERROR);
+    if (array->isSlice) {
+        auto first = array->buffer->begin() + array->offset;
+        array->buffer = std::make_shared<std::vector<Value>>(first, first + array->length);
+        array->isSlice = false;
+        array->offset = array->length = 0;
+    } else if (array->buffer.use_count() > 1) {
+        array->buffer = std::make_shared<std::vector<Value>>(*array->buffer);
+    }
+    return *array->buffer;
+}
+Value Value::float64Array(std::vector<double> elements) {
+    return Value(static_cast<Obj*>(new Float64ArrayObj(std::move(elements))));
+}
+
+const std::vector<double>& Value::asFloat64Array() const {
+    if (!isFloat64Array()) typeError("Value is not a Float64Array.");
+    return static_cast<Float64ArrayObj*>(asObj())->elements;
+}
+std::vector<double>& Value::asFloat64ArrayMutable() {
+    if (!isFloat64Array()) typeError("Value is not a Float64Array.");
+    Float64ArrayObj* array = static_cast<Float64ArrayObj*>(asObj());
+    if (!array->writable()) typeError(SHARED_WRITE_ERROR);
+    return array->elements;
+}
+size_t Value::stringLength() const {
+    if (!isString()) typeError("Value is not a string.");
+    return static_cast<StringObj*>(asObj())->length;
 }
 std::shared_ptr<Callable> Value::asCallable() const {
-    if (!isCallable()) throw std::runtime_error("Value is not a callable function.");
-    return std::get<std::shared_ptr<Callable>>(data);
+    if (!isCallable()) typeError("Value is not a callable function.");
+    return static_cast<CallableObj*>(asObj())->callable;
 }
 
 std::string Value::toString() const {
@@ -46,6 +234,12 @@ std::string Value::toString() const {
     if (isString()) return asString(); 
     if (isNull()) return "null";
     if (isArray()) {
+        // An array can hold a reference to itself; print the inner occurrence as [...].
+        thread_local std::vector<const Obj*> printing;
+        for (const Obj* obj : printing) {
+            if (obj == asObj()) return "[...]";
+        }
+        printing.push_back(asObj());
         std::string result = "[";
         const auto& arr = asArray();
         for (size_t i = 0; i < arr.size(); ++i) {
@@ -55,14 +249,38 @@ std::string Value::toString() const {
             }
         }
         result += "]";
+        printing.pop_back();
         return result;
     }
+    if (isFloat64Array()) {
+        std::string result = "Float64Array[";
+        const auto& elements = asFloat64Array();
+        for (size_t i = 0; i < elements.size(); ++i) {
+            if (i > 0) result += ", ";
+            result += std::to_string(elements[i]);
+        }
+        return result + "]";
+    }
     if (isCallable()) return asCallable()->toString(); 
     return "<unknown type>"; 
 }
 
 bool Value::operator==(const Value& other) const {
-    return data == other.data; 
+    if (isNumber() && other.isNumber()) return asNumber() == other.asNumber();
+    if (isString() && other.isString()) {
+        if (bits == other.bits) return true;
+        const StringObj* left = static_cast<StringObj*>(asObj());
+        const StringObj* right = static_cast<StringObj*>(other.asObj());
+        if ((left->table && left->table == right->table) || left->length != right->length) return false;
+        ensureFlat(left);
+        ensureFlat(right);
+        if (left->hash != right->hash) return false;
+        return left->value == right->value;
+    }
+    if (isArray() && other.isArray()) return asArray() == other.asArray();
+    if (isFloat64Array() && other.isFloat64Array()) return asFloat64Array() == other.asFloat64Array();
+    if (isCallable() && other.isCallable()) return asCallable() == other.asCallable();
+    return !isNumber() && bits == other.bits; 
 }
 bool Value::operator!=(const Value& other) const {
     return !(*this == other);
@@ -12,11 +12,125 @@
 #include "../hpp/Environment.hpp" 
 #include "../hpp/Visitor.hpp"     
 #include "../hpp/Callable.hpp"    
-#include "../hpp/Return.hpp"      
 #include "../hpp/Interpreter.hpp" 
+#include "../hpp/Isolate.hpp"
+#include "../hpp/Resolver.hpp"
+#include "../hpp/Optimizer.hpp"
+#include "../hpp/VM.hpp"
+#include "../hpp/Jit.hpp"
+#include "../hpp/Transpiler.hpp"
+#include "../hpp/Trace.hpp"
+#include "../hpp/ThreadPool.hpp"
+#include "../hpp/ProgramCache.hpp"
 
-int main() {
+static const char* USAGE = "Usage: MyLang [--vm] [--no-optimize] [--no-jit] [--no-cache] [--lazy-functions] [--stream] [--emit-cpp=<file>] [--threads=<n>] [--trace=<lexer,parser,optimizer,interpreter,environment,jit|all>] "
+                           "[--trace-level=<info|debug|verbose>] [--trace-buffer=<lines>]";
+
+// Runs each top-level statement as soon as it is parsed (--stream). Returns the exit code.
+static int runStreamed(std::string_view source, Program& program, Interpreter& interpreter,
+                       bool optimize, bool lazyFunctions) {
+    Parser parser(TokenStream(source), program, lazyFunctions);
+    Optimizer optimizer(program);
+    Resolver resolver;
+    while (true) {
+        Statement* statement = nullptr;
+        try {
+            statement = parser.parseNext();
+            if (!statement) {
+                return 0;
+            }
+            if (optimize) {
+                statement = optimizer.optimizeStatement(statement);
+            }
+        }
+        catch (const std::runtime_error& e) {
+            std::cerr << "Parsing Error: " << e.what() << std::endl;
+            Trace::dumpRingBuffer(std::cerr);
+            return 1;
+        }
+        if (!statement) {
+            continue;
+        }
+
+        StatementList single(&statement, 1);
+        try {
+            resolver.resolve(single);
+        }
+        catch (const std::runtime_error& e) {
+            std::cerr << "Resolution Error: " << e.what() << std::endl;
+            Trace::dumpRingBuffer(std::cerr);
+            return 1;
+        }
+        try {
+            interpreter.run(single);
+        }
+        catch (const std::runtime_error& e) {
+            // Stops the program like Interpreter::interpret() does.
+            std::cerr << "Runtime Error: " << e.what() << std::endl;
+            Trace::dumpRingBuffer(std::cerr);
+            return 0;
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
     std::string filename = "code.lang";
+    bool useVM = false;
+    bool optimize = true;
+    bool useJit = true;
+    bool useCache = true;
+    bool lazyFunctions = false;
+    bool streamed = false;
+    std::string emitPath;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool valid = true;
+        if (arg == "--vm") {
+            useVM = true;
+        } else if (arg == "--no-optimize") {
+            optimize = false;
+        } else if (arg == "--no-jit") {
+            useJit = false;
+        } else if (arg == "--no-cache") {
+            useCache = false;
+        } else if (arg == "--lazy-functions") {
+            lazyFunctions = true;
+        } else if (arg == "--stream") {
+            streamed = true;
+        } else if (arg.rfind("--emit-cpp=", 0) == 0) {
+            emitPath = arg.substr(11);
+            valid = !emitPath.empty();
+        } else if (arg.rfind("--threads=", 0) == 0) {
+            std::string threads = arg.substr(10);
+            valid = !threads.empty() && threads.find_first_not_of("0123456789") == std::string::npos &&
+                    std::stoul(threads) > 0;
+            if (valid) {
+                ThreadPool::setThreadCount(std::stoul(threads));
+            }
+        } else if (arg.rfind("--trace=", 0) == 0) {
+            valid = Trace::enableCategories(arg.substr(8));
+        } else if (arg.rfind("--trace-level=", 0) == 0) {
+            valid = Trace::setLevel(arg.substr(14));
+        } else if (arg.rfind("--trace-buffer=", 0) == 0) {
+            std::string lines = arg.substr(15);
+            valid = !lines.empty() && lines.find_first_not_of("0123456789") == std::string::npos;
+            if (valid) {
+                Trace::useRingBuffer(std::stoul(lines));
+            }
+        } else {
+            valid = false;
+        }
+        if (!valid) {
+            std::cerr << "Unknown option '" << arg << "'. " << USAGE << std::endl;
+            return 1;
+        }
+    }
+
+    if (streamed && (useVM || !emitPath.empty())) {
+        std::cerr << "--stream runs on the tree-walking interpreter; it cannot be combined with --vm or --emit-cpp." << std::endl;
+        return 1;
+    }
 
     std::ifstream file(filename);
 
@@ -25,56 +139,121 @@ int main() {
         return 1; 
     }
 
-    std::string line;
-    std::vector<Token> all_tokens;
-    int current_line_number = 0;
+    // Read in one go; tokens and the AST view this buffer, so it lives until the end of main.
+    std::string source;
+    file.seekg(0, std::ios::end);
+    source.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0, std::ios::beg);
+    file.read(&source[0], static_cast<std::streamsize>(source.size()));
+    file.close(); 
+
+    // Owns every AST node; functions created at runtime point into it, so it outlives the interpreters.
+    Program program;
+    const StatementList& statements = program.statements;
+    Isolate isolate;
+    Isolate::Scope isolateScope(isolate);
+
+    if (streamed) {
+        Interpreter& interpreter = isolate.interpreter();
+        if (useJit && Jit::isSupported()) {
+            interpreter.enableJit();
+        }
+        std::cout << "\n--- Starting Interpretation ---" << std::endl;
+        int status = runStreamed(source, program, interpreter, optimize, lazyFunctions);
+        if (status != 0) {
+            return status;
+        }
+        std::cout << "--- Interpretation Finished Successfully ---" << std::endl;
+        std::cout << "\n--- Program Finished ---" << std::endl;
+        return 0;
+    }
+
+    ProgramCache cache(filename);
+    ProgramCache::Settings cacheSettings{ optimize, lazyFunctions };
+    if (useCache && cache.load(source, cacheSettings, program)) {
+        std::cout << "--- Loaded " << cache.path() << ". Statements: " << statements.size() << " ---" << std::endl;
+    } else {
+        std::vector<Token> all_tokens;
 
-    std::cout << "--- Starting Lexing ---" << std::endl;
-    while (std::getline(file, line)) {
-        current_line_number++;
+        std::cout << "--- Starting Lexing ---" << std::endl;
         try {
-            std::vector<Token> line_tokens = tokenizeLine(line, current_line_number);
-            for (const auto& token : line_tokens) {
-                all_tokens.push_back(token);
-            }
+            all_tokens = tokenizeParallel(source);
         }
         catch (const std::runtime_error& e) {
-            std::cerr << "Lexing Error on line " << current_line_number << ": " << e.what() << std::endl;
+            std::cerr << "Lexing Error: " << e.what() << std::endl;
+            Trace::dumpRingBuffer(std::cerr);
             return 1; 
         }
-    }
-    file.close(); 
 
-    all_tokens.emplace_back(TokenType::EndOfFile, "", current_line_number + 1);
-    std::cout << "--- Lexing Finished. Total Tokens: " << all_tokens.size() << " ---" << std::endl;
+        std::cout << "--- Lexing Finished. Total Tokens: " << all_tokens.size() << " ---" << std::endl;
 
-    std::cout << "\n--- Starting Parsing ---" << std::endl;
-    std::vector<std::unique_ptr<Statement>> statements; 
-    try {
-        Parser parser(all_tokens);
-        statements = parser.parse();
+        std::cout << "\n--- Starting Parsing ---" << std::endl;
+        try {
+            Parser parser(all_tokens, lazyFunctions);
+            program = parser.parse();
+            if (optimize) {
+                Optimizer(program).optimize();
+            }
+        }
+        catch (const std::runtime_error& e) {
+            std::cerr << "Parsing Error: " << e.what() << std::endl;
+            Trace::dumpRingBuffer(std::cerr);
+            return 1; 
+        }
 
         std::cout << "--- Parsing Finished. Statements Parsed: " << statements.size() << " ---" << std::endl;
-        std::cout << "\n--- Generated AST ---" << std::endl;
+        if (useCache) {
+            cache.store(source, cacheSettings, program);
+        }
 
+        // Not on a cache hit, where printing the whole tree would cost more than the load saved.
+        std::cout << "\n--- Generated AST ---" << std::endl;
         for (const auto& stmt : statements) {
             stmt->print(); 
         }
     }
-    catch (const std::runtime_error& e) {
-        std::cerr << "Parsing Error: " << e.what() << std::endl;
-        return 1; 
+
+    if (!useVM || !emitPath.empty()) {
+        try {
+            Resolver resolver;
+            resolver.resolve(statements);
+        }
+        catch (const std::runtime_error& e) {
+            std::cerr << "Resolution Error: " << e.what() << std::endl;
+            Trace::dumpRingBuffer(std::cerr);
+            return 1;
+        }
+    }
+
+    if (!emitPath.empty()) {
+        std::ofstream out(emitPath);
+        out << Transpiler(filename).translate(statements);
+        if (!out) {
+            std::cerr << "Error: Could not write '" << emitPath << "'." << std::endl;
+            return 1;
+        }
+        std::cout << "\n--- Wrote C++ translation to " << emitPath << " ---" << std::endl;
+        return 0;
     }
 
     std::cout << "\n--- Starting Interpretation ---" << std::endl;
     try {
-        Interpreter interpreter;
-        interpreter.interpret(statements);
+        if (useVM) {
+            VM vm(isolate.interpreter());
+            vm.interpret(statements);
+        } else {
+            Interpreter& interpreter = isolate.interpreter();
+            if (useJit && Jit::isSupported()) {
+                interpreter.enableJit();
+            }
+            interpreter.interpret(statements);
+        }
 
         std::cout << "--- Interpretation Finished Successfully ---" << std::endl;
     }
     catch (const std::runtime_error& e) {
         std::cerr << "Interpretation (Runtime) Error: " << e.what() << std::endl;
+        Trace::dumpRingBuffer(std::cerr);
         return 1; 
     }
 
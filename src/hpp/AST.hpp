@@ -1,27 +1,131 @@
 ﻿#pragma once
 #include <string>
 #include <vector>
-#include <memory>
 #include <iostream>
+#include <cstdint>
+#include <atomic>
+#include <string_view>
 #include "./Token.hpp"   
+#include "./Value.hpp"   
+#include "./Arena.hpp"   
 
 class Visitor; 
 class Value; 
 
+// Filled in by the Resolver: how many scopes out a variable lives and its slot there.
+// A depth of -1 means the name was not found in any local scope and is looked up as a global.
+struct VariableSlot {
+    int depth = -1;
+    int slot = -1;
+};
+
+// The slot the Resolver gives a let or function declaration whose scope already declares the
+// name. Running the declaration then reports the redefinition, as it does for globals.
+constexpr int REDECLARED_SLOT = -2;
+
+// Profiling state the interpreter keeps on a node while it runs (type feedback, JIT counters).
+// Runs of one shared Script (see Script.hpp) may update it from several threads at once. It is
+// only ever a hint, so relaxed loads and stores are enough and a lost update does no harm.
+template <typename T>
+class Feedback {
+public:
+    Feedback(T value = T()) : value(value) {}
+    operator T() const { return value.load(std::memory_order_relaxed); }
+    Feedback& operator=(T next) {
+        value.store(next, std::memory_order_relaxed);
+        return *this;
+    }
+    T operator++() {
+        T next = static_cast<T>(*this + 1);
+        *this = next;
+        return next;
+    }
+
+private:
+    std::atomic<T> value;
+};
+
+enum class BinaryOp : uint8_t {
+    Assign,
+    Or,
+    And,
+    Equal,
+    NotEqual,
+    Greater,
+    GreaterEqual,
+    Less,
+    LessEqual,
+    Add,
+    Subtract,
+    Multiply,
+    Divide,
+    Modulo
+};
+
+enum class UnaryOp : uint8_t {
+    Negate,
+    Not
+};
+
+enum class UpdateOp : uint8_t {
+    Increment,
+    Decrement
+};
+
+inline const char* binaryOpLexeme(BinaryOp op) {
+    switch (op) {
+        case BinaryOp::Assign: return "=";
+        case BinaryOp::Or: return "||";
+        case BinaryOp::And: return "&&";
+        case BinaryOp::Equal: return "==";
+        case BinaryOp::NotEqual: return "!=";
+        case BinaryOp::Greater: return ">";
+        case BinaryOp::GreaterEqual: return ">=";
+        case BinaryOp::Less: return "<";
+        case BinaryOp::LessEqual: return "<=";
+        case BinaryOp::Add: return "+";
+        case BinaryOp::Subtract: return "-";
+        case BinaryOp::Multiply: return "*";
+        case BinaryOp::Divide: return "/";
+        case BinaryOp::Modulo: return "%";
+    }
+    return "?";
+}
+
+// Spelling of a compound assignment (`+=`) whose arithmetic is `op`.
+inline const char* compoundAssignLexeme(BinaryOp op) {
+    switch (op) {
+        case BinaryOp::Add: return "+=";
+        case BinaryOp::Subtract: return "-=";
+        case BinaryOp::Multiply: return "*=";
+        case BinaryOp::Divide: return "/=";
+        default: return "?=";
+    }
+}
+
+inline const char* unaryOpLexeme(UnaryOp op) {
+    return op == UnaryOp::Negate ? "-" : "!";
+}
+
+inline const char* updateOpLexeme(UpdateOp op) {
+    return op == UpdateOp::Increment ? "++" : "--";
+}
+
 inline void printIndent(int indent) {
     for (int i = 0; i < indent; ++i) std::cout << "  ";
 }
 
+// Nodes live in an AstArena and are never deleted through a base pointer, so the
+// hierarchy has no virtual destructor.
 class Expression {
 public:
-    virtual ~Expression() = default; 
     virtual void print(int indent = 0) const = 0; 
     virtual Value accept(Visitor& visitor) const = 0; 
 };
 
 class Statement {
 public:
-    virtual ~Statement() = default; 
+    int line = 0; 
     virtual void print(int indent = 0) const = 0; 
     virtual Value accept(Visitor& visitor) const = 0; 
 };
@@ -37,9 +141,9 @@ public:
 
 class StringExpr : public Expression {
 public:
-    std::string value;
-    StringExpr(const std::string& v) : value(v) {}
-    void print(int indent = 0) const override { printIndent(indent); std::cout << "StringExpr: \"" << value << "\"\n"; }
+    Value constant; // interned once at parse time and shared by every evaluation
+    StringExpr(const std::string& v) : constant(Value::intern(v)) {}
+    void print(int indent = 0) const override { printIndent(indent); std::cout << "StringExpr: \"" << constant.asString() << "\"\n"; }
     Value accept(Visitor& visitor) const override;
 };
 
@@ -53,17 +157,20 @@ public:
 
 class VariableExpr : public Expression {
 public:
-    std::string name; 
-    VariableExpr(const std::string& v) : name(v) {}
+    Symbol name; 
+    mutable VariableSlot resolved; 
+    VariableExpr(Symbol v) : name(v) {}
     void print(int indent = 0) const override { printIndent(indent); std::cout << "VariableExpr: " << name << "\n"; }
     Value accept(Visitor& visitor) const override;
 };
 
 class ArrayExpr : public Expression {
 public:
-    std::vector<std::unique_ptr<Expression>> elements; 
-    ArrayExpr(std::vector<std::unique_ptr<Expression>> elems)
-        : elements(std::move(elems)) {}
+    NodeList<Expression*> elements; 
+    // Set by the Optimizer when every element is a scalar literal. Each evaluation then
+    // returns a new array sharing this one's buffer instead of rebuilding it.
+    Value constant;
+    ArrayExpr(NodeList<Expression*> elems) : elements(elems) {}
     void print(int indent = 0) const override {
         printIndent(indent); std::cout << "ArrayExpr\n";
         for (const auto& element : elements) { element->print(indent + 1); }
@@ -73,10 +180,9 @@ public:
 
 class IndexExpr : public Expression {
 public:
-    std::unique_ptr<Expression> array; 
-    std::unique_ptr<Expression> index; 
-    IndexExpr(std::unique_ptr<Expression> arr, std::unique_ptr<Expression> idx)
-        : array(std::move(arr)), index(std::move(idx)) {}
+    Expression* array; 
+    Expression* index; 
+    IndexExpr(Expression* arr, Expression* idx) : array(arr), index(idx) {}
     void print(int indent = 0) const override {
         printIndent(indent); std::cout << "IndexAccessExpr\n";
         printIndent(indent + 1); std::cout << "Array:\n"; array->print(indent + 2);
@@ -85,15 +191,43 @@ public:
     Value accept(Visitor& visitor) const override;
 };
 
+class IndexAssignmentExpr : public Expression {
+public:
+    Expression* array; 
+    Expression* index; 
+    Expression* value; 
+    IndexAssignmentExpr(Expression* arr, Expression* idx, Expression* val) : array(arr), index(idx), value(val) {}
+    void print(int indent = 0) const override {
+        printIndent(indent); std::cout << "IndexAssignmentExpr\n";
+        printIndent(indent + 1); std::cout << "Array:\n"; array->print(indent + 2);
+        printIndent(indent + 1); std::cout << "Index:\n"; index->print(indent + 2);
+        printIndent(indent + 1); std::cout << "Value:\n"; value->print(indent + 2);
+    }
+    Value accept(Visitor& visitor) const override;
+};
+
+// Operand types a BinaryExpr has been specialized for by the tree-walking interpreter.
+enum class BinaryQuickening : uint8_t {
+    Generic,
+    Numbers,
+    Strings
+};
+
 class BinaryExpr : public Expression {
 public:
-    std::unique_ptr<Expression> left;  
-    std::unique_ptr<Expression> right; 
-    std::string op;                    
-    BinaryExpr(std::unique_ptr<Expression> l, std::unique_ptr<Expression> r, const std::string& o)
-        : left(std::move(l)), right(std::move(r)), op(o) {}
+    Expression* left;  
+    Expression* right; 
+    BinaryOp op;                    
+    // Type feedback: after a run of evaluations that all saw `observed` operands the node
+    // switches to that specialized path. A failed type guard reverts it to Generic, and
+    // after a few such reverts it stays generic for good.
+    mutable Feedback<BinaryQuickening> quickening = BinaryQuickening::Generic;
+    mutable Feedback<BinaryQuickening> observed = BinaryQuickening::Generic;
+    mutable Feedback<uint8_t> observedCount = 0;
+    mutable Feedback<uint8_t> deoptimizations = 0;
+    BinaryExpr(Expression* l, Expression* r, BinaryOp o) : left(l), right(r), op(o) {}
     void print(int indent = 0) const override {
-        printIndent(indent); std::cout << "BinaryExpr: " << op << "\n";
+        printIndent(indent); std::cout << "BinaryExpr: " << binaryOpLexeme(op) << "\n";
         left->print(indent + 1); right->print(indent + 1);
     }
     Value accept(Visitor& visitor) const override;
@@ -101,12 +235,11 @@ public:
 
 class UnaryExpr : public Expression {
 public:
-    Token op;                          
-    std::unique_ptr<Expression> right; 
-    UnaryExpr(Token op_token, std::unique_ptr<Expression> right_expr)
-        : op(std::move(op_token)), right(std::move(right_expr)) {}
+    UnaryOp op;                          
+    Expression* right; 
+    UnaryExpr(UnaryOp o, Expression* right_expr) : op(o), right(right_expr) {}
     void print(int indent = 0) const override {
-        printIndent(indent); std::cout << "UnaryExpr: " << op.getLexeme() << "\n";
+        printIndent(indent); std::cout << "UnaryExpr: " << unaryOpLexeme(op) << "\n";
         right->print(indent + 1);
     }
     Value accept(Visitor& visitor) const override;
@@ -114,11 +247,10 @@ public:
 
 class CallExpr : public Expression {
 public:
-    std::unique_ptr<Expression> callee; 
-    std::vector<std::unique_ptr<Expression>> arguments; 
+    Expression* callee; 
+    NodeList<Expression*> arguments; 
 
-    CallExpr(std::unique_ptr<Expression> calleeExpr, std::vector<std::unique_ptr<Expression>> args)
-        : callee(std::move(calleeExpr)), arguments(std::move(args)) {}
+    CallExpr(Expression* calleeExpr, NodeList<Expression*> args) : callee(calleeExpr), arguments(args) {}
     void print(int indent = 0) const override {
         printIndent(indent); std::cout << "CallExpr:\n";
         printIndent(indent + 1); std::cout << "Callee:\n"; callee->print(indent + 2);
@@ -130,14 +262,14 @@ public:
 
 class UpdateExpr : public Expression {
 public:
-    std::string name; 
-    std::string op;   
-    std::unique_ptr<Expression> right; 
+    Symbol name; 
+    UpdateOp op;   
+    Expression* right; 
+    mutable VariableSlot resolved; 
 
-    UpdateExpr(const std::string& name, const std::string& op, std::unique_ptr<Expression> right = nullptr)
-        : name(name), op(op), right(std::move(right)) {}
+    UpdateExpr(Symbol name, UpdateOp op, Expression* right = nullptr) : name(name), op(op), right(right) {}
     void print(int indent = 0) const override {
-        printIndent(indent); std::cout << "UpdateExpr: " << op << " " << name << "\n";
+        printIndent(indent); std::cout << "UpdateExpr: " << updateOpLexeme(op) << " " << name << "\n";
         if (right) right->print(indent + 1);
     }
     Value accept(Visitor& visitor) const override;
@@ -145,8 +277,8 @@ public:
 
 class GroupingExpr : public Expression {
 public:
-    std::unique_ptr<Expression> expression; 
-    GroupingExpr(std::unique_ptr<Expression> expr) : expression(std::move(expr)) {}
+    Expression* expression; 
+    GroupingExpr(Expression* expr) : expression(expr) {}
     void print(int indent = 0) const override {
         printIndent(indent); std::cout << "GroupingExpr:\n";
         expression->print(indent + 1);
@@ -154,12 +286,14 @@ public:
     Value accept(Visitor& visitor) const override;
 };
 
+using StatementList = NodeList<Statement*>;
+
 class LetStatement : public Statement {
 public:
-    std::string name;                             
-    std::unique_ptr<Expression> initializer;      
-    LetStatement(const std::string& variableName, std::unique_ptr<Expression> initExpr)
-        : name(variableName), initializer(std::move(initExpr)) {}
+    Symbol name;                             
+    Expression* initializer;      
+    mutable int slot = -1; 
+    LetStatement(Symbol variableName, Expression* initExpr) : name(variableName), initializer(initExpr) {}
     void print(int indent = 0) const override {
         printIndent(indent); std::cout << "LetStatement: " << name << "\n";
         if (initializer) { initializer->print(indent + 1); }
@@ -169,8 +303,8 @@ public:
 
 class PrintStatement : public Statement {
 public:
-    std::unique_ptr<Expression> expression; 
-    PrintStatement(std::unique_ptr<Expression> expr) : expression(std::move(expr)) {}
+    Expression* expression; 
+    PrintStatement(Expression* expr) : expression(expr) {}
     void print(int indent = 0) const override {
         printIndent(indent); std::cout << "PrintStatement:\n";
         expression->print(indent + 1);
@@ -180,8 +314,8 @@ public:
 
 class ExpressionStatement : public Statement {
 public:
-    std::unique_ptr<Expression> expression; 
-    ExpressionStatement(std::unique_ptr<Expression> expr) : expression(std::move(expr)) {}
+    Expression* expression; 
+    ExpressionStatement(Expression* expr) : expression(expr) {}
     void print(int indent = 0) const override {
         printIndent(indent); std::cout << "ExpressionStatement:\n";
         expression->print(indent + 1);
@@ -191,15 +325,15 @@ public:
 
 class UpdateStatement : public Statement {
 public:
-    Token nameToken; 
-    Token opToken;   
+    Symbol name; 
+    UpdateOp op;   
     bool isPrefix;   
-    UpdateStatement(Token nameToken, Token opToken, bool isPrefix)
-        : nameToken(std::move(nameToken)), opToken(std::move(opToken)), isPrefix(isPrefix) {}
+    mutable VariableSlot resolved; 
+    UpdateStatement(Symbol name, UpdateOp op, bool isPrefix) : name(name), op(op), isPrefix(isPrefix) {}
     void print(int indent = 0) const override {
         printIndent(indent); std::cout << "UpdateStatement:\n";
-        printIndent(indent + 1); std::cout << "Variable: " << nameToken.getLexeme() << "\n";
-        printIndent(indent + 1); std::cout << "Operator: " << opToken.getLexeme() << "\n";
+        printIndent(indent + 1); std::cout << "Variable: " << name << "\n";
+        printIndent(indent + 1); std::cout << "Operator: " << updateOpLexeme(op) << "\n";
         printIndent(indent + 1); std::cout << "IsPrefix: " << (isPrefix ? "true" : "false") << "\n";
     }
     Value accept(Visitor& visitor) const override;
@@ -207,15 +341,15 @@ public:
 
 class AssignmentUpdateStatement : public Statement {
 public:
-    Token variableNameToken; 
-    Token opToken;           
-    std::unique_ptr<Expression> value; 
-    AssignmentUpdateStatement(Token variableNameToken, Token opToken, std::unique_ptr<Expression> value)
-        : variableNameToken(std::move(variableNameToken)), opToken(std::move(opToken)), value(std::move(value)) {}
+    Symbol name; 
+    BinaryOp op; // Add, Subtract, Multiply or Divide
+    Expression* value; 
+    mutable VariableSlot resolved; 
+    AssignmentUpdateStatement(Symbol name, BinaryOp op, Expression* value) : name(name), op(op), value(value) {}
     void print(int indent = 0) const override {
         printIndent(indent); std::cout << "AssignmentUpdateStatement:\n";
-        printIndent(indent + 1); std::cout << "Variable: " << variableNameToken.getLexeme() << "\n";
-        printIndent(indent + 1); std::cout << "Operator: " << opToken.getLexeme() << "\n";
+        printIndent(indent + 1); std::cout << "Variable: " << name << "\n";
+        printIndent(indent + 1); std::cout << "Operator: " << compoundAssignLexeme(op) << "\n";
         printIndent(indent + 1); std::cout << "Value:\n";
         if (value) { value->print(indent + 2); }
     }
@@ -224,9 +358,9 @@ public:
 
 class BlockStatement : public Statement {
 public:
-    std::vector<std::unique_ptr<Statement>> statements; 
-    BlockStatement(std::vector<std::unique_ptr<Statement>> stmts)
-        : statements(std::move(stmts)) {}
+    StatementList statements; 
+    mutable int slotCount = 0; 
+    BlockStatement(StatementList stmts) : statements(stmts) {}
     BlockStatement() = default; 
     void print(int indent = 0) const override { 
         printIndent(indent); std::cout << "BlockStatement:\n";
@@ -237,11 +371,11 @@ public:
 
 class IfStatement : public Statement {
 public:
-    std::unique_ptr<Expression> condition;  
-    std::unique_ptr<Statement> thenBranch;  
-    std::unique_ptr<Statement> elseBranch;  
-    IfStatement(std::unique_ptr<Expression> cond, std::unique_ptr<Statement> thenStmt, std::unique_ptr<Statement> elseStmt = nullptr)
-        : condition(std::move(cond)), thenBranch(std::move(thenStmt)), elseBranch(std::move(elseStmt)) {}
+    Expression* condition;  
+    Statement* thenBranch;  
+    Statement* elseBranch;  
+    IfStatement(Expression* cond, Statement* thenStmt, Statement* elseStmt = nullptr)
+        : condition(cond), thenBranch(thenStmt), elseBranch(elseStmt) {}
     void print(int indent = 0) const override {
         printIndent(indent); std::cout << "IfStatement:\n";
         printIndent(indent + 1); std::cout << "Condition:\n"; condition->print(indent + 2);
@@ -253,9 +387,12 @@ public:
 
 class WhileStatement : public Statement {
 public:
-    std::unique_ptr<Expression> condition; 
-    std::unique_ptr<Statement> thenBranch; 
-    WhileStatement(std::unique_ptr<Expression> expr, std::unique_ptr<Statement> then) : condition(std::move(expr)), thenBranch(std::move(then)) {}
+    Expression* condition; 
+    Statement* thenBranch; 
+    // Back edges taken, counted toward JIT compilation. Parked far below zero when the loop
+    // cannot be compiled.
+    mutable Feedback<int> jitCounter = 0;
+    WhileStatement(Expression* expr, Statement* then) : condition(expr), thenBranch(then) {}
     void print(int indent = 0) const override {
         printIndent(indent); std::cout << "WhileStatement:\n";
         printIndent(indent + 1); std::cout << "Condition:\n"; condition->print(indent + 2);
@@ -264,27 +401,60 @@ public:
     Value accept(Visitor& visitor) const override;
 };
 
+struct Program;
+
+// Source of a function body the Parser skipped (see Parser::Parser), parsed on first use.
+struct DeferredBody {
+    // From '{' to the matching '}', viewing the program's source, which must outlive it.
+    std::string_view text;
+    int line;
+    // Set by the Optimizer, which then runs on the body once it is parsed.
+    bool optimize;
+    // Where the body's nodes go; re-targeted when the Program moves.
+    Program* program;
+};
+
 class FunctionStatement : public Statement {
 public:
-    std::string name;                             
-    std::vector<std::string> parameters;          
-    std::unique_ptr<BlockStatement> body;         
-    FunctionStatement(std::string name, std::vector<std::string> params, std::unique_ptr<BlockStatement> body)
-        : name(std::move(name)), parameters(std::move(params)), body(std::move(body)) {}
+    Symbol name;                             
+    NodeList<Symbol> parameters;          
+    // Null until getBody() parses it when the body was deferred.
+    mutable BlockStatement* body;         
+    DeferredBody* deferred = nullptr;
+    mutable int slot = -1; 
+    mutable int slotCount = 0; 
+    // Calls made, counted toward JIT compilation; parked like WhileStatement::jitCounter.
+    mutable Feedback<int> jitCounter = 0;
+    FunctionStatement(Symbol name, NodeList<Symbol> params, BlockStatement* body)
+        : name(name), parameters(params), body(body) {}
+
+    // The body, parsed, optimized and resolved first if it was deferred; slotCount is only
+    // meaningful after this. Throws std::runtime_error on a syntax error in a deferred body.
+    BlockStatement* getBody() const {
+        BlockStatement* parsed = __atomic_load_n(&body, __ATOMIC_ACQUIRE);
+        return parsed ? parsed : parseDeferredBody();
+    }
+    bool isParsed() const { return __atomic_load_n(&body, __ATOMIC_ACQUIRE) != nullptr; }
+
     void print(int indent = 0) const override {
         printIndent(indent); std::cout << "FunctionStatement: " << name << "\n";
         printIndent(indent + 1); std::cout << "Parameters:\n";
         for (const auto& param : parameters) { printIndent(indent + 2); std::cout << param << "\n"; }
         printIndent(indent + 1); std::cout << "Body:\n";
-        if (body) { body->print(indent + 2); } 
+        if (isParsed()) { body->print(indent + 2); } 
+        else if (deferred) { printIndent(indent + 2); std::cout << "(not parsed yet)\n"; }
     }
     Value accept(Visitor& visitor) const override;
+
+private:
+    // Defined with the Parser.
+    BlockStatement* parseDeferredBody() const;
 };
 
 class ReturnStatement : public Statement {
 public:
-    std::unique_ptr<Expression> expression; 
-    ReturnStatement(std::unique_ptr<Expression> expr) : expression(std::move(expr)) {}
+    Expression* expression; 
+    ReturnStatement(Expression* expr) : expression(expr) {}
     void print(int indent = 0) const override {
         printIndent(indent); std::cout << "ReturnStatement:\n";
         if (expression) { expression->print(indent + 1); }
@@ -292,6 +462,31 @@ public:
     Value accept(Visitor& visitor) const override;
 };
 
+// A parsed program. Every node and name it refers to is owned here, so the tree is released
+// in one step when the Program is destroyed.
+struct Program {
+    AstArena arena;
+    SymbolTable symbols;
+    StatementList statements;
+    // Bodies the Parser deferred. They point back at the Program, so a move re-targets them.
+    std::vector<DeferredBody*> deferred;
+
+    Program() = default;
+    Program(Program&& other) noexcept { *this = std::move(other); }
+    Program& operator=(Program&& other) noexcept {
+        arena = std::move(other.arena);
+        symbols = std::move(other.symbols);
+        statements = other.statements;
+        deferred = std::move(other.deferred);
+        other.statements = StatementList();
+        other.deferred.clear();
+        for (DeferredBody* body : deferred) {
+            body->program = this;
+        }
+        return *this;
+    }
+};
+
 #include "./Visitor.hpp" 
 
 inline Value NumberExpr::accept(Visitor& visitor) const { return visitor.visit(*this); }
@@ -300,6 +495,7 @@ inline Value BooleanExpr::accept(Visitor& visitor) const { return visitor.visit(
 inline Value VariableExpr::accept(Visitor& visitor) const { return visitor.visit(*this); }
 inline Value ArrayExpr::accept(Visitor& visitor) const { return visitor.visit(*this); }
 inline Value IndexExpr::accept(Visitor& visitor) const { return visitor.visit(*this); }
+inline Value IndexAssignmentExpr::accept(Visitor& visitor) const { return visitor.visit(*this); }
 inline Value BinaryExpr::accept(Visitor& visitor) const { return visitor.visit(*this); }
 inline Value UnaryExpr::accept(Visitor& visitor) const { return visitor.visit(*this); }
 inline Value CallExpr::accept(Visitor& visitor) const { return visitor.visit(*this); }
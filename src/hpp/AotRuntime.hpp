@@ -0,0 +1,128 @@
+#pragma once
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Interpreter.hpp"
+#include "Callable.hpp"
+#include "Environment.hpp"
+
+// Support library for programs the Transpiler turned into C++. Generated code keeps the
+// interpreter's data model: values are Values, locals live in Environments at the slots the
+// Resolver assigned, and every operator and call goes through the Interpreter's own
+// implementation. A compiled script therefore prints exactly what the interpreted one does.
+namespace aot {
+
+using FunctionBody = Value (*)(Interpreter& interpreter);
+
+struct FunctionInfo {
+    const char* name;
+    int arity;
+    size_t slotCount;
+    FunctionBody body;
+};
+
+// A script function compiled to a C++ function; otherwise it behaves like a LoxFunction.
+class CompiledFunction : public Callable {
+public:
+    CompiledFunction(const FunctionInfo& info, std::shared_ptr<Environment> closure)
+        : info(info), closure(std::move(closure)) {}
+
+    Value call(Interpreter& interpreter, std::vector<Value> arguments) override;
+    int arity() const override { return info.arity; }
+    std::string toString() const override { return "<function " + std::string(info.name) + ">"; }
+
+private:
+    const FunctionInfo& info;
+    std::shared_ptr<Environment> closure;
+};
+
+// Runs a block or function body in a pooled frame. The caller's environment is restored
+// however the body ends: normally, by returning or by throwing.
+class Frame {
+public:
+    Frame(Interpreter& interpreter, std::shared_ptr<Environment> enclosing, size_t slotCount)
+        : interpreter(interpreter), previous(interpreter.currentEnvironment()),
+          frame(interpreter.acquireEnvironment(std::move(enclosing), slotCount)) {
+        interpreter.setEnvironment(frame);
+    }
+    ~Frame() {
+        interpreter.setEnvironment(std::move(previous));
+        interpreter.releaseEnvironment(std::move(frame));
+    }
+    Frame(const Frame&) = delete;
+    Frame& operator=(const Frame&) = delete;
+
+    Environment& environment() { return *frame; }
+
+private:
+    Interpreter& interpreter;
+    std::shared_ptr<Environment> previous;
+    std::shared_ptr<Environment> frame;
+};
+
+// Operands are gathered with braced lists, which C++ evaluates left to right as the
+// interpreter does (plain function arguments have no specified order).
+struct Operands {
+    Value left;
+    Value right;
+};
+
+struct IndexStore {
+    Value array;
+    Value index;
+    Value value;
+};
+
+struct Call {
+    std::shared_ptr<Callable> function;
+    std::vector<Value> arguments;
+};
+
+template <BinaryOp op>
+inline Value binary(Interpreter& interpreter, const Operands& operands) {
+    if (operands.left.isNumber() && operands.right.isNumber()) {
+        double left = operands.left.asNumber();
+        double right = operands.right.asNumber();
+        if constexpr (op == BinaryOp::Add) return Value(left + right);
+        else if constexpr (op == BinaryOp::Subtract) return Value(left - right);
+        else if constexpr (op == BinaryOp::Multiply) return Value(left * right);
+        else if constexpr (op == BinaryOp::Less) return Value(left < right);
+        else if constexpr (op == BinaryOp::LessEqual) return Value(left <= right);
+        else if constexpr (op == BinaryOp::Greater) return Value(left > right);
+        else if constexpr (op == BinaryOp::GreaterEqual) return Value(left >= right);
+        else return interpreter.numberBinary(op, left, right);
+    }
+    return interpreter.genericBinary(op, operands.left, operands.right);
+}
+
+inline Value getIndex(Interpreter& interpreter, const Operands& operands) {
+    return interpreter.getIndex(operands.left, operands.right);
+}
+
+inline Value setIndex(Interpreter& interpreter, const IndexStore& store) {
+    return interpreter.setIndex(store.array, store.index, store.value);
+}
+
+inline Value call(Interpreter& interpreter, Call call) {
+    return interpreter.call(call.function, std::move(call.arguments));
+}
+
+inline Value assign(Interpreter& interpreter, const std::string& name, const VariableSlot& resolved, Value value) {
+    interpreter.assignVariable(name, resolved, value);
+    return value;
+}
+
+inline Value makeFunction(Interpreter& interpreter, const FunctionInfo& info) {
+    return Value(std::make_shared<CompiledFunction>(info, interpreter.currentEnvironment()));
+}
+
+inline void print(Interpreter& interpreter, const Value& value) {
+    interpreter.output() << value.toString() << std::endl;
+}
+
+// Runs the translated top level and reports a runtime error like Interpreter::interpret.
+int run(void (*program)(Interpreter& interpreter));
+
+} // namespace aot
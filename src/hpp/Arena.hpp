@@ -0,0 +1,163 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <new>
+#include <unordered_map>
+#include <type_traits>
+#include <algorithm>
+#include <iostream>
+#include <cstdint>
+#include <cstddef>
+
+// Fixed-size view of an array that lives in an AstArena. Used for child lists in AST nodes.
+template <typename T>
+class NodeList {
+public:
+    NodeList() = default;
+    NodeList(T* items, uint32_t count) : items(items), count(count) {}
+
+    T* begin() const { return items; }
+    T* end() const { return items + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T& operator[](size_t index) const { return items[index]; }
+    T& back() const { return items[count - 1]; }
+
+private:
+    T* items = nullptr;
+    uint32_t count = 0;
+};
+
+// Bump allocator that owns every node of one parsed program. Nodes are never freed one by
+// one: destroying the arena releases its blocks at once. The few node types that are not
+// trivially destructible get their destructor recorded and run at that point.
+class AstArena {
+public:
+    AstArena() = default;
+    AstArena(const AstArena&) = delete;
+    AstArena& operator=(const AstArena&) = delete;
+    AstArena(AstArena&& other) noexcept { *this = std::move(other); }
+    AstArena& operator=(AstArena&& other) noexcept {
+        if (this != &other) {
+            runFinalizers();
+            blocks = std::move(other.blocks);
+            finalizers = std::move(other.finalizers);
+            cursor = other.cursor;
+            remaining = other.remaining;
+            used = other.used;
+            other.blocks.clear();
+            other.finalizers.clear();
+            other.cursor = nullptr;
+            other.remaining = 0;
+            other.used = 0;
+        }
+        return *this;
+    }
+    ~AstArena() { runFinalizers(); }
+
+    template <typename T, typename... Args>
+    T* make(Args&&... args) {
+        T* node = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if constexpr (!std::is_trivially_destructible<T>::value) {
+            finalizers.push_back(Finalizer{ node, [](void* object) { static_cast<T*>(object)->~T(); } });
+        }
+        return node;
+    }
+
+    template <typename T>
+    NodeList<T> copy(const std::vector<T>& items) {
+        static_assert(std::is_trivially_copyable<T>::value, "arena lists hold plain values");
+        if (items.empty()) {
+            return NodeList<T>();
+        }
+        T* data = static_cast<T*>(allocate(sizeof(T) * items.size(), alignof(T)));
+        std::copy(items.begin(), items.end(), data);
+        return NodeList<T>(data, static_cast<uint32_t>(items.size()));
+    }
+
+    size_t bytesUsed() const { return used; }
+
+private:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    struct Finalizer {
+        void* object;
+        void (*destroy)(void*);
+    };
+
+    std::vector<std::unique_ptr<char[]>> blocks;
+    std::vector<Finalizer> finalizers;
+    char* cursor = nullptr;
+    size_t remaining = 0;
+    size_t used = 0;
+
+    void* allocate(size_t size, size_t align) {
+        size_t padding = (align - reinterpret_cast<uintptr_t>(cursor) % align) % align;
+        if (padding + size > remaining) {
+            size_t blockSize = std::max(BLOCK_SIZE, size + align);
+            blocks.emplace_back(new char[blockSize]);
+            cursor = blocks.back().get();
+            remaining = blockSize;
+            padding = (align - reinterpret_cast<uintptr_t>(cursor) % align) % align;
+        }
+        char* result = cursor + padding;
+        cursor += padding + size;
+        remaining -= padding + size;
+        used += size;
+        return result;
+    }
+
+    void runFinalizers() {
+        for (auto it = finalizers.rbegin(); it != finalizers.rend(); ++it) {
+            it->destroy(it->object);
+        }
+        finalizers.clear();
+    }
+};
+
+// Interned identifier. Every occurrence of a name within one program shares a single string,
+// so symbols compare by address.
+class Symbol {
+public:
+    Symbol() = default;
+    explicit Symbol(const std::string* text) : text(text) {}
+
+    const std::string& str() const { return *text; }
+    bool operator==(Symbol other) const { return text == other.text; }
+    bool operator!=(Symbol other) const { return text != other.text; }
+
+private:
+    const std::string* text = nullptr;
+};
+
+inline std::ostream& operator<<(std::ostream& out, Symbol symbol) {
+    return out << symbol.str();
+}
+
+class SymbolTable {
+public:
+    SymbolTable() = default;
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
+    SymbolTable(SymbolTable&&) = default;
+    SymbolTable& operator=(SymbolTable&&) = default;
+
+    Symbol intern(std::string_view name) {
+        auto it = index.find(name);
+        if (it != index.end()) {
+            return Symbol(it->second);
+        }
+        // A deque never moves its elements, so the views used as keys stay valid.
+        const std::string& stored = names.emplace_back(name);
+        index.emplace(stored, &stored);
+        return Symbol(&stored);
+    }
+
+private:
+    std::deque<std::string> names;
+    std::unordered_map<std::string_view, const std::string*> index;
+};
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "Environment.hpp"
+#include "Callable.hpp"
+
+// Native function libraries, defined in the builtins scope by Interpreter::Interpreter().
+
+inline void defineNative(Environment& builtins, const std::string& name, int arity,
+                         std::function<Value(Interpreter&, std::vector<Value>)> function) {
+    builtins.define(name, Value(std::make_shared<NativeFunction>(name, arity, std::move(function))));
+}
+
+// float64Array(n | array) and the f64* kernels over Float64Array values.
+void defineFloat64Builtins(Environment& builtins);
+
+// len, push, pop, slice, sort, map, filter and reduce over arrays.
+void defineArrayBuiltins(Environment& builtins);
+
+// parallel_map and parallel_for, which run script functions on the ThreadPool.
+void defineParallelBuiltins(Environment& builtins);
@@ -34,7 +34,7 @@ public:
     }
 
     std::string toString() const override {
-        return "<function " + declaration.name + ">";
+        return "<function " + declaration.name.str() + ">";
     }
 };
 
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <unordered_map>
+#include "Value.hpp"
+
+struct FunctionProto;
+
+enum class OpCode : uint8_t {
+    Constant,       // u16 constant index
+    Null,
+    Unset,          // a reserved local's value until its declaration runs (see Value::unset)
+    True,
+    False,
+    Pop,
+
+    GetLocal,       // u8 slot
+    SetLocal,       // u8 slot
+    GetUpvalue,     // u8 index
+    SetUpvalue,     // u8 index
+    DefineGlobal,   // u16 global index
+    GetGlobal,      // u16 global index
+    SetGlobal,      // u16 global index
+
+    Add,
+    Subtract,
+    Multiply,
+    Divide,
+    Modulo,
+    Equal,
+    NotEqual,
+    Greater,
+    GreaterEqual,
+    Less,
+    LessEqual,
+    Truthy,         // replaces the top of the stack with its truthiness; ends && and ||
+    Negate,
+    Not,
+
+    // ++ / -- and += -= *= /= keep their own opcodes so runtime errors name the source operator.
+    Increment,
+    Decrement,
+    AddUpdate,
+    SubtractUpdate,
+    MultiplyUpdate,
+    DivideUpdate,
+
+    Array,          // u16 element count
+    ArrayConstant,  // u16 constant index; pushes a copy of a constant array literal
+    Index,
+    SetIndex,
+    Print,
+
+    Jump,           // u16 forward offset
+    JumpIfFalse,    // u16 forward offset, pops the condition
+    Loop,           // u16 backward offset
+
+    Call,           // u8 argument count
+    Closure,        // u16 function index, then (u8 isLocal, u8 index) per upvalue
+    CloseUpvalue,
+    Return
+};
+
+class Chunk {
+public:
+    std::vector<uint8_t> code;
+    std::vector<Value> constants;
+    std::vector<std::shared_ptr<FunctionProto>> functions;
+
+    void write(uint8_t byte, int line);
+    void write(OpCode op, int line);
+    int addConstant(const Value& value);
+    int addFunction(std::shared_ptr<FunctionProto> function);
+    int getLine(size_t offset) const;
+
+private:
+    // Run-length encoded line table: each entry starts a run of bytes on one source line.
+    struct LineStart {
+        size_t offset;
+        int line;
+    };
+    std::vector<LineStart> lines;
+    // Constant index of each string constant. Literals are interned, so every repeat of one
+    // finds its first slot here.
+    std::unordered_map<const StringObj*, int> stringConstants;
+};
+
+struct FunctionProto {
+    std::string name;
+    int arity = 0;
+    int upvalueCount = 0;
+    // Global index of each upvalue's name, read instead while the captured local is unset.
+    std::vector<uint16_t> upvalueGlobals;
+    Chunk chunk;
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include "Visitor.hpp"
+#include "AST.hpp"
+#include "Chunk.hpp"
+
+// Maps global variable names to the dense indices used by DefineGlobal/GetGlobal/SetGlobal.
+class GlobalTable {
+public:
+    int indexOf(const std::string& name);
+    const std::string& nameOf(int index) const;
+    size_t size() const;
+
+private:
+    std::unordered_map<std::string, int> indices;
+    std::vector<std::string> names;
+};
+
+// Lowers the statements produced by Parser::parse() into bytecode for the VM.
+class Compiler : public Visitor {
+public:
+    Compiler(GlobalTable& globals);
+
+    std::shared_ptr<FunctionProto> compile(const StatementList& statements);
+
+    Value visit(const NumberExpr& expr) override;
+    Value visit(const StringExpr& expr) override;
+    Value visit(const BooleanExpr& expr) override;
+    Value visit(const VariableExpr& expr) override;
+    Value visit(const ArrayExpr& expr) override;
+    Value visit(const IndexExpr& expr) override;
+    Value visit(const IndexAssignmentExpr& expr) override;
+    Value visit(const BinaryExpr& expr) override;
+    Value visit(const UnaryExpr& expr) override;
+    Value visit(const CallExpr& expr) override;
+    Value visit(const UpdateExpr& expr) override;
+    Value visit(const GroupingExpr& expr) override;
+
+    Value visit(const LetStatement& stmt) override;
+    Value visit(const PrintStatement& stmt) override;
+    Value visit(const ExpressionStatement& stmt) override;
+    Value visit(const UpdateStatement& stmt) override;
+    Value visit(const AssignmentUpdateStatement& stmt) override;
+    Value visit(const BlockStatement& stmt) override;
+    Value visit(const IfStatement& stmt) override;
+    Value visit(const WhileStatement& stmt) override;
+    Value visit(const FunctionStatement& stmt) override;
+    Value visit(const ReturnStatement& stmt) override;
+
+private:
+    struct Local {
+        std::string name;
+        int depth;
+        bool isCaptured;
+        // False while the slot is reserved (see reserveLocals) but its declaration has not run.
+        bool defined = true;
+    };
+
+    struct UpvalueRef {
+        uint8_t index;
+        bool isLocal;
+    };
+
+    struct FunctionState {
+        FunctionState* enclosing;
+        std::shared_ptr<FunctionProto> function;
+        std::vector<Local> locals;
+        std::vector<UpvalueRef> upvalues;
+        int scopeDepth = 0;
+    };
+
+    GlobalTable& globals;
+    FunctionState* current = nullptr;
+    int currentLine = 0;
+
+    Chunk& chunk();
+    void compileStatement(const Statement& stmt);
+    void compileExpression(const Expression& expr);
+
+    void emit(uint8_t byte);
+    void emit(OpCode op);
+    void emitShort(int value);
+    void emitConstant(const Value& value, OpCode op = OpCode::Constant);
+    int emitJump(OpCode op);
+    void patchJump(int offset);
+    void emitLoop(size_t loopStart);
+
+    void beginScope();
+    void endScope();
+    void addLocal(const std::string& name, bool defined = true);
+    void reserveLocals(const StatementList& statements);
+    int reservedSlot(const std::string& name) const;
+    void defineReserved(int slot);
+    int resolveLocal(FunctionState& state, const std::string& name, bool reserved);
+    int resolveUpvalue(FunctionState& state, const std::string& name);
+    int addUpvalue(FunctionState& state, uint8_t index, bool isLocal, const std::string& name);
+    void emitGetVariable(const std::string& name);
+    void emitSetVariable(const std::string& name);
+    void compileFunction(const FunctionStatement& stmt);
+};
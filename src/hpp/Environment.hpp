@@ -1,6 +1,7 @@
 #pragma once 
 #include <string> 
-#include <map>
+#include <unordered_map>
+#include <vector>
 #include <memory>
 #include "./Value.hpp"
 
@@ -10,14 +11,43 @@ public:
 std::shared_ptr<Environment> enclosing;
 Environment();
 
-Environment(std::shared_ptr<Environment> enclosing_env);
+Environment(std::shared_ptr<Environment> enclosing_env, size_t slotCount = 0);
 
+// Name-keyed storage, used for globals.
 void define(const std::string& name, const Value& value);
 
 Value get(const std::string& name);
 
 void assign(const std::string& name, const Value& value);
 
+const std::unordered_map<std::string, Value>& getValues() const;
+
+// Slot storage for locals, addressed by the (depth, slot) pairs the Resolver assigns. A slot
+// holds Value::unset() until its declaration runs; a closure can reach it before that.
+void defineAt(int slot, const Value& value);
+
+const Value& getAt(int depth, int slot);
+
+// Returns false, and leaves the slot alone, if it is still unset.
+bool assignAt(int depth, int slot, const Value& value);
+
+// Re-targets a pooled frame at a new enclosing scope with a fresh set of slots.
+void reset(std::shared_ptr<Environment> enclosing_env, size_t slotCount);
+
+// Drops the frame's references so it can wait in a pool without keeping values alive.
+void clear();
+
+// Drops every named value. Script functions stored in the globals hold the globals in turn, so
+// an interpreter's globals are only freed once this breaks those cycles.
+void clearValues();
+
 private:
-    std::map<std::string, Value> values;
-};
\ No newline at end of file
+    std::unordered_map<std::string, Value> values;
+    std::vector<Value> slots;
+    // Thread that created the scope; see Obj::owner. Other threads may only read it.
+    uint32_t owner = Obj::currentOwner;
+
+    void checkWritable() const;
+
+    Environment* ancestor(int depth);
+};
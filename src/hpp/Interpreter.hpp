@@ -6,17 +6,41 @@
 #include "Environment.hpp" 
 #include "Token.hpp"     
 #include "Callable.hpp"  
-#include "Return.hpp"    
 
 #include <vector>
 #include <map>       
+#include <memory>
 #include <stdexcept> 
 
+class Jit;
+
+// How a statement finished. Anything other than Normal stops the enclosing statement lists
+// until the construct that handles it is reached; exceptions are reserved for runtime errors.
+enum class Completion {
+    Normal,
+    Return
+};
+
 class Interpreter : public Visitor {
 public:
-    Interpreter();
+    // `print` writes to output.
+    explicit Interpreter(std::ostream& output = std::cout);
+    // Runs functions of the interpreter that owns sharedGlobals on another thread. It only reads
+    // the shared AST, leaving the type feedback that quickens binary operators untouched, and
+    // uses code the owner's JIT (if any) already compiled.
+    Interpreter(std::shared_ptr<Environment> sharedGlobals, const Jit* sharedJit, std::ostream& output);
+    ~Interpreter();
+
+    // Hands hot functions and loops to the native code generator from now on.
+    void enableJit();
+    Jit* getJit() const { return jit.get(); }
+    const Jit* getSharedJit() const { return sharedJit; }
+    std::ostream& output() const { return *out; }
 
-    void interpret(const std::vector<std::unique_ptr<Statement>>& statements);
+    // Reports a runtime error on std::cerr.
+    void interpret(const StatementList& statements);
+    // Like interpret, but a runtime error is thrown to the caller.
+    void run(const StatementList& statements);
 
     Value visit(const NumberExpr& expr) override;
     Value visit(const StringExpr& expr) override;
@@ -24,6 +48,7 @@ public:
     Value visit(const VariableExpr& expr) override;
     Value visit(const ArrayExpr& expr) override;
     Value visit(const IndexExpr& expr) override;
+    Value visit(const IndexAssignmentExpr& expr) override;
     Value visit(const BinaryExpr& expr) override;
     Value visit(const UnaryExpr& expr) override;
     Value visit(const CallExpr& expr) override;
@@ -40,18 +65,61 @@ public:
     Value visit(const WhileStatement& stmt) override;
     Value visit(const FunctionStatement& stmt) override;
     Value visit(const ReturnStatement& stmt) override;
-    void executeBlock(const std::vector<std::unique_ptr<Statement>>& statements,
-                      std::shared_ptr<Environment> block_environment);
+    Completion executeBlock(const StatementList& statements,
+                            std::shared_ptr<Environment> block_environment);
+    Value takeReturnValue();
+    std::shared_ptr<Environment> getGlobals() const;
+    std::shared_ptr<Environment> getBuiltins() const;
+
+    std::shared_ptr<Environment> acquireEnvironment(std::shared_ptr<Environment> enclosing, size_t slotCount);
+    void releaseEnvironment(std::shared_ptr<Environment> frame);
+
+    bool isTruthy(const Value& val);
+
+    // The language's semantics, shared by the visits above and by programs compiled to C++.
+    std::shared_ptr<Environment> currentEnvironment() const { return environment; }
+    void setEnvironment(std::shared_ptr<Environment> env) { environment = std::move(env); }
+    Value lookUpVariable(const std::string& name, const VariableSlot& resolved);
+    void assignVariable(const std::string& name, const VariableSlot& resolved, const Value& value);
+    void defineVariable(const std::string& name, int slot, const Value& value);
+    Value updateVariable(const std::string& name, const VariableSlot& resolved, UpdateOp op);
+    Value compoundValue(BinaryOp op, const Value& current, const Value& right);
+    Value numberBinary(BinaryOp op, double left, double right);
+    Value genericBinary(BinaryOp op, const Value& left, const Value& right);
+    Value unaryOperation(UnaryOp op, const Value& right);
+    Value getIndex(const Value& array_val, const Value& index_val);
+    Value setIndex(Value array_val, const Value& index_val, const Value& value);
+    static std::shared_ptr<Callable> callableOf(const Value& callee);
+    Value call(const std::shared_ptr<Callable>& function, std::vector<Value> arguments);
 
 private:
+    std::ostream* out;
+    std::shared_ptr<Environment> builtins;
     std::shared_ptr<Environment> globals;
     std::shared_ptr<Environment> environment;
 
+    // Set by the last executed statement; returnValue is valid while completion is Return.
+    Completion completion = Completion::Normal;
+    Value returnValue;
+
+    // Block and call frames that no closure kept alive, recycled to avoid an allocation per entry.
+    static constexpr size_t ENVIRONMENT_POOL_MAX = 1024;
+    std::vector<std::shared_ptr<Environment>> environmentPool;
+
+    std::unique_ptr<Jit> jit;
+    const Jit* sharedJit = nullptr;
+    bool recordsFeedback = true;
+
     Value evaluate(const Expression& expr);
-    void execute(const Statement& stmt);
+    Completion execute(const Statement& stmt);
 
-    void checkNumberOperand(const std::string& op_name, const Value& operand);
-    void checkNumberOperands(const std::string& op_name, const Value& left, const Value& right);
-    void checkBooleanOperand(const std::string& op_name, const Value& operand);
-    bool isTruthy(const Value& val);
+    void checkNumberOperand(std::string_view op_name, const Value& operand);
+    void checkNumberOperands(std::string_view op_name, const Value& left, const Value& right);
+    void checkBooleanOperand(std::string_view op_name, const Value& operand);
+    size_t checkArrayIndex(const Value& array_val, const Value& index_val);
+
+    static constexpr uint8_t QUICKEN_AFTER = 8;
+    static constexpr uint8_t MAX_DEOPTIMIZATIONS = 4;
+    void recordFeedback(const BinaryExpr& expr, const Value& left, const Value& right);
+    void deoptimize(const BinaryExpr& expr);
 };
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <iostream>
+#include <memory>
+#include "Value.hpp"
+#include "Interpreter.hpp"
+
+// Everything one run of a script owns: its interned strings, its globals and builtins (held by
+// its Interpreter, which a VM can also host) and the stream `print` writes to. Isolates share
+// no mutable state, so threads can each run their own without locking. An isolate must only be
+// used by one thread at a time, inside a Scope.
+//
+// Parse inside the Scope too: string literals are interned into the current isolate.
+class Isolate {
+public:
+    explicit Isolate(std::ostream& output = std::cout);
+    ~Isolate();
+    Isolate(const Isolate&) = delete;
+    Isolate& operator=(const Isolate&) = delete;
+
+    Interpreter& interpreter() { return *engine; }
+    std::ostream& output() const { return engine->output(); }
+    InternTable& strings() { return internTable; }
+
+    // Makes the isolate current on the calling thread until the Scope ends; Scopes nest.
+    class Scope {
+    public:
+        explicit Scope(Isolate& isolate);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        InternTable* previous;
+    };
+
+private:
+    // Declared first so it outlives every Value the interpreter holds.
+    InternTable internTable;
+    std::unique_ptr<Interpreter> engine;
+};
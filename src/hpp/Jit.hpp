@@ -0,0 +1,65 @@
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <limits>
+#include "AST.hpp"
+#include "Value.hpp"
+
+class Environment;
+class LoxFunction;
+
+// Baseline x86-64 compiler for the tree-walking interpreter's hot spots. A function is
+// compiled after CALL_THRESHOLD calls and a while loop after LOOP_THRESHOLD back edges,
+// provided its code only does arithmetic, comparisons and control flow on numbers and
+// booleans, and calls other functions of that kind. Such code has no effects outside its
+// own variables, which is what keeps deoptimization simple:
+//
+// - Values are unboxed doubles in registers and frame slots. Types are checked once on
+//   entry (arguments, and the outer variables a loop uses, must be numbers).
+// - Anything the native code cannot finish (division by zero, a function that ends
+//   without returning) makes it bail out. Nothing has been written back at that point, so
+//   the interpreter simply runs the same call or loop from where the native code started.
+//
+// Compiled code is reached through the Jit only; a node that cannot be compiled is parked
+// and left to the interpreter for good.
+class Jit {
+public:
+    static constexpr int CALL_THRESHOLD = 100;
+    static constexpr int LOOP_THRESHOLD = 500;
+    static constexpr int PARKED = std::numeric_limits<int>::min();
+
+    // True on the platforms the code generator targets (x86-64 Linux).
+    static bool isSupported();
+
+    explicit Jit(Environment& globals);
+    ~Jit();
+    Jit(const Jit&) = delete;
+    Jit& operator=(const Jit&) = delete;
+
+    // Runs the call natively when possible. Returns false when the interpreter must run it.
+    bool tryCall(const LoxFunction& function, const std::vector<Value>& arguments, Value& result);
+    // Runs the rest of the loop natively, from the top of its next iteration to its exit.
+    // Returns false, without having changed anything, when the interpreter must continue it.
+    bool tryRunLoop(const WhileStatement& loop, Environment& environment);
+
+    // Compiles the function ahead of a parallel call, on the thread that owns the Jit.
+    bool prepare(const FunctionStatement& declaration);
+    // Like tryCall, but only runs code that is already compiled and changes no Jit state, so
+    // pool threads may call it concurrently.
+    bool callCompiled(const LoxFunction& function, const std::vector<Value>& arguments, Value& result) const;
+
+    struct CompiledCode;
+
+private:
+    Environment& globals;
+    std::unordered_map<const FunctionStatement*, std::unique_ptr<CompiledCode>> functions;
+    std::unordered_map<const WhileStatement*, std::unique_ptr<CompiledCode>> loops;
+
+    friend class NativeCompiler;
+    CompiledCode* compileFunction(const FunctionStatement& declaration);
+    CompiledCode* compileLoop(const WhileStatement& loop);
+    bool dependenciesHold(const CompiledCode& code) const;
+    bool bailedOut(CompiledCode& code, Feedback<int>& counter);
+};
@@ -1,6 +1,54 @@
 #pragma once
 #include <vector>
-#include <string>
+#include <string_view>
 #include "./Token.hpp" 
 
-std::vector<Token> tokenizeLine(const std::string& line, int currentLine);
\ No newline at end of file
+// Scans source one token at a time. Tokens view `source`, so the buffer must outlive them and
+// the AST parsed from them.
+class Lexer {
+public:
+    explicit Lexer(std::string_view source = std::string_view(), int firstLine = 1)
+        : source(source), line_number(firstLine) {}
+
+    // The next token; once the source is used up, EndOfFile every time.
+    Token next();
+
+private:
+    std::string_view source;
+    size_t i = 0;
+    int line_number;
+};
+
+// Where the Parser takes its tokens from: a vector lexed beforehand, or a Lexer run on demand so
+// no more than the Parser's lookahead is held at once.
+class TokenStream {
+public:
+    // Past the end of tokens, EndOfFile is returned.
+    explicit TokenStream(const std::vector<Token>& tokens) : tokens(&tokens) {}
+    explicit TokenStream(std::string_view source, int firstLine = 1) : lexer(source, firstLine) {}
+
+    Token next() {
+        if (!tokens) {
+            return lexer.next();
+        }
+        if (index < tokens->size()) {
+            return (*tokens)[index++];
+        }
+        return Token(TokenType::EndOfFile, std::string_view(), tokens->empty() ? 0 : tokens->back().getLine());
+    }
+
+private:
+    const std::vector<Token>* tokens = nullptr;
+    size_t index = 0;
+    Lexer lexer;
+};
+
+// Scans a whole source buffer in one pass and appends an EndOfFile token.
+std::vector<Token> tokenize(std::string_view source, int firstLine = 1);
+
+// tokenize() for large sources: splits the buffer after newlines into chunks, lexes them on the
+// shared ThreadPool and joins the results in order. No token spans a newline (strings and
+// comments end at one), so a chunk boundary never falls inside a token. Tokens and errors are
+// the same as tokenize() gives; when several chunks fail, the earliest one's error is thrown.
+// Must not be called from inside a ThreadPool job.
+std::vector<Token> tokenizeParallel(std::string_view source);
\ No newline at end of file
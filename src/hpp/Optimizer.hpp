@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Visitor.hpp"
+#include "AST.hpp"
+#include "Interpreter.hpp"
+
+// Rewrites a freshly parsed Program before it is resolved: folds operators whose operands
+// are all literals, drops `if` branches and `while` loops whose condition is a constant,
+// and marks array literals made of scalar literals so they are built only once.
+//
+// Folding runs the operator through an Interpreter, so a folded result is exactly what the
+// program would have computed. An operation that would raise a runtime error is left alone
+// and still reports it when (and if) it executes.
+class Optimizer : public Visitor {
+public:
+    explicit Optimizer(Program& program);
+
+    void optimize();
+    // For a function body the Parser deferred; the rest of the program was optimized already.
+    void optimizeBody(BlockStatement& body);
+    // For a top-level statement from Parser::parseNext(); nullptr when it can be dropped.
+    Statement* optimizeStatement(Statement* statement);
+
+    Value visit(const NumberExpr& expr) override;
+    Value visit(const StringExpr& expr) override;
+    Value visit(const BooleanExpr& expr) override;
+    Value visit(const VariableExpr& expr) override;
+    Value visit(const ArrayExpr& expr) override;
+    Value visit(const IndexExpr& expr) override;
+    Value visit(const IndexAssignmentExpr& expr) override;
+    Value visit(const BinaryExpr& expr) override;
+    Value visit(const UnaryExpr& expr) override;
+    Value visit(const CallExpr& expr) override;
+    Value visit(const UpdateExpr& expr) override;
+    Value visit(const GroupingExpr& expr) override;
+
+    Value visit(const LetStatement& stmt) override;
+    Value visit(const PrintStatement& stmt) override;
+    Value visit(const ExpressionStatement& stmt) override;
+    Value visit(const UpdateStatement& stmt) override;
+    Value visit(const AssignmentUpdateStatement& stmt) override;
+    Value visit(const BlockStatement& stmt) override;
+    Value visit(const IfStatement& stmt) override;
+    Value visit(const WhileStatement& stmt) override;
+    Value visit(const FunctionStatement& stmt) override;
+    Value visit(const ReturnStatement& stmt) override;
+
+private:
+    Program& program;
+    Interpreter folder;
+
+    // What the node being visited should be replaced with; a statement may be replaced by nullptr.
+    Expression* expressionResult = nullptr;
+    Statement* statementResult = nullptr;
+
+    int foldedExpressions = 0;
+    int removedStatements = 0;
+    int constantArrays = 0;
+
+    Expression* optimize(Expression* expr);
+    Statement* optimize(Statement* stmt);
+    StatementList optimize(StatementList statements);
+
+    static bool isLiteral(const Expression* expr);
+    Expression* fold(const Expression& expr);
+    Expression* literalFor(const Value& value);
+};
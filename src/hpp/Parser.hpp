@@ -4,14 +4,37 @@
 #include <memory>
 #include <string>
 #include "Token.hpp"
+#include "Lexer.hpp"
 #include "AST.hpp"   
 
+// How tightly an operator binds, loosest first. Expressions are parsed by precedence climbing
+// over a table that gives each token's precedence when it follows an operand (Parser.cpp).
+enum class Precedence : uint8_t {
+    None,
+    Assignment,
+    Or,
+    And,
+    Equality,
+    Comparison,
+    Term,
+    Factor,
+    Unary,
+    Call
+};
+
 class Parser
 {
 private:
-    const std::vector<Token>& tokens;
-    int current = 0;
+    // Tokens are pulled from the stream only when peek() or peekNext() needs them, so the Parser
+    // holds at most three (those two and previous()), and a statement streamed with parseNext()
+    // is complete without reading a token past its end.
+    mutable TokenStream tokens;
+    mutable Token lookahead[2];
+    mutable int buffered = 0;
+    Token last;
+    int consumed = 0;
 
+    void fill(int count) const;
     const Token& peek()const;
     const Token& peekNext()const;
     const Token& previous()const; 
@@ -21,32 +44,49 @@ private:
     bool match(std::initializer_list<TokenType> types); 
     Token consume(TokenType type, const std::string& message); 
 
-    std::unique_ptr<Statement> parseStatement();
-    std::unique_ptr<Statement> parsePrintStatement();
-    std::unique_ptr<Statement> parseLetStatement();
-    std::unique_ptr<Statement> parseIfStatement();
-    std::unique_ptr<Statement> parseWhileStatement();
-    std::unique_ptr<Statement> parseReturnStatement();
-    std::unique_ptr<Statement> parseUpdateStatement(bool isPrefix);
-    std::unique_ptr<Statement> parseAssignmentUpdateStatement();
-    std::unique_ptr<FunctionStatement> parseFunctionStatement();
-    std::unique_ptr<BlockStatement> parseBlockStatement();
-    std::unique_ptr<Statement> parseExpressionStatement();
-
-    std::unique_ptr<Expression> parseExpression();
-    std::unique_ptr<Expression> parseEquality();
-    std::unique_ptr<Expression> parseComparison();
-    std::unique_ptr<Expression> parseTerm();
-    std::unique_ptr<Expression> parseFactor();
-    std::unique_ptr<Expression> parseUnary(); 
-    std::unique_ptr<Expression> parseLogicalAnd();
-    std::unique_ptr<Expression> parseLogicalOr();
-    std::unique_ptr<Expression> parseAssignment();
-    std::unique_ptr<Expression> parseCall();
-    std::unique_ptr<Expression> finishCall(std::unique_ptr<Expression> callee);
-    std::unique_ptr<Expression> parsePrimary();
+    Program parsed;
+    // parsed, or the Program a deferred body is being added to.
+    Program& program;
+    bool deferBodies = false;
+    int blockDepth = 0;
+
+    template <typename T, typename... Args>
+    T* make(Args&&... args) { return program.arena.make<T>(std::forward<Args>(args)...); }
+    Symbol intern(const Token& token);
+    static BinaryOp binaryOpFor(TokenType type);
+
+    Statement* parseStatement();
+    Statement* parsePrintStatement();
+    Statement* parseLetStatement();
+    Statement* parseIfStatement();
+    Statement* parseWhileStatement();
+    Statement* parseReturnStatement();
+    Statement* parseUpdateStatement(bool isPrefix);
+    Statement* parseAssignmentUpdateStatement();
+    FunctionStatement* parseFunctionStatement();
+    DeferredBody* skipFunctionBody();
+    BlockStatement* parseBlockStatement();
+    Statement* parseExpressionStatement();
+
+    Expression* parseExpression();
+    Expression* parsePrecedence(Precedence minimum);
+    Expression* parsePrefix();
+    Expression* finishAssignment(Expression* target);
+    Expression* finishCall(Expression* callee);
 
 public:
-    Parser(const std::vector<Token>& tokens);
-    std::vector<std::unique_ptr<Statement>> parse(); 
+    // With deferBodies, the bodies of top-level functions are only checked for balanced braces
+    // and parsed when first needed (FunctionStatement::getBody()), so the tokens' source must
+    // outlive the Program.
+    Parser(const std::vector<Token>& tokens, bool deferBodies = false);
+    // Parses straight into target, one statement at a time with parseNext().
+    Parser(TokenStream tokens, Program& target, bool deferBodies = false);
+    // Hands over the arena that owns the tree; the Program must outlive every use of its nodes.
+    Program parse(); 
+    // The next top-level statement, allocated in the target Program but not added to its
+    // statements, or nullptr at the end of the input.
+    Statement* parseNext();
+
+    // Parses a deferred function body, lexed from its own text, into the Program it belongs to.
+    static BlockStatement* parseDeferred(std::string_view text, int line, Program& program);
 };
\ No newline at end of file
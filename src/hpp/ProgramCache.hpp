@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+#include "AST.hpp"
+
+// Binary image of a parsed (and, if asked, optimized) program, kept next to its source file as
+// `<source>.cache` so later runs can skip lexing and parsing. Resolution is not cached: it is a
+// single pass over the tree and only the tree-walking interpreter needs it.
+//
+// The file starts with a header naming the format version, the Settings the tree was built with,
+// and the size and hash of the source it came from, followed by a hash of the encoded tree.
+// Function bodies the Parser deferred are stored as their place in the source. A cache whose
+// header does not match the current source and settings, or whose contents fail to decode, is
+// ignored and rewritten, so it never changes what a program does.
+class ProgramCache {
+public:
+    // Bump whenever the encoding or the AST it describes changes.
+    static constexpr uint32_t FORMAT_VERSION = 2;
+
+    explicit ProgramCache(const std::string& sourcePath);
+
+    // How the cached program was produced; a cache made another way is not used.
+    struct Settings {
+        bool optimized;
+        bool deferredBodies;
+    };
+
+    // Fills program from the cache for source. Returns false, leaving program untouched, when
+    // there is no usable cache. String literals are interned into the current InternTable, and
+    // deferred bodies view source, which must outlive the program.
+    bool load(const std::string& source, Settings settings, Program& program) const;
+    // Writes program as the cache for source. A cache that cannot be written is skipped.
+    void store(const std::string& source, Settings settings, const Program& program) const;
+
+    const std::string& path() const { return cachePath; }
+
+private:
+    std::string cachePath;
+};
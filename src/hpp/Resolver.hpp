@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include "Visitor.hpp"
+#include "AST.hpp"
+
+// Static pass run between Parser::parse() and Interpreter::interpret(). Binds every local
+// variable use to a (depth, slot) pair so the interpreter can skip name lookups.
+//
+// Statements see the locals declared before them, as they run in order. A nested function
+// may run later, though, so its body is resolved once the enclosing scopes are complete and
+// can call a sibling declared after it. Only names no enclosing scope declares are globals.
+class Resolver : public Visitor {
+public:
+    void resolve(const StatementList& statements);
+    // Binds the parameters and body of function, whose own name is already declared.
+    void resolveBody(const FunctionStatement& function, const BlockStatement& body);
+
+    Value visit(const NumberExpr& expr) override;
+    Value visit(const StringExpr& expr) override;
+    Value visit(const BooleanExpr& expr) override;
+    Value visit(const VariableExpr& expr) override;
+    Value visit(const ArrayExpr& expr) override;
+    Value visit(const IndexExpr& expr) override;
+    Value visit(const IndexAssignmentExpr& expr) override;
+    Value visit(const BinaryExpr& expr) override;
+    Value visit(const UnaryExpr& expr) override;
+    Value visit(const CallExpr& expr) override;
+    Value visit(const UpdateExpr& expr) override;
+    Value visit(const GroupingExpr& expr) override;
+
+    Value visit(const LetStatement& stmt) override;
+    Value visit(const PrintStatement& stmt) override;
+    Value visit(const ExpressionStatement& stmt) override;
+    Value visit(const UpdateStatement& stmt) override;
+    Value visit(const AssignmentUpdateStatement& stmt) override;
+    Value visit(const BlockStatement& stmt) override;
+    Value visit(const IfStatement& stmt) override;
+    Value visit(const WhileStatement& stmt) override;
+    Value visit(const FunctionStatement& stmt) override;
+    Value visit(const ReturnStatement& stmt) override;
+
+private:
+    using Scope = std::unordered_map<std::string, int>;
+
+    // A nested function's body, waiting until the scopes around it have declared every name.
+    struct PendingBody {
+        const FunctionStatement* function;
+        const BlockStatement* body;
+        std::vector<std::shared_ptr<Scope>> scopes;
+    };
+
+    // One entry per runtime Environment below the globals, innermost last.
+    std::vector<std::shared_ptr<Scope>> scopes;
+    std::vector<PendingBody> pending;
+
+    void resolvePending();
+    void resolve(const Statement& stmt);
+    void resolve(const Expression& expr);
+    void beginScope();
+    int endScope();
+    int declare(const std::string& name);
+    VariableSlot resolveLocal(const std::string& name) const;
+};
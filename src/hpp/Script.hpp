@@ -0,0 +1,57 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include "AST.hpp"
+#include "Value.hpp"
+
+class Script;
+
+// Lexes, parses, optimizes and resolves source once. Throws std::runtime_error when it fails.
+std::shared_ptr<const Script> compile(const std::string& source, bool optimize = true);
+
+// A compiled program, run any number of times with different inputs:
+//
+//     std::shared_ptr<const Script> script = compile(source);
+//     ScriptResult result = run(script, { { "n", Value(10.0) } });
+//
+// A Script does not change after compile() (apart from the interpreter's profiling state on its
+// nodes, see Feedback), so runs on several threads may share one. Its string constants are
+// immortal: those runs never count references to them.
+class Script {
+public:
+    Script(const Script&) = delete;
+    Script& operator=(const Script&) = delete;
+
+    const StatementList& statements() const { return program.statements; }
+
+private:
+    Script() = default;
+
+    // Declared first so it outlives the tree, whose string constants it owns.
+    InternTable strings;
+    Program program;
+
+    friend std::shared_ptr<const Script> compile(const std::string& source, bool optimize);
+};
+
+// The string values in globals may be the script's own constants, so the result holds a
+// reference to the script and stays valid after the caller drops theirs.
+struct ScriptResult {
+    // Declared first so it outlives the globals that point into it.
+    std::shared_ptr<const Script> script;
+    // Everything the script printed.
+    std::string output;
+    // Its globals when it finished, functions left out.
+    std::unordered_map<std::string, Value> globals;
+};
+
+// Runs the script in a fresh Isolate with every input defined as a global and returns what it
+// printed and left behind; nothing goes to stdout. A runtime error is thrown.
+//
+// Inputs are handed over as they are, so an array the script writes to changes for the caller
+// too. Like every Value, they belong to the thread that made them: concurrent runs each need
+// their own.
+ScriptResult run(const std::shared_ptr<const Script>& script,
+                 const std::unordered_map<std::string, Value>& inputs = {}, bool useJit = true);
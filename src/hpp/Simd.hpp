@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+
+// Vector kernels over contiguous doubles, used by the Float64Array builtins. On x86-64 each
+// kernel has an SSE2 and an AVX version, picked once at startup from what the CPU supports;
+// elsewhere plain loops are used.
+//
+// Reductions keep one partial result per lane and combine them at the end, so sum, dot and
+// prefixSum may differ in the last bits from a sequential loop. min and max return NaN if
+// any element is NaN.
+namespace simd {
+
+enum class Compare {
+    Less,
+    Greater,
+    Equal
+};
+
+double sum(const double* data, size_t count);
+double dot(const double* left, const double* right, size_t count);
+double min(const double* data, size_t count);
+double max(const double* data, size_t count);
+void scale(const double* data, double factor, double* out, size_t count);
+void add(const double* left, const double* right, double* out, size_t count);
+// out[i] = 1.0 when left[i] <op> right[i] (right[0] for every i when broadcast), else 0.0.
+void compare(Compare op, const double* left, const double* right, bool broadcast, double* out, size_t count);
+void prefixSum(const double* data, double* out, size_t count);
+
+// "avx", "sse2" or "scalar".
+const char* implementation();
+
+} // namespace simd
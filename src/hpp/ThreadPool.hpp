@@ -0,0 +1,64 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Process-wide work-stealing pool behind parallel_map and parallel_for. The threads start on
+// first use and sleep between jobs.
+//
+// run() deals a job's tasks round-robin into one deque per thread. Each thread takes work from
+// the back of its own deque and, once that is empty, steals from the front of the others', so a
+// thread that drew cheap tasks helps the ones that drew expensive ones.
+class ThreadPool {
+public:
+    static ThreadPool& shared();
+    // Number of threads the shared pool will use, the caller included; call before first use.
+    static void setThreadCount(size_t count);
+
+    // Threads taking part in run(), the calling thread included.
+    size_t size() const { return queues.size(); }
+
+    // Calls task(index, thread) once for every index in [0, count) and returns when all calls
+    // are done. thread is in [0, size()) and names the calling thread for per-thread state; the
+    // caller is thread 0. If a task throws, remaining tasks are skipped and the first exception
+    // is rethrown here. One job runs at a time.
+    void run(size_t count, const std::function<void(size_t index, size_t thread)>& task);
+
+    ~ThreadPool();
+
+private:
+    explicit ThreadPool(size_t threads);
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<size_t> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+
+    std::mutex jobMutex;
+    std::mutex stateMutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    const std::function<void(size_t, size_t)>* job = nullptr;
+    uint64_t generation = 0;
+    size_t running = 0;
+    bool stopping = false;
+    std::exception_ptr error;
+
+    void workerLoop(size_t thread);
+    void work(size_t thread);
+    bool take(size_t thread, size_t& index);
+    void discardTasks();
+
+    static size_t configuredThreads;
+};
@@ -1,5 +1,6 @@
 ﻿#pragma once 
 #include <string>   
+#include <string_view>
 #include <map>       
 
 enum class TokenType {
@@ -102,18 +103,19 @@ inline std::string tokenTypeToString(TokenType type) {
 	return "Unknown";
 }
 
+// The lexeme is a view into the source buffer passed to tokenize(); tokens never own text.
 class Token {
 private:
+	std::string_view lexeme;
 	TokenType type;
-	std::string lexeme;
 	int line;
 
 public:
-	Token(TokenType type, std::string lexeme, int line)
-		: type(type), lexeme(std::move(lexeme)), line(line) {
+	Token(TokenType type, std::string_view lexeme, int line)
+		: lexeme(lexeme), type(type), line(line) {
 	}
 
 	TokenType getTokenType() const { return type; }
-	const std::string& getLexeme() const { return lexeme; }
+	std::string_view getLexeme() const { return lexeme; }
 	int getLine() const { return line; }
 };
\ No newline at end of file
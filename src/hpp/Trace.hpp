@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iostream>
+#include <cstdint>
+
+enum class TraceCategory : uint8_t {
+    Lexer = 1 << 0,
+    Parser = 1 << 1,
+    Interpreter = 1 << 2,
+    Environment = 1 << 3,
+    Jit = 1 << 4,
+    Optimizer = 1 << 5
+};
+
+enum class TraceLevel : uint8_t {
+    Info,
+    Debug,
+    Verbose
+};
+
+// Diagnostic output for the front end and runtime, off by default. Messages go to std::clog,
+// or into a ring buffer of the most recent lines that is only printed when an error is reported.
+class Trace {
+public:
+    static bool enabled(TraceCategory category, TraceLevel level) {
+        return (categories & static_cast<uint32_t>(category)) != 0 && level <= maxLevel;
+    }
+
+    // Accepts a comma-separated list of category names, or "all". Returns false on an unknown name.
+    static bool enableCategories(const std::string& names);
+    static bool setLevel(const std::string& name);
+    static void useRingBuffer(size_t capacity);
+
+    static void write(TraceCategory category, const std::string& message);
+    // Prints and clears whatever the ring buffer holds; does nothing when it is not in use.
+    static void dumpRingBuffer(std::ostream& out);
+
+private:
+    static uint32_t categories;
+    static TraceLevel maxLevel;
+    static std::vector<std::string> ring;
+    static size_t ringNext;
+    static bool ringFull;
+};
+
+// The message is a stream expression (TRACE(Parser, Debug, "token " << n)) and is only
+// evaluated when its category and level are enabled. Release builds compile it away.
+#ifdef NDEBUG
+#define TRACE(category, level, message) do {} while (0)
+#else
+#define TRACE(category, level, message)                                                 \
+    do {                                                                                \
+        if (Trace::enabled(TraceCategory::category, TraceLevel::level)) {               \
+            std::ostringstream traceStream;                                             \
+            traceStream << message;                                                     \
+            Trace::write(TraceCategory::category, traceStream.str());                   \
+        }                                                                               \
+    } while (0)
+#endif
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Visitor.hpp"
+#include "AST.hpp"
+
+// Ahead-of-time backend: translates a resolved program into one C++ translation unit that,
+// linked against the runtime (every source file but main.cpp, see AotRuntime.hpp), builds a
+// standalone executable behaving exactly like Interpreter::interpret on the same program.
+//
+// Each script function becomes a C++ function and the top level becomes `program()`. The
+// translation is structural: variables keep their Environment slots and every operation
+// calls the runtime, so it removes dispatch on the tree rather than changing semantics.
+class Transpiler : public Visitor {
+public:
+    explicit Transpiler(std::string sourceName);
+
+    std::string translate(const StatementList& statements);
+
+    Value visit(const NumberExpr& expr) override;
+    Value visit(const StringExpr& expr) override;
+    Value visit(const BooleanExpr& expr) override;
+    Value visit(const VariableExpr& expr) override;
+    Value visit(const ArrayExpr& expr) override;
+    Value visit(const IndexExpr& expr) override;
+    Value visit(const IndexAssignmentExpr& expr) override;
+    Value visit(const BinaryExpr& expr) override;
+    Value visit(const UnaryExpr& expr) override;
+    Value visit(const CallExpr& expr) override;
+    Value visit(const UpdateExpr& expr) override;
+    Value visit(const GroupingExpr& expr) override;
+
+    Value visit(const LetStatement& stmt) override;
+    Value visit(const PrintStatement& stmt) override;
+    Value visit(const ExpressionStatement& stmt) override;
+    Value visit(const UpdateStatement& stmt) override;
+    Value visit(const AssignmentUpdateStatement& stmt) override;
+    Value visit(const BlockStatement& stmt) override;
+    Value visit(const IfStatement& stmt) override;
+    Value visit(const WhileStatement& stmt) override;
+    Value visit(const FunctionStatement& stmt) override;
+    Value visit(const ReturnStatement& stmt) override;
+
+private:
+    std::string sourceName;
+
+    // Namespace-scope declarations, collected while bodies are translated.
+    std::ostringstream constants;
+    std::ostringstream declarations;
+    std::ostringstream definitions;
+    std::unordered_map<std::string, std::string> names;
+    int nextConstant = 0;
+    int nextFunction = 0;
+
+    // Body of the C++ function being written; nested script functions get their own.
+    struct Body {
+        std::ostringstream out;
+        int indent = 1;
+        bool inFunction = false;
+    };
+    std::vector<Body> bodies;
+
+    // C++ expression for the last expression visited.
+    std::string expression;
+
+    std::string translate(const Expression& expr);
+    void translate(const Statement& stmt);
+    void translateStatements(const StatementList& statements);
+    std::ostream& line();
+    void open(const std::string& text);
+    void close(const std::string& text = "}");
+
+    std::string name(const std::string& text);
+    std::string stringConstant(const std::string& text);
+    std::string arrayConstant(const ArrayExpr& expr);
+    static std::string slot(const VariableSlot& resolved);
+    static std::string number(double value);
+    static std::string quote(const std::string& text);
+    static const char* binaryOpName(BinaryOp op);
+};
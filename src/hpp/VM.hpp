@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include "AST.hpp"
+#include "Value.hpp"
+#include "Callable.hpp"
+#include "Chunk.hpp"
+#include "Compiler.hpp"
+#include "Interpreter.hpp"
+
+class VM;
+
+struct Upvalue {
+    Value* location;
+    Value closed;
+};
+
+class VMClosure : public Callable {
+public:
+    std::shared_ptr<FunctionProto> function;
+    std::vector<std::shared_ptr<Upvalue>> upvalues;
+    VM& vm;
+
+    VMClosure(std::shared_ptr<FunctionProto> function, VM& vm)
+        : function(std::move(function)), vm(vm) {}
+
+    Value call(Interpreter& interpreter, std::vector<Value> arguments) override;
+
+    int arity() const override { return function->arity; }
+    std::string toString() const override { return "<function " + function->name + ">"; }
+};
+
+struct CallFrame {
+    VMClosure* closure;
+    const uint8_t* ip;
+    Value* slots;
+};
+
+// Stack-based bytecode VM; an alternative to the tree-walking Interpreter.
+class VM {
+public:
+    // Natives run against host, which also provides the output stream.
+    explicit VM(Interpreter& host);
+
+    void interpret(const StatementList& statements);
+    Value callClosure(VMClosure& closure, const std::vector<Value>& arguments);
+
+private:
+    static constexpr size_t FRAMES_MAX = 1024;
+    static constexpr size_t STACK_MAX = FRAMES_MAX * 256;
+
+    Interpreter& host;
+
+    GlobalTable globalNames;
+    std::vector<Value> globals;
+    std::vector<bool> globalDefined;
+    // Still holding the native it was seeded with; a script definition may replace it once.
+    std::vector<bool> globalBuiltin;
+
+    std::vector<Value> stack;
+    Value* stackTop;
+    std::vector<CallFrame> frames;
+    std::vector<std::shared_ptr<Upvalue>> openUpvalues;
+
+    void push(Value value);
+    Value pop();
+    void resetStack();
+
+    void run(size_t baseFrame);
+    void callValue(int argCount);
+    void pushFrame(VMClosure& closure, int argCount);
+    std::shared_ptr<Upvalue> captureUpvalue(Value* local);
+    void closeUpvalues(Value* last);
+    void syncGlobals();
+};
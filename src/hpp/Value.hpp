@@ -1,42 +1,296 @@
 ﻿// src/hpp/Value.hpp
-#pragma once 
+#pragma once
 
-#include <variant>   
-#include <string>    
-#include <vector>   
-#include <iostream>  
-#include <stdexcept> 
-#include <memory>    
+#include <string>
+#include <vector>
+#include <iostream>
+#include <stdexcept>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <string_view>
+#include <unordered_map>
 
-class Callable; 
+class Callable;
+class ArrayView;
+class InternTable;
+struct StringObj;
 
+enum class ObjType : uint8_t {
+    String,
+    Array,
+    Float64Array,
+    Callable
+};
+
+// Header of every heap-allocated value. A graph of Values normally belongs to one interpreter
+// thread and reference counts are plain integers.
+//
+// While parallel_map or parallel_for runs script code on the thread pool, `concurrent` is
+// non-zero: counts are then updated atomically, and an object may only be modified by the
+// thread that created it (`owner`), which leaves everything that existed before read-only.
+//
+// Immortal objects are not counted at all. They are the constants of a compiled Script, which
+// runs on several threads may share, and are freed along with it.
+struct Obj {
+    uint32_t refCount = 1;
+    ObjType type;
+    bool immortal = false;
+    uint32_t owner;
+
+    explicit Obj(ObjType type) : type(type), owner(currentOwner) {}
+
+    void retain() {
+        if (immortal) return;
+        if (concurrent.load(std::memory_order_relaxed) != 0) {
+            __atomic_add_fetch(&refCount, 1, __ATOMIC_RELAXED);
+        } else {
+            ++refCount;
+        }
+    }
+    // True when that was the last reference.
+    bool release() {
+        if (immortal) return false;
+        if (concurrent.load(std::memory_order_relaxed) != 0) {
+            return __atomic_sub_fetch(&refCount, 1, __ATOMIC_ACQ_REL) == 0;
+        }
+        return --refCount == 0;
+    }
+    bool writable() const {
+        return concurrent.load(std::memory_order_relaxed) == 0 || owner == currentOwner;
+    }
+
+    static std::atomic<int> concurrent;
+    // 0 on the interpreter's own thread; pool threads get a fresh id for every parallel call.
+    static thread_local uint32_t currentOwner;
+};
+
+// NaN-boxed 8-byte value. Numbers are stored as plain doubles, null and booleans live in
+// the payload of a quiet NaN, and strings, arrays, typed arrays and callables are tagged
+// Obj pointers.
 class Value {
 public:
-    std::variant<double, bool, std::string, std::monostate, std::vector<Value>, std::shared_ptr<Callable>> data;
-
-    Value(); 
+    Value();
     Value(double v);
     Value(bool v);
-    Value(const std::string& v);
-    Value(std::vector<Value> v); 
-    Value(std::shared_ptr<Callable> callable); 
-
-    bool isNumber() const;
-    bool isBool() const;
-    bool isString() const;
-    bool isNull() const;
-    bool isArray() const; 
-    bool isCallable() const; 
-
-    double asNumber() const;
-    bool asBool() const;
+    Value(std::string v);
+    Value(std::vector<Value> v);
+    Value(std::shared_ptr<Callable> callable);
+
+    // Returns the single shared string object for this content in the calling thread's
+    // InternTable, creating it on first use.
+    static Value intern(const std::string& v);
+    // String concatenation of left and right (either may be a non-string, which is printed).
+    static Value concat(const Value& left, const Value& right);
+    // A new array with the same elements; both share one buffer until either is written.
+    static Value copyArray(const Value& array);
+    // A new array of elements [begin, end) of array, sharing its buffer until either is written.
+    static Value sliceArray(const Value& array, size_t begin, size_t end);
+    // A dense array of doubles; unlike an array of Values it can only hold numbers.
+    static Value float64Array(std::vector<double> elements);
+    // Marks a local slot whose declaration has not run yet. Never visible to scripts: reading
+    // such a slot falls back to the global of the same name.
+    static Value unset() {
+        Value value;
+        value.bits = UNSET_BITS;
+        return value;
+    }
+
+    // Only heap objects need work on copy and destruction; immediates stay on the fast path.
+    Value(const Value& other) : bits(other.bits) {
+        if (isObj()) asObj()->retain();
+    }
+    Value(Value&& other) noexcept : bits(other.bits) {
+        other.bits = NULL_BITS;
+    }
+    Value& operator=(const Value& other) {
+        Value copy(other);
+        return *this = std::move(copy);
+    }
+    Value& operator=(Value&& other) noexcept {
+        uint64_t previous = bits;
+        bits = other.bits;
+        other.bits = NULL_BITS;
+        if ((previous & (QNAN | SIGN_BIT)) == (QNAN | SIGN_BIT)) releaseObj(previous);
+        return *this;
+    }
+    ~Value() {
+        if (isObj()) releaseObj(bits);
+    }
+
+    bool isNumber() const { return (bits & QNAN) != QNAN; }
+    bool isBool() const { return (bits | 1) == TRUE_BITS; }
+    bool isString() const { return isObjType(ObjType::String); }
+    bool isNull() const { return bits == NULL_BITS; }
+    bool isUnset() const { return bits == UNSET_BITS; }
+    bool isArray() const { return isObjType(ObjType::Array); }
+    bool isFloat64Array() const { return isObjType(ObjType::Float64Array); }
+    bool isCallable() const { return isObjType(ObjType::Callable); }
+
+    double asNumber() const {
+        if (!isNumber()) typeError("Value is not a number.");
+        double number;
+        std::memcpy(&number, &bits, sizeof(number));
+        return number;
+    }
+    bool asBool() const {
+        if (!isBool()) typeError("Value is not a boolean.");
+        return bits == TRUE_BITS;
+    }
     const std::string& asString() const;
-    const std::vector<Value>& asArray() const;
+    // The string's object, without flattening it. Equal interned strings share one.
+    const StringObj* asStringObj() const;
+    ArrayView asArray() const;
     std::vector<Value>& asArrayMutable();
-    std::shared_ptr<Callable> asCallable() const; 
+    const std::vector<double>& asFloat64Array() const;
+    std::vector<double>& asFloat64ArrayMutable();
+    std::shared_ptr<Callable> asCallable() const;
+    // Number of characters, without flattening a rope.
+    size_t stringLength() const;
 
-    std::string toString() const; 
+    std::string toString() const;
 
-    bool operator==(const Value& other) const; 
+    bool operator==(const Value& other) const;
     bool operator!=(const Value& other) const;
-};
\ No newline at end of file
+
+private:
+    static constexpr uint64_t SIGN_BIT = 0x8000000000000000ull;
+    static constexpr uint64_t QNAN = 0x7ffc000000000000ull;
+    static constexpr uint64_t NULL_BITS = QNAN | 1;
+    static constexpr uint64_t FALSE_BITS = QNAN | 2;
+    static constexpr uint64_t TRUE_BITS = QNAN | 3;
+    static constexpr uint64_t UNSET_BITS = QNAN | 4;
+
+    uint64_t bits;
+
+    explicit Value(Obj* obj) : bits(objBits(obj)) {}
+
+    static uint64_t objBits(Obj* obj) { return SIGN_BIT | QNAN | reinterpret_cast<uintptr_t>(obj); }
+
+    bool isObj() const { return (bits & (QNAN | SIGN_BIT)) == (QNAN | SIGN_BIT); }
+    Obj* asObj() const { return reinterpret_cast<Obj*>(static_cast<uintptr_t>(bits & ~(SIGN_BIT | QNAN))); }
+    bool isObjType(ObjType type) const { return isObj() && asObj()->type == type; }
+
+    static void releaseObj(uint64_t bits);
+
+    [[noreturn]] static void typeError(const char* message);
+
+    friend class InternTable;
+};
+
+static_assert(sizeof(Value) == 8, "Value must stay register-sized");
+
+// Strings are immutable once created, so the hash is computed up front. Interned strings are
+// unique per content, which lets two of them be compared by address alone.
+//
+// A long concatenation is stored as a rope node that references both halves instead of
+// copying them, so repeated `s += ...` is amortized O(1). The characters and hash of a rope
+// are produced by flatten() the first time the contents are needed.
+struct StringObj : Obj {
+    mutable std::string value;
+    mutable uint64_t hash;
+    const size_t length;
+    // Set while the string is the interned copy of its content in that table.
+    InternTable* table = nullptr;
+    // Each holds a reference; both are null once the string is flat.
+    mutable StringObj* left = nullptr;
+    mutable StringObj* right = nullptr;
+
+    explicit StringObj(std::string value)
+        : Obj(ObjType::String), value(std::move(value)), hash(hashString(this->value)), length(this->value.size()) {}
+    StringObj(StringObj* left, StringObj* right)
+        : Obj(ObjType::String), hash(0), length(left->length + right->length), left(left), right(right) {}
+
+    // Flattening publishes value and hash before clearing left, so a thread that sees a flat
+    // string also sees its characters.
+    bool isFlat() const { return __atomic_load_n(&left, __ATOMIC_ACQUIRE) == nullptr; }
+    void flatten() const;
+
+    static uint64_t hashString(const std::string& value) {
+        uint64_t hash = 14695981039346656037ull;
+        for (unsigned char c : value) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+};
+
+// Interned strings of one isolate (see Isolate.hpp). A thread interns into the table made
+// current on it, or into a process-wide default one. Strings outliving their table are detached
+// from it and become ordinary strings.
+class InternTable {
+public:
+    InternTable() = default;
+    ~InternTable();
+    InternTable(const InternTable&) = delete;
+    InternTable& operator=(const InternTable&) = delete;
+
+    Value intern(const std::string& text);
+    // Called when an interned string dies.
+    void erase(const StringObj* string);
+    // Makes every string now in the table immortal; the table frees them when it is destroyed.
+    void freeze();
+
+    static InternTable& current();
+    // Returns the previously current table, or nullptr when that was the default.
+    static InternTable* makeCurrent(InternTable* table);
+
+private:
+    // Keys view the interned objects' own characters.
+    std::unordered_map<std::string_view, StringObj*> entries;
+};
+
+// Arrays have reference semantics: copies of a Value alias the same ArrayObj. The element
+// buffer underneath may be shared between several arrays and is cloned on first write.
+//
+// A slice is a window [offset, offset + length) on another array's buffer, so taking one is
+// O(1); it keeps the whole buffer alive until it is written to or released.
+struct ArrayObj : Obj {
+    std::shared_ptr<std::vector<Value>> buffer;
+    bool isSlice = false;
+    size_t offset = 0;
+    size_t length = 0;
+
+    explicit ArrayObj(std::vector<Value> elements)
+        : Obj(ObjType::Array), buffer(std::make_shared<std::vector<Value>>(std::move(elements))) {}
+    explicit ArrayObj(std::shared_ptr<std::vector<Value>> buffer)
+        : Obj(ObjType::Array), buffer(std::move(buffer)) {}
+    ArrayObj(std::shared_ptr<std::vector<Value>> buffer, size_t offset, size_t length)
+        : Obj(ObjType::Array), buffer(std::move(buffer)), isSlice(true), offset(offset), length(length) {}
+};
+
+// Read-only view of an array's elements. It is invalidated by the next write to the array.
+class ArrayView {
+public:
+    ArrayView(const Value* data, size_t count) : data(data), count(count) {}
+
+    const Value* begin() const { return data; }
+    const Value* end() const { return data + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const Value& operator[](size_t index) const { return data[index]; }
+
+    bool operator==(const ArrayView& other) const {
+        return count == other.count && std::equal(begin(), end(), other.begin());
+    }
+
+private:
+    const Value* data;
+    size_t count;
+};
+
+// Typed arrays have reference semantics too, but own their elements outright.
+struct Float64ArrayObj : Obj {
+    std::vector<double> elements;
+
+    explicit Float64ArrayObj(std::vector<double> elements) : Obj(ObjType::Float64Array), elements(std::move(elements)) {}
+};
+
+struct CallableObj : Obj {
+    std::shared_ptr<Callable> callable;
+
+    explicit CallableObj(std::shared_ptr<Callable> callable) : Obj(ObjType::Callable), callable(std::move(callable)) {}
+};
@@ -9,6 +9,7 @@ class BooleanExpr;
 class VariableExpr;
 class ArrayExpr;
 class IndexExpr;
+class IndexAssignmentExpr;
 class BinaryExpr;
 class UnaryExpr;
 class CallExpr;
@@ -34,6 +35,7 @@ public:
     virtual Value visit(const VariableExpr& expr) = 0;
     virtual Value visit(const ArrayExpr& expr) = 0;      
     virtual Value visit(const IndexExpr& expr) = 0;      
+    virtual Value visit(const IndexAssignmentExpr& expr) = 0;
     virtual Value visit(const BinaryExpr& expr) = 0;
     virtual Value visit(const UnaryExpr& expr) = 0;
     virtual Value visit(const CallExpr& expr) = 0;